@@ -0,0 +1,47 @@
+#include "astVisitor.hpp"
+
+// Defaults for visitors that only care about some nodes.
+llvm::Value* AstVisitor::visit(NumberExpr& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(StringExpr& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(CharExpr& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(BoolExpr& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(NilExpr& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(VarExpr& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(UnaryExpr& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(BinaryExpr& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(CallExpr& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(ArrayExpr& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(RecordExpr& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(SetExpr& ast) { return nullptr; }
+
+llvm::Value* AstVisitor::visit(ExprStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(CallStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(AssignStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(CompoundStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(IfStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(WhileStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(RepeatStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(ForStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(CaseStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(ReadStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(WriteStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(YieldStmt& ast) { return nullptr; }
+llvm::Value* AstVisitor::visit(SpawnStmt& ast) { return nullptr; }
+
+llvm::Function* AstVisitor::visit(Prototype& ast) { return nullptr; }
+void AstVisitor::visit(ConstDecl& ast) {}
+void AstVisitor::visit(TypeDecl& ast) {}
+void AstVisitor::visit(RangeType& ast) {}
+void AstVisitor::visit(PointerType& ast) {}
+void AstVisitor::visit(RecordType& ast) {}
+void AstVisitor::visit(ArrayType& ast) {}
+void AstVisitor::visit(EnumType& ast) {}
+void AstVisitor::visit(VarDecl& ast) {}
+void AstVisitor::visit(RecordVar& ast) {}
+void AstVisitor::visit(ArrayVar& ast) {}
+void AstVisitor::visit(SetType& ast) {}
+void AstVisitor::visit(SetVar& ast) {}
+void AstVisitor::visit(ParamDecl& ast) {}
+llvm::Function* AstVisitor::visit(FuncDecl& ast) { return nullptr; }
+llvm::Function* AstVisitor::visit(ProcDecl& ast) { return nullptr; }
+void AstVisitor::visit(Program& ast) {}
@@ -7,12 +7,14 @@ struct NumberExpr;
 struct StringExpr;
 struct CharExpr;
 struct BoolExpr;
+struct NilExpr;
 struct VarExpr;
 struct UnaryExpr;
 struct BinaryExpr;
 struct CallExpr;
 struct ArrayExpr;
 struct RecordExpr;
+struct SetExpr;
 
 struct Prototype;
 struct ExprStmt;
@@ -26,16 +28,22 @@ struct ForStmt;
 struct CaseStmt;
 struct ReadStmt;
 struct WriteStmt;
+struct YieldStmt;
+struct SpawnStmt;
 
 struct ConstDecl;
 struct TypeDecl;
 struct RangeType;
+struct PointerType;
 struct RecordType;
 struct ArrayType;
 struct EnumType;
 struct VarDecl;
 struct RecordVar;
 struct ArrayVar;
+struct SetType;
+struct SetVar;
+struct ParamDecl;
 struct FuncDecl;
 struct ProcDecl;
 struct Program;
@@ -48,12 +56,14 @@ public:
     virtual llvm::Value* visit(StringExpr& ast);
     virtual llvm::Value* visit(CharExpr& ast);
     virtual llvm::Value* visit(BoolExpr& ast);
+    virtual llvm::Value* visit(NilExpr& ast);
     virtual llvm::Value* visit(VarExpr& ast);
     virtual llvm::Value* visit(UnaryExpr& ast);
     virtual llvm::Value* visit(BinaryExpr& ast);
     virtual llvm::Value* visit(CallExpr& ast);
     virtual llvm::Value* visit(ArrayExpr& ast);
     virtual llvm::Value* visit(RecordExpr& ast);
+    virtual llvm::Value* visit(SetExpr& ast);
 
     virtual llvm::Value* visit(ExprStmt& ast);
     virtual llvm::Value* visit(CallStmt& ast);
@@ -66,17 +76,23 @@ public:
     virtual llvm::Value* visit(CaseStmt& ast);
     virtual llvm::Value* visit(ReadStmt& ast);
     virtual llvm::Value* visit(WriteStmt& ast);
+    virtual llvm::Value* visit(YieldStmt& ast);
+    virtual llvm::Value* visit(SpawnStmt& ast);
 
     virtual llvm::Function* visit(Prototype& ast);
     virtual void visit(ConstDecl& ast);
     virtual void visit(TypeDecl& ast);
     virtual void visit(RangeType& ast);
+    virtual void visit(PointerType& ast);
     virtual void visit(RecordType& ast);
     virtual void visit(ArrayType& ast);
     virtual void visit(EnumType& ast);
     virtual void visit(VarDecl& ast);
     virtual void visit(RecordVar& ast);
     virtual void visit(ArrayVar& ast);
+    virtual void visit(SetType& ast);
+    virtual void visit(SetVar& ast);
+    virtual void visit(ParamDecl& ast);
     virtual llvm::Function* visit(FuncDecl& ast);
     virtual llvm::Function* visit(ProcDecl& ast);
     virtual void visit(Program& ast);
@@ -0,0 +1,446 @@
+#include "callGraphVisitor.hpp"
+
+// Builtins lowered by CodegenVisitor, inline or to runtime kernels; they touch no memory beyond their
+// arguments and always return. A routine the program declares with the same name shadows them.
+static const std::set<std::string> Builtins = { "card", "length", "pos", "low", "high", "contains", "sort", "binarysearch", "fill", "sum", "min", "max", "dot", "copy",
+    "abs", "sqr", "sqrt", "sin", "cos", "exp", "ln", "trunc", "round" };
+
+// Heap builtins are lowered to runtime calls that write memory outside the routine.
+static const std::set<std::string> HeapBuiltins = { "new", "dispose", "mark", "release", "setlength", "delete" };
+
+// File builtins also do I/O, and exit the program when it fails.
+static const std::set<std::string> FileBuiltins = { "assign", "reset", "rewrite", "close", "eof" };
+
+// Channel builtins synchronize with other threads and may block forever.
+static const std::set<std::string> ChannelBuiltins = { "send", "receive" };
+
+// Whether a name is a builtin depends on the routines the program declares
+// anywhere, not on which of them have been visited so far.
+void CallGraphVisitor::addCall(const std::string& callee) {
+    if (routines.count(callee)) {
+        callees[current].insert(callee);
+    } else if (FileBuiltins.count(callee) || ChannelBuiltins.count(callee)) {
+        effects[current].memory = mem_write;
+        effects[current].mayNotReturn = true;
+    } else if (HeapBuiltins.count(callee)) {
+        effects[current].memory = mem_write;
+        effects[current].writesGlobals = true;
+    } else if (!Builtins.count(callee)) {
+        callees[current].insert(callee);
+    }
+    // A routine can only reach the control variable of a serial loop when it is not a local.
+    if (callees[current].count(callee)) {
+        for (ForStmt* L : loops) {
+            if (!L->parallel && !locals.count(L->name)) {
+                loopCallees[L].insert(callee);
+            }
+        }
+    }
+}
+
+// A failed range check reports the index and exits the program.
+void CallGraphVisitor::addRangeCheck() {
+    if (RangeChecks) {
+        effects[current].memory = mem_write;
+        effects[current].mayNotReturn = true;
+    }
+}
+
+void CallGraphVisitor::addAccess(const std::string& name, MemoryEffect effect) {
+    if (effect == mem_write) {
+        writes[current].insert(name);
+        for (ForStmt* L : loops) {
+            if (L->name == name) {
+                writtenLoops.insert(L);
+            }
+        }
+        if (!locals.count(name) && !params.count(name)) {
+            effects[current].writesGlobals = true;
+        }
+    }
+    if (!locals.count(name) && !constants.count(name)) {
+        effects[current].memory = std::max(effects[current].memory, effect);
+    }
+}
+
+std::set<std::string> CallGraphVisitor::reachableFrom(const std::string& root) const {
+    std::set<std::string> seen = { root };
+    std::vector<std::string> worklist = { root };
+
+    while (!worklist.empty()) {
+        std::string name = worklist.back();
+        worklist.pop_back();
+
+        auto it = callees.find(name);
+        if (it == callees.end()) {
+            continue;
+        }
+        for (const std::string& callee : it->second) {
+            if (seen.insert(callee).second) {
+                worklist.push_back(callee);
+            }
+        }
+    }
+
+    return seen;
+}
+
+// Arguments that name a variable may be bound to a var parameter, so they count as written.
+void CallGraphVisitor::addArgs(std::vector<std::unique_ptr<Expr>>& args) {
+    for (auto& a : args) {
+        if (auto* V = dynamic_cast<VarExpr*>(a.get())) {
+            addAccess(V->name, mem_write);
+        } else if (auto* A = dynamic_cast<ArrayExpr*>(a.get())) {
+            addAccess(A->arr->name, mem_write);
+        } else if (auto* R = dynamic_cast<RecordExpr*>(a.get())) {
+            addAccess(R->record->name, mem_write);
+        }
+        a->accept(*this);
+    }
+}
+
+// Propagates memory and termination effects bottom-up through the call graph
+// until nothing changes; calls to routines outside the program are opaque.
+// A loop that calls a routine writing globals may have its control variable changed.
+void CallGraphVisitor::inferEffects() {
+    for (auto& c : callees) {
+        for (const std::string& callee : c.second) {
+            if (reachableFrom(callee).count(c.first)) {
+                effects[c.first].recursive = true;
+                effects[c.first].mayNotReturn = true;
+            }
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto& c : callees) {
+            RoutineEffects& e = effects[c.first];
+            for (const std::string& callee : c.second) {
+                MemoryEffect memory = mem_write;
+                bool mayNotReturn = true;
+                bool writesGlobals = true;
+                if (callees.count(callee)) {
+                    memory = effects[callee].memory;
+                    mayNotReturn = effects[callee].mayNotReturn;
+                    writesGlobals = effects[callee].writesGlobals;
+                }
+                if (memory > e.memory || (mayNotReturn && !e.mayNotReturn) || (writesGlobals && !e.writesGlobals)) {
+                    e.memory = std::max(e.memory, memory);
+                    e.mayNotReturn = e.mayNotReturn || mayNotReturn;
+                    e.writesGlobals = e.writesGlobals || writesGlobals;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for (auto& l : loopCallees) {
+        for (const std::string& callee : l.second) {
+            if (!callees.count(callee) || effects[callee].writesGlobals) {
+                writtenLoops.insert(l.first);
+            }
+        }
+    }
+}
+
+llvm::Value* CallGraphVisitor::visit(NumberExpr& ast) { return nullptr; }
+// String operations may allocate, which no memory attribute would allow.
+llvm::Value* CallGraphVisitor::visit(StringExpr& ast) {
+    effects[current].memory = mem_write;
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(CharExpr& ast) { return nullptr; }
+llvm::Value* CallGraphVisitor::visit(BoolExpr& ast) { return nullptr; }
+llvm::Value* CallGraphVisitor::visit(NilExpr& ast) { return nullptr; }
+llvm::Value* CallGraphVisitor::visit(VarExpr& ast) {
+    addAccess(ast.name, mem_read);
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(UnaryExpr& ast) {
+    ast.rhs->accept(*this);
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(BinaryExpr& ast) {
+    ast.lhs->accept(*this);
+    ast.rhs->accept(*this);
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(CallExpr& ast) {
+    addCall(ast.callee);
+    addArgs(ast.args);
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(ArrayExpr& ast) {
+    addAccess(ast.arr->name, mem_read);
+    addRangeCheck();
+    ast.index->accept(*this);
+    for (auto& s : ast.subscripts) {
+        s->accept(*this);
+    }
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(RecordExpr& ast) {
+    addAccess(ast.record->name, mem_read);
+    if (ast.deref) {
+        effects[current].memory = std::max(effects[current].memory, mem_read);
+    }
+    if (ast.index) {
+        addRangeCheck();
+        ast.index->accept(*this);
+    }
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(SetExpr& ast) {
+    for (auto& e : ast.elements) {
+        e.first->accept(*this);
+        if (e.second) {
+            e.second->accept(*this);
+        }
+    }
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(ExprStmt& ast) {
+    statementCounts[current]++;
+    ast.expr->accept(*this);
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(CallStmt& ast) {
+    statementCounts[current]++;
+    addCall(ast.callee);
+    addArgs(ast.args);
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(AssignStmt& ast) {
+    statementCounts[current]++;
+    if (auto* A = dynamic_cast<ArrayExpr*>(ast.name.get())) {
+        addAccess(A->arr->name, mem_write);
+        addRangeCheck();
+        A->index->accept(*this);
+        for (auto& s : A->subscripts) {
+            s->accept(*this);
+        }
+    } else if (auto* R = dynamic_cast<RecordExpr*>(ast.name.get())) {
+        addAccess(R->record->name, mem_write);
+        if (R->deref) {
+            effects[current].memory = mem_write;
+            effects[current].writesGlobals = true;
+        }
+        if (R->index) {
+            addRangeCheck();
+            R->index->accept(*this);
+        }
+    } else if (auto* V = dynamic_cast<VarExpr*>(ast.name.get())) {
+        addAccess(V->name, mem_write);
+    }
+    ast.value->accept(*this);
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(CompoundStmt& ast) {
+    for (auto& s : ast.statements) {
+        s->accept(*this);
+    }
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(IfStmt& ast) {
+    statementCounts[current]++;
+    ast.condition->accept(*this);
+    ast.thenBranch->accept(*this);
+    if (ast.elseBranch) {
+        ast.elseBranch->accept(*this);
+    }
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(WhileStmt& ast) {
+    statementCounts[current]++;
+    effects[current].mayNotReturn = true;
+    ast.condition->accept(*this);
+    ast.body->accept(*this);
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(RepeatStmt& ast) {
+    statementCounts[current]++;
+    effects[current].mayNotReturn = true;
+    ast.condition->accept(*this);
+    for (auto& s : ast.body) {
+        s->accept(*this);
+    }
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(ForStmt& ast) {
+    statementCounts[current]++;
+    // Every form of loop, parallel ones included, stores to its control variable.
+    addAccess(ast.name, mem_write);
+    if (ast.in) {
+        ast.in->accept(*this);
+    }
+    if (ast.from) {
+        ast.from->accept(*this);
+        ast.to->accept(*this);
+    }
+    loops.push_back(&ast);
+    ast.body->accept(*this);
+    loops.pop_back();
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(CaseStmt& ast) {
+    statementCounts[current]++;
+    ast.expr->accept(*this);
+    for (auto& c : ast.cases) {
+        c.second->accept(*this);
+    }
+    if (ast.elseBranch) {
+        ast.elseBranch->accept(*this);
+    }
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(ReadStmt& ast) {
+    statementCounts[current]++;
+    effects[current].memory = mem_write;
+    effects[current].mayNotReturn = true;
+    for (auto& v : ast.variables) {
+        addAccess(v, mem_write);
+    }
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(WriteStmt& ast) {
+    statementCounts[current]++;
+    effects[current].memory = mem_write;
+    effects[current].mayNotReturn = true;
+    for (auto& e : ast.exprs) {
+        e->accept(*this);
+    }
+    return nullptr;
+}
+
+llvm::Value* CallGraphVisitor::visit(YieldStmt& ast) {
+    statementCounts[current]++;
+    ast.value->accept(*this);
+    return nullptr;
+}
+
+// The spawned call runs on another thread, so its effects count as the spawner's.
+llvm::Value* CallGraphVisitor::visit(SpawnStmt& ast) {
+    statementCounts[current]++;
+    effects[current].memory = mem_write;
+    addCall(ast.call->callee);
+    for (auto& a : ast.call->args) {
+        a->accept(*this);
+    }
+    return nullptr;
+}
+
+llvm::Function* CallGraphVisitor::visit(Prototype& ast) { return nullptr; }
+void CallGraphVisitor::visit(ConstDecl& ast) {}
+void CallGraphVisitor::visit(TypeDecl& ast) {}
+void CallGraphVisitor::visit(RangeType& ast) {}
+void CallGraphVisitor::visit(PointerType& ast) {}
+void CallGraphVisitor::visit(RecordType& ast) {}
+void CallGraphVisitor::visit(ArrayType& ast) {}
+void CallGraphVisitor::visit(EnumType& ast) {}
+void CallGraphVisitor::visit(VarDecl& ast) {}
+void CallGraphVisitor::visit(RecordVar& ast) {}
+void CallGraphVisitor::visit(ArrayVar& ast) {}
+void CallGraphVisitor::visit(SetType& ast) {}
+void CallGraphVisitor::visit(SetVar& ast) {}
+void CallGraphVisitor::visit(ParamDecl& ast) {}
+
+llvm::Function* CallGraphVisitor::visit(FuncDecl& ast) {
+    current = ast.name;
+    callees[current];
+    statementCounts[current];
+    effects[current];
+    locals = { ast.name };
+    params.clear();
+    // The coroutine frame is allocated and freed behind the caller's back.
+    if (ast.proto->iterator) {
+        effects[current].memory = mem_write;
+    }
+    for (auto& a : ast.proto->args) {
+        params.insert(a->name);
+        if (a->mode == ParamMode::param_value && a->identifier.empty() && a->type != TokenType::tok_string) {
+            locals.insert(a->name);
+        }
+        if (a->type == TokenType::tok_string) {
+            effects[current].memory = mem_write;
+        }
+    }
+    for (auto& d : ast.locals) {
+        locals.insert(d->name);
+        if (auto* V = dynamic_cast<VarDecl*>(d.get()); V && (V->type == TokenType::tok_string || V->type == TokenType::tok_map || V->type == TokenType::tok_text || V->type == TokenType::tok_channel)) {
+            effects[current].memory = mem_write;
+        }
+    }
+    this->visit(*ast.body);
+    return nullptr;
+}
+
+llvm::Function* CallGraphVisitor::visit(ProcDecl& ast) {
+    current = ast.name;
+    callees[current];
+    statementCounts[current];
+    effects[current];
+    locals = { ast.name };
+    params.clear();
+    for (auto& a : ast.proto->args) {
+        params.insert(a->name);
+        if (a->mode == ParamMode::param_value && a->identifier.empty() && a->type != TokenType::tok_string) {
+            locals.insert(a->name);
+        }
+        if (a->type == TokenType::tok_string) {
+            effects[current].memory = mem_write;
+        }
+    }
+    for (auto& d : ast.locals) {
+        locals.insert(d->name);
+        if (auto* V = dynamic_cast<VarDecl*>(d.get()); V && (V->type == TokenType::tok_string || V->type == TokenType::tok_map || V->type == TokenType::tok_text || V->type == TokenType::tok_channel)) {
+            effects[current].memory = mem_write;
+        }
+    }
+    this->visit(*ast.body);
+    return nullptr;
+}
+
+void CallGraphVisitor::visit(Program& ast) {
+    // Typed constants live in read-only memory, so reading them is no memory effect.
+    for (auto& d : ast.decls) {
+        auto* V = dynamic_cast<VarDecl*>(d.get());
+        auto* A = dynamic_cast<ArrayVar*>(d.get());
+        if (dynamic_cast<ConstDecl*>(d.get()) || (V && V->init) || (A && A->init)) {
+            constants.insert(d->name);
+        }
+        if (dynamic_cast<FuncDecl*>(d.get()) || dynamic_cast<ProcDecl*>(d.get())) {
+            routines.insert(d->name);
+        }
+    }
+    for (auto& d : ast.decls) {
+        d->accept(*this);
+    }
+
+    current = ast.name;
+    callees[current];
+    locals.clear();
+    params.clear();
+    for (auto& s : ast.body) {
+        s->accept(*this);
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef CALLGRAPHVISITOR_HPP
+#define CALLGRAPHVISITOR_HPP
+
+#include "astVisitor.hpp"
+#include "expr.hpp"
+#include "decl.hpp"
+#include "stmt.hpp"
+#include "llvm.hpp"
+
+#include <set>
+
+enum MemoryEffect {
+    mem_none,
+    mem_read,
+    mem_write,
+};
+
+struct RoutineEffects {
+    MemoryEffect memory = mem_none;
+    bool mayNotReturn = false;
+    bool recursive = false;
+    // Stores to program variables or the heap, itself or through a callee.
+    bool writesGlobals = false;
+};
+
+class CallGraphVisitor : public AstVisitor {
+private:
+    std::string current;
+    std::set<std::string> locals;
+    std::set<std::string> params;
+    std::set<std::string> constants;
+    std::set<std::string> routines;
+    std::vector<ForStmt*> loops;
+    std::map<ForStmt*, std::set<std::string>> loopCallees;
+    void addCall(const std::string& callee);
+    void addRangeCheck();
+    void addAccess(const std::string& name, MemoryEffect effect);
+    void addArgs(std::vector<std::unique_ptr<Expr>>& args);
+
+public:
+    std::map<std::string, std::set<std::string>> callees;
+    std::map<std::string, int> statementCounts;
+    std::map<std::string, RoutineEffects> effects;
+    std::map<std::string, std::set<std::string>> writes;
+    // Counting loops whose body may store to the control variable.
+    std::set<ForStmt*> writtenLoops;
+
+    std::set<std::string> reachableFrom(const std::string& root) const;
+    void inferEffects();
+
+    llvm::Value* visit(NumberExpr& ast);
+    llvm::Value* visit(StringExpr& ast);
+    llvm::Value* visit(CharExpr& ast);
+    llvm::Value* visit(BoolExpr& ast);
+    llvm::Value* visit(NilExpr& ast);
+    llvm::Value* visit(VarExpr& ast);
+    llvm::Value* visit(UnaryExpr& ast);
+    llvm::Value* visit(BinaryExpr& ast);
+    llvm::Value* visit(CallExpr& ast);
+    llvm::Value* visit(ArrayExpr& ast);
+    llvm::Value* visit(RecordExpr& ast);
+    llvm::Value* visit(SetExpr& ast);
+
+    llvm::Value* visit(ExprStmt& ast);
+    llvm::Value* visit(CallStmt& ast);
+    llvm::Value* visit(AssignStmt& ast);
+    llvm::Value* visit(CompoundStmt& ast);
+    llvm::Value* visit(IfStmt& ast);
+    llvm::Value* visit(WhileStmt& ast);
+    llvm::Value* visit(RepeatStmt& ast);
+    llvm::Value* visit(ForStmt& ast);
+    llvm::Value* visit(CaseStmt& ast);
+    llvm::Value* visit(ReadStmt& ast);
+    llvm::Value* visit(WriteStmt& ast);
+    llvm::Value* visit(YieldStmt& ast);
+    llvm::Value* visit(SpawnStmt& ast);
+
+    llvm::Function* visit(Prototype& ast);
+    void visit(ConstDecl& ast);
+    void visit(TypeDecl& ast);
+    void visit(RangeType& ast);
+    void visit(PointerType& ast);
+    void visit(RecordType& ast);
+    void visit(ArrayType& ast);
+    void visit(EnumType& ast);
+    void visit(VarDecl& ast);
+    void visit(RecordVar& ast);
+    void visit(ArrayVar& ast);
+    void visit(SetType& ast);
+    void visit(SetVar& ast);
+    void visit(ParamDecl& ast);
+    llvm::Function* visit(FuncDecl& ast);
+    llvm::Function* visit(ProcDecl& ast);
+    void visit(Program& ast);
+};
+
+#endif
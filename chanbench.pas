@@ -0,0 +1,82 @@
+program ChanBench;
+
+// Producers send the numbers 1..n down one channel to consumers that add them up
+// and hand their sums back on a second channel, so every value crosses threads
+// once. The total is the same however the values were interleaved, which makes
+// this a stress test as well as a throughput benchmark. Reads the number of
+// producers and consumers:
+//   echo 4 4 | time ./chanbench
+
+var
+  work: channel[1024] of integer;
+  sums: channel of real;
+  done: channel of integer;
+  producers, consumers, i: integer;
+  total, expected: real;
+
+procedure produce(n: integer);
+var
+  k: integer;
+begin
+  k := 1;
+  while k <= n do
+  begin
+    send(work, k);
+    k := k + 1;
+  end;
+  send(done, 1);
+end;
+
+// 0 is never produced, so it tells a consumer to stop.
+procedure consume();
+var
+  k, s: real;
+begin
+  s := 0;
+  k := receive(work);
+  while k <> 0 do
+  begin
+    s := s + k;
+    k := receive(work);
+  end;
+  send(sums, s);
+end;
+
+begin
+  readln(producers, consumers);
+  i := 0;
+  while i < consumers do
+  begin
+    spawn consume();
+    i := i + 1;
+  end;
+  i := 0;
+  while i < producers do
+  begin
+    spawn produce(2000000);
+    i := i + 1;
+  end;
+
+  i := 0;
+  while i < producers do
+  begin
+    receive(done);
+    i := i + 1;
+  end;
+  i := 0;
+  while i < consumers do
+  begin
+    send(work, 0);
+    i := i + 1;
+  end;
+  total := 0;
+  i := 0;
+  while i < consumers do
+  begin
+    total := total + receive(sums);
+    i := i + 1;
+  end;
+
+  expected := producers * 2000000.0 * 2000001.0 / 2;
+  writeln(total, ' ', expected);
+end.
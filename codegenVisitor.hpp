@@ -10,24 +10,157 @@
 #include "token.hpp"
 #include "llvm.hpp"
 
+struct RoutineEffects;
+
 class CodegenVisitor : public AstVisitor {
 private:
     llvm::Value* LogErrorV(const char *str);
     llvm::Function* getFunction(std::string name);
-    llvm::AllocaInst* CreateEntryBlockAlloca(llvm::Function* TheFunction, llvm::StringRef name);
+    llvm::AllocaInst* CreateEntryBlockAlloca(llvm::Function* TheFunction, llvm::StringRef name, llvm::Type* type = nullptr);
+    llvm::Value* CreateVariable(const std::string& name, llvm::Type* type = nullptr, ConstInit* init = nullptr);
+    llvm::Constant* getConstInit(ConstInit& init, llvm::Type* T);
+    llvm::GlobalVariable* getConstantGlobal(const std::string& name);
+    llvm::Constant* getStringConstant(StringExpr& ast);
+    llvm::Constant* foldConstantElement(ArrayExpr& ast);
+    llvm::Constant* foldConstantField(RecordExpr& ast);
+    llvm::Type* getArrayType(llvm::Type* element, int min, int max, const std::vector<std::pair<int, int>>& dims);
+    llvm::Type* getElementType(const std::string& elementType);
+    llvm::Type* getBitArrayType(int min, int max);
+    llvm::Value* getBitWordPtr(ArrayExpr& ast, llvm::Value*& mask);
+    llvm::Value* CreateBitLoad(ArrayExpr& ast);
+    llvm::Value* CreateBitStore(ArrayExpr& ast, llvm::Value* V);
+    const BitField* getBitField(RecordExpr& ast);
+    llvm::Value* CreateBitFieldLoad(RecordExpr& ast, const BitField& field);
+    llvm::Value* CreateBitFieldStore(RecordExpr& ast, const BitField& field, llvm::Value* V);
+    llvm::Value* CreateBitsBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    bool isMathBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    llvm::Value* CreateMathBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    void unifyFloats(llvm::Value*& L, llvm::Value*& R);
     int getFieldIndex(const std::string& recordName, const std::string& fieldName);
+    bool getIndexRange(Expr& ast, int& lo, int& hi);
+    llvm::Value* getArrayIndex(Expr& index, const ArrayInfo& info, llvm::Value* length = nullptr);
+    llvm::Value* getArrayElementPtr(ArrayExpr& ast);
+    void CreateBoundsCheck(llvm::Value* index, const ArrayInfo& info, llvm::Value* length = nullptr);
+    llvm::StructType* getOpenArrayType();
+    llvm::StructType* getDynArrayType();
+    const ArrayInfo* getArraySpan(Expr& arg, llvm::Value*& data, llvm::Value*& length);
+    std::string getArrayKernel(const ArrayInfo& info);
+    bool isArrayBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    llvm::Value* CreateArrayBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    llvm::Value* CreateOpenArray(Expr& arg);
+    void CreateOpenArrayCopy(llvm::Function* TheFunction, llvm::AllocaInst* Open);
+    llvm::Value* CreateArrayBound(const std::string& bound, const std::string& name);
+    llvm::Value* CreateSetLength(std::vector<std::unique_ptr<Expr>>& args);
+    llvm::StructType* getMapType();
+    std::string getMapKeyKind(const std::string& keyType);
+    llvm::Value* CreateMapCall(const std::string& op, const std::string& name, Expr& key, llvm::Type* ret, llvm::Value* value = nullptr);
+    llvm::Value* CreateMapBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    llvm::Value* CreateForIn(ForStmt& ast);
+    llvm::Function* CreateIterator(FuncDecl& ast, llvm::Function* TheFunction);
+    void CreateCoroSuspend(bool final);
+    llvm::Value* CreateIteratorLoop(ForStmt& ast, CallExpr& call);
+    bool getForBounds(ForStmt& ast, llvm::Type* T, llvm::Value*& Start, llvm::Value*& End);
+    llvm::Value* CreateParallelFor(ForStmt& ast);
+    llvm::StructType* getTextType();
+    llvm::Value* getTextPtr(Expr& ast);
+    bool isFileBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    llvm::Value* CreateFileBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    llvm::StructType* getChannelType();
+    llvm::Value* getChannelPtr(Expr& ast);
+    bool isChannelBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    llvm::Value* CreateChannelBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    std::string addInferredAttributes(llvm::Function* F, const RoutineEffects& effects);
+    llvm::Value* getRecordFieldPtr(RecordExpr& ast);
+    llvm::Type* getRecordFieldType(RecordExpr& ast);
+    llvm::MDNode* getRecordFieldTBAA(RecordExpr& ast);
+    llvm::Type* getFieldType(TokenType type, const std::string& identifier = "");
+    llvm::Value* convertValue(llvm::Value* V, llvm::Type* T);
+    llvm::StructType* getStringType();
+    llvm::Value* CreateRuntimeCall(const std::string& name, llvm::Type* ret, std::vector<llvm::Value*> args);
+    llvm::Value* CreateStringCall(const std::string& name, llvm::Type* ret, std::vector<llvm::Value*> args);
+    llvm::Value* CreateStringTemp();
+    llvm::Value* toStringValue(llvm::Value* V);
+    void releaseStringTemp(llvm::Value* V);
+    llvm::Value* CreateStringOp(const std::string& op, llvm::Value* L, llvm::Value* R);
+    bool isStringTarget(Expr& ast);
+    bool isStringExpr(Expr& ast);
+    llvm::Value* CreateStringAssign(Expr& target, llvm::Value* P, Expr& value);
+    void getStringFields(llvm::Value* P, llvm::Type* T, std::vector<llvm::Value*>& fields);
+    void initStrings(llvm::Value* P, llvm::Type* T, bool retain);
+    void releaseLocals();
+    const std::string* getPointee(const std::string& name);
+    llvm::Value* CreateHeapBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    std::string getTypeName(TokenType type, const std::string& identifier = "");
+    std::string getBaseTypeName(const std::string& name);
+    llvm::MDNode* getTBAAType(const std::string& name);
+    llvm::MDNode* getArrayTBAA(const ArrayInfo& info);
+    llvm::MDNode* getRecordTBAA(const std::string& recordType, int fieldIndex);
+    llvm::Value* getVariablePtr(const std::string& name, llvm::Type*& type);
+    std::string getTargetName(Expr& ast);
+    bool isConstantTarget(Expr& ast);
+    llvm::Value* getLValuePtr(Expr& ast, bool write = true);
+    llvm::Value* getAggregatePtr(Expr& ast, llvm::Type*& type);
+    bool hasPadding(llvm::Type* T);
+    llvm::Value* CreateAggregateAssign(llvm::Value* P, llvm::Type* T, Expr& value);
+    llvm::Value* CreateAggregateCompare(const std::string& op, Expr& lhs, Expr& rhs);
+    llvm::Type* getParamType(ParamDecl& param);
+    bool isWritten(const std::string& routine, const std::string& name);
+    bool mayContainType(llvm::Type* Outer, llvm::Type* Inner);
+    bool copiesValueParam(Prototype& proto, size_t index);
+    void bindArguments(llvm::Function* TheFunction, Prototype& proto);
+    llvm::Value* CreatePascalCall(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args);
+    llvm::Value* toCondition(llvm::Value* V);
+    llvm::Value* CreateCondBranch(Expr& cond, llvm::BasicBlock* TrueBB, llvm::BasicBlock* FalseBB);
+    bool getOrdinalConstant(Expr& ast, int& value);
+    bool getIntConstant(double value, int& result);
+    llvm::Value* toOrdinal(llvm::Value* V);
+    llvm::Type* getSetType(int max);
+    bool isSetType(llvm::Type* T);
+    int getSetBaseMax(int min, int max, const std::string& identifier);
+    bool isSetExpr(Expr& ast);
+    llvm::Value* CreateSetValue(Expr& value, llvm::Type* T, int max);
+    unsigned getSetBits(llvm::Type* T);
+    llvm::Value* convertSet(llvm::Value* V, llvm::Type* T);
+    llvm::Value* CreateSetMember(llvm::Value* element, llvm::Value* set);
+    llvm::Value* CreateSetOp(const std::string& op, llvm::Value* L, llvm::Value* R);
+
+    std::map<std::string, std::pair<int, int>> InductionRanges;
+    std::set<ForStmt*> WrittenLoops;
+    llvm::MDNode* TBAARoot = nullptr;
+    std::map<std::string, llvm::MDNode*> TBAATypes;
+    std::map<std::string, std::set<std::string>> RoutineWrites;
+    std::map<std::string, bool> RoutineWritesGlobals;
+    std::map<std::string, llvm::GlobalVariable*> StringLiterals;
+    std::set<llvm::Value*> StringTemps;
+    std::vector<llvm::Value*> StringLocals;
+    std::vector<llvm::Value*> DynArrayLocals;
+    std::vector<std::pair<llvm::Value*, std::string>> MapLocals;
+    std::vector<llvm::Value*> FileLocals;
+    std::vector<llvm::Value*> ChannelLocals;
+    std::map<std::string, int> GlobalChannels;
+    bool Spawned = false;
+    bool GlobalScope = false;
+    std::map<std::string, std::vector<bool>> ByReference;
+    std::map<std::string, std::vector<bool>> VarParams;
+    std::map<std::string, std::vector<llvm::Type*>> ParamTypes;
+    std::set<std::string> Iterators;
+    llvm::Value* CoroPromise = nullptr;
+    llvm::BasicBlock* CoroCleanup = nullptr;
+    llvm::BasicBlock* CoroSuspend = nullptr;
 
 public:
     llvm::Value* visit(NumberExpr& ast);
     llvm::Value* visit(StringExpr& ast);
     llvm::Value* visit(CharExpr& ast);
     llvm::Value* visit(BoolExpr& ast);
+    llvm::Value* visit(NilExpr& ast);
     llvm::Value* visit(VarExpr& ast);
     llvm::Value* visit(UnaryExpr& ast);
     llvm::Value* visit(BinaryExpr& ast);
     llvm::Value* visit(CallExpr& ast);
     llvm::Value* visit(ArrayExpr& ast);
     llvm::Value* visit(RecordExpr& ast);
+    llvm::Value* visit(SetExpr& ast);
 
     llvm::Value* visit(ExprStmt& ast);
     llvm::Value* visit(CallStmt& ast);
@@ -40,17 +173,23 @@ public:
     llvm::Value* visit(CaseStmt& ast);
     llvm::Value* visit(ReadStmt& ast);
     llvm::Value* visit(WriteStmt& ast);
+    llvm::Value* visit(YieldStmt& ast);
+    llvm::Value* visit(SpawnStmt& ast);
 
     llvm::Function* visit(Prototype& ast);
     void visit(ConstDecl& ast);
     void visit(TypeDecl& ast);
     void visit(RangeType& ast);
+    void visit(PointerType& ast);
     void visit(RecordType& ast);
     void visit(ArrayType& ast);
     void visit(EnumType& ast);
     void visit(VarDecl& ast);
     void visit(RecordVar& ast);
     void visit(ArrayVar& ast);
+    void visit(SetType& ast);
+    void visit(SetVar& ast);
+    void visit(ParamDecl& ast);
     llvm::Function* visit(FuncDecl& ast);
     llvm::Function* visit(ProcDecl& ast);
     void visit(Program& ast);
@@ -1,2 +1,414 @@
 #include "codegenVisitor.hpp"
+#include "callGraphVisitor.hpp"
+#include <algorithm>
 
+void CodegenVisitor::visit(ArrayVar& ast) {
+    auto recIt = RecordTypes.find(ast.identifier);
+    if (recIt != RecordTypes.end()) {
+        if (!ast.dims.empty()) {
+            LogErrorV("Multidimensional Arrays of Records are not supported");
+            return;
+        }
+        unsigned n = ast.max - ast.min + 1;
+        llvm::Type* T;
+        if (ast.soa) {
+            std::vector<llvm::Type*> columns;
+            for (llvm::Type* field : recIt->second.llvmType->elements()) {
+                columns.push_back(llvm::ArrayType::get(field, n));
+            }
+            T = llvm::StructType::create(*TheContext, columns, ast.identifier + ".soa");
+        } else {
+            T = llvm::ArrayType::get(recIt->second.llvmType, n);
+        }
+        CreateVariable(ast.name, T, ast.init.get());
+        ArrayVars[ast.name] = ArrayInfo{ T, ast.min, ast.max, ast.identifier, ast.soa };
+        VariableTypeMap[ast.name] = ast.identifier;
+        return;
+    }
+
+    if (ast.packed && ast.type == TokenType::tok_boolean && ast.dims.empty()) {
+        llvm::Type* T = getBitArrayType(ast.min, ast.max);
+        llvm::Value* V = CreateVariable(ast.name, T);
+        // Bits past max stay clear so whole-array counts and compares need no masking.
+        if (!GlobalScope) {
+            const llvm::DataLayout& DL = TheModule->getDataLayout();
+            Builder->CreateMemSet(V, Builder->getInt8(0), DL.getTypeAllocSize(T).getFixedValue(), DL.getABITypeAlign(T));
+        }
+        ArrayVars[ast.name] = ArrayInfo{ T, ast.min, ast.max, "boolean" };
+        ArrayVars[ast.name].bits = true;
+        return;
+    }
+
+    if (ast.type == TokenType::tok_string) {
+        LogErrorV("Arrays of Strings are not supported");
+        return;
+    }
+    llvm::Type* T = getArrayType(getElementType(getTypeName(ast.type, ast.identifier)), ast.min, ast.max, ast.dims);
+    CreateVariable(ast.name, T, ast.init.get());
+    ArrayVars[ast.name] = ArrayInfo{ T, ast.min, ast.max, getTypeName(ast.type, ast.identifier) };
+    ArrayVars[ast.name].dims = ast.dims;
+}
+
+void CodegenVisitor::visit(ArrayType& ast) {
+    if (ast.packed && ast.type == TokenType::tok_boolean && ast.dims.empty()) {
+        ArrayTypes[ast.name] = ArrayInfo{ getBitArrayType(ast.min, ast.max), ast.min, ast.max, "boolean" };
+        ArrayTypes[ast.name].bits = true;
+        return;
+    }
+    if (ast.type == TokenType::tok_string) {
+        LogErrorV("Arrays of Strings are not supported");
+        return;
+    }
+    llvm::Type* T = getArrayType(getElementType(getTypeName(ast.type, ast.identifier)), ast.min, ast.max, ast.dims);
+    ArrayTypes[ast.name] = ArrayInfo{ T, ast.min, ast.max, getTypeName(ast.type, ast.identifier) };
+    ArrayTypes[ast.name].dims = ast.dims;
+}
+
+void CodegenVisitor::visit(ParamDecl& ast) {}
+
+// Fields are ordered by decreasing alignment to remove padding; packed
+// records keep declaration order and get no padding at all. In a packed
+// record, consecutive subrange fields share one integer of up to 64 bits.
+void CodegenVisitor::visit(RecordType& ast) {
+    const llvm::DataLayout& DL = TheModule->getDataLayout();
+    std::vector<size_t> order;
+    for (size_t i = 0; i < ast.values.size(); i++) {
+        order.push_back(i);
+    }
+    if (!ast.packed) {
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return DL.getABITypeAlign(getFieldType(ast.values[a]->type, ast.values[a]->identifier)) > DL.getABITypeAlign(getFieldType(ast.values[b]->type, ast.values[b]->identifier));
+        });
+    }
+
+    std::vector<llvm::Type*> fields;
+    RecordInfo info;
+    unsigned bits = 0;
+    for (size_t i = 0; i < order.size(); i++) {
+        TypeDecl& field = *ast.values[order[i]];
+        auto rangeIt = RangeTypes.find(field.identifier);
+        if (ast.packed && rangeIt != RangeTypes.end()) {
+            uint64_t values = (uint64_t)((int64_t)rangeIt->second.second - rangeIt->second.first) + 1;
+            unsigned width = std::max(1u, llvm::Log2_64_Ceil(values));
+            if (bits == 0 || bits + width > 64) {
+                fields.push_back(nullptr);
+                info.fieldTypes.push_back("bits");
+                bits = 0;
+            }
+            info.fieldIndices[field.name] = fields.size() - 1;
+            info.bitFields[field.name] = BitField{ bits, width, rangeIt->second.first };
+            bits += width;
+            fields.back() = llvm::IntegerType::get(*TheContext, llvm::PowerOf2Ceil(std::max(bits, 8u)));
+            continue;
+        }
+        bits = 0;
+        info.fieldIndices[field.name] = fields.size();
+        fields.push_back(getFieldType(field.type, field.identifier));
+        info.fieldTypes.push_back(getTypeName(field.type, field.identifier));
+    }
+    info.llvmType = llvm::StructType::create(*TheContext, fields, ast.name, ast.packed);
+    info.packed = ast.packed;
+
+    RecordTypes[ast.name] = info;
+}
+
+void CodegenVisitor::visit(VarDecl& ast) {
+    // Globals start out zeroed, which is already an empty string, nil or empty array.
+    auto recIt = RecordTypes.find(ast.identifier);
+    if (recIt != RecordTypes.end()) {
+        llvm::Value* V = CreateVariable(ast.name, recIt->second.llvmType, ast.init.get());
+        if (!GlobalScope) {
+            initStrings(V, recIt->second.llvmType, false);
+        }
+        VariableTypeMap[ast.name] = ast.identifier;
+        return;
+    }
+
+    auto arrIt = ArrayTypes.find(ast.identifier);
+    if (arrIt != ArrayTypes.end()) {
+        CreateVariable(ast.name, arrIt->second.llvmType, ast.init.get());
+        ArrayVars[ast.name] = arrIt->second;
+        return;
+    }
+
+    auto setIt = SetTypes.find(ast.identifier);
+    if (setIt != SetTypes.end()) {
+        CreateVariable(ast.name, getSetType(setIt->second), ast.init.get());
+        SetVars[ast.name] = setIt->second;
+        return;
+    }
+
+    if (ast.type == TokenType::tok_pointer || PointerTypes.count(ast.identifier)) {
+        llvm::Type* Ptr = llvm::PointerType::get(*TheContext, 0);
+        llvm::Value* V = CreateVariable(ast.name, Ptr, ast.init.get());
+        if (!GlobalScope) {
+            Builder->CreateStore(llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(Ptr)), V);
+        }
+        VariableTypeMap[ast.name] = ast.type == TokenType::tok_pointer ? ast.identifier : PointerTypes[ast.identifier];
+        return;
+    }
+
+    if (ast.type == TokenType::tok_map) {
+        std::string kind = getMapKeyKind(ast.identifier);
+        if (kind.empty()) {
+            std::string m = "Unsupported Map Key Type " + ast.identifier;
+            LogErrorV(m.c_str());
+            return;
+        }
+        llvm::Value* V = CreateVariable(ast.name, getMapType(), ast.init.get());
+        MapVars[ast.name] = kind;
+        if (!GlobalScope) {
+            Builder->CreateStore(llvm::Constant::getNullValue(getMapType()), V);
+            MapLocals.push_back(std::make_pair(V, kind));
+        }
+        return;
+    }
+
+    if (ast.type == TokenType::tok_channel) {
+        llvm::Value* V = CreateVariable(ast.name, getChannelType(), ast.init.get());
+        if (GlobalScope) {
+            GlobalChannels[ast.name] = ast.capacity;
+        } else {
+            CreateRuntimeCall("__pascal_chan_init", llvm::Type::getVoidTy(*TheContext), { V, Builder->getInt64(ast.capacity) });
+            ChannelLocals.push_back(V);
+        }
+        return;
+    }
+
+    if (ast.type == TokenType::tok_text) {
+        llvm::Value* V = CreateVariable(ast.name, getTextType(), ast.init.get());
+        if (!GlobalScope) {
+            Builder->CreateStore(llvm::Constant::getNullValue(getTextType()), V);
+            FileLocals.push_back(V);
+        }
+        return;
+    }
+
+    if (ast.type == TokenType::tok_array) {
+        if (ast.identifier == "string") {
+            LogErrorV("Arrays of Strings are not supported");
+            return;
+        }
+        llvm::Value* V = CreateVariable(ast.name, getDynArrayType(), ast.init.get());
+        ArrayVars[ast.name] = ArrayInfo{ getDynArrayType(), 0, -1, getTypeName(ast.type, ast.identifier), false, true };
+        if (!GlobalScope) {
+            Builder->CreateStore(llvm::Constant::getNullValue(getDynArrayType()), V);
+            DynArrayLocals.push_back(V);
+        }
+        return;
+    }
+
+    if (ast.type == TokenType::tok_string || getBaseTypeName(ast.identifier) == "string") {
+        llvm::Value* V = CreateVariable(ast.name, getStringType(), ast.init.get());
+        if (!GlobalScope) {
+            initStrings(V, getStringType(), false);
+        }
+        return;
+    }
+
+    bool single = ast.type == TokenType::tok_single || getBaseTypeName(ast.identifier) == "single";
+    CreateVariable(ast.name, single ? llvm::Type::getFloatTy(*TheContext) : nullptr, ast.init.get());
+}
+
+void CodegenVisitor::visit(PointerType& ast) {
+    PointerTypes[ast.name] = ast.pointee;
+}
+
+// Untyped constants are constant globals like typed ones, so reads fold to the value.
+void CodegenVisitor::visit(ConstDecl& ast) {
+    llvm::Constant* C;
+    if (auto* S = dynamic_cast<StringExpr*>(ast.value.get())) {
+        C = getStringConstant(*S);
+    } else {
+        int ordinal;
+        auto* N = dynamic_cast<NumberExpr*>(ast.value.get());
+        if (N) {
+            C = llvm::ConstantFP::get(llvm::Type::getDoubleTy(*TheContext), N->value);
+        } else if (getOrdinalConstant(*ast.value, ordinal)) {
+            C = llvm::ConstantFP::get(llvm::Type::getDoubleTy(*TheContext), ordinal);
+        } else {
+            LogErrorV("Constant Value Expected");
+            return;
+        }
+    }
+    llvm::GlobalVariable* G = new llvm::GlobalVariable(*TheModule, C->getType(), true, llvm::GlobalValue::InternalLinkage, C, ast.name);
+    G->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    GlobalValues[ast.name] = G;
+}
+
+// Members are constants numbered from 0; the pre-pass in visit(Program) records the range.
+void CodegenVisitor::visit(EnumType& ast) {
+    for (auto& v : ast.values) {
+        if (auto* V = dynamic_cast<VarExpr*>(v.first.get())) {
+            llvm::Constant* C = llvm::ConstantFP::get(llvm::Type::getDoubleTy(*TheContext), v.second);
+            llvm::GlobalVariable* G = new llvm::GlobalVariable(*TheModule, C->getType(), true, llvm::GlobalValue::InternalLinkage, C, V->name);
+            GlobalValues[V->name] = G;
+        }
+    }
+}
+
+// Subranges and aliases are resolved in visit(Program) before anything refers to them.
+void CodegenVisitor::visit(RangeType& ast) {}
+void CodegenVisitor::visit(TypeDecl& ast) {}
+
+void CodegenVisitor::visit(SetType& ast) {
+    int max = getSetBaseMax(ast.min, ast.max, ast.identifier);
+    if (max >= 0) {
+        SetTypes[ast.name] = max;
+    }
+}
+
+void CodegenVisitor::visit(SetVar& ast) {
+    int max = getSetBaseMax(ast.min, ast.max, ast.identifier);
+    if (max >= 0) {
+        CreateVariable(ast.name, getSetType(max));
+        SetVars[ast.name] = max;
+    }
+}
+
+void CodegenVisitor::visit(RecordVar& ast) {
+    auto recIt = RecordTypes.find(ast.record);
+    if (recIt == RecordTypes.end()) {
+        std::string m = "Unknown Record Type " + ast.record;
+        LogErrorV(m.c_str());
+        return;
+    }
+
+    llvm::Value* V = CreateVariable(ast.name, recIt->second.llvmType);
+    if (!GlobalScope) {
+        initStrings(V, recIt->second.llvmType, false);
+    }
+    VariableTypeMap[ast.name] = ast.record;
+}
+
+void CodegenVisitor::visit(Program& ast) {
+    CallGraphVisitor CG;
+    CG.visit(ast);
+    CG.inferEffects();
+    RoutineWrites = CG.writes;
+    WrittenLoops = CG.writtenLoops;
+    for (auto& [name, e] : CG.effects) {
+        RoutineWritesGlobals[name] = e.writesGlobals;
+    }
+    std::set<std::string> reachable = CG.reachableFrom(ast.name);
+
+    // Pointer types first, so record fields can refer to types declared later.
+    for (auto& d : ast.decls) {
+        if (dynamic_cast<PointerType*>(d.get())) {
+            d->accept(*this);
+        }
+        auto* R = dynamic_cast<RangeType*>(d.get());
+        int lo, hi;
+        if (R && getOrdinalConstant(*R->min, lo) && getOrdinalConstant(*R->max, hi)) {
+            RangeTypes[R->name] = std::make_pair(lo, hi);
+        }
+        if (R) {
+            BaseTypes[R->name] = dynamic_cast<CharExpr*>(R->min.get()) ? "char" : "integer";
+        }
+        // An enumeration is the subrange of ordinals its members take.
+        if (auto* E = dynamic_cast<EnumType*>(d.get()); E && !E->values.empty()) {
+            RangeTypes[E->name] = std::make_pair(0, static_cast<int>(E->values.size()) - 1);
+            BaseTypes[E->name] = "integer";
+        }
+        if (auto* T = dynamic_cast<TypeDecl*>(d.get()); T && getTypeName(T->type, "") != "any") {
+            BaseTypes[T->name] = getTypeName(T->type, "");
+        }
+    }
+    for (auto& d : ast.decls) {
+        if (dynamic_cast<RecordType*>(d.get()) || dynamic_cast<ArrayType*>(d.get()) || dynamic_cast<SetType*>(d.get())) {
+            d->accept(*this);
+        }
+    }
+
+    // Program variables are globals, declared before the routines that use them.
+    GlobalScope = true;
+    for (auto& d : ast.decls) {
+        if (dynamic_cast<ConstDecl*>(d.get()) || dynamic_cast<EnumType*>(d.get()) || dynamic_cast<VarDecl*>(d.get()) || dynamic_cast<ArrayVar*>(d.get()) || dynamic_cast<SetVar*>(d.get()) || dynamic_cast<RecordVar*>(d.get())) {
+            d->accept(*this);
+        }
+    }
+    GlobalScope = false;
+    std::map<std::string, llvm::GlobalVariable*> globalValues = GlobalValues;
+    std::map<std::string, ArrayInfo> globalArrays = ArrayVars;
+    std::map<std::string, std::string> globalTypes = VariableTypeMap;
+    std::map<std::string, std::string> globalMaps = MapVars;
+    std::map<std::string, int> globalSets = SetVars;
+
+    int routines = 0;
+    int skippedRoutines = 0;
+    int skippedStmts = 0;
+    for (auto& d : ast.decls) {
+        if (!dynamic_cast<FuncDecl*>(d.get()) && !dynamic_cast<ProcDecl*>(d.get())) {
+            continue;
+        }
+        routines++;
+        if (!reachable.count(d->name)) {
+            skippedRoutines++;
+            skippedStmts += CG.statementCounts[d->name];
+            continue;
+        }
+        d->accept(*this);
+        GlobalValues = globalValues;
+        ArrayVars = globalArrays;
+        VariableTypeMap = globalTypes;
+        MapVars = globalMaps;
+        SetVars = globalSets;
+
+        if (llvm::Function* F = TheModule->getFunction(d->name)) {
+            std::string attrs = addInferredAttributes(F, CG.effects[d->name]);
+            if (ReportStats) {
+                fprintf(stderr, "%s:%s\n", d->name.c_str(), attrs.c_str());
+            }
+        }
+    }
+
+    if (ReportStats) {
+        fprintf(stderr, "Skipped %d of %d routines (%d statements)\n", skippedRoutines, routines, skippedStmts);
+    }
+
+    llvm::FunctionType* FT = llvm::FunctionType::get(llvm::Type::getInt32Ty(*TheContext), false);
+    llvm::Function* TheFunction = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, "main", TheModule.get());
+    llvm::BasicBlock* BB = llvm::BasicBlock::Create(*TheContext, "entry", TheFunction);
+    Builder->SetInsertPoint(BB);
+
+    NamedValues.clear();
+    ReferenceTypes.clear();
+    StringLocals.clear();
+    DynArrayLocals.clear();
+    MapLocals.clear();
+    FileLocals.clear();
+    ChannelLocals.clear();
+    for (auto& [name, G] : GlobalValues) {
+        if (G->isConstant()) {
+            continue;
+        }
+        if (G->getValueType() == getDynArrayType()) {
+            DynArrayLocals.push_back(G);
+        } else if (G->getValueType() == getMapType()) {
+            MapLocals.push_back(std::make_pair(G, MapVars[name]));
+        } else if (G->getValueType() == getTextType()) {
+            FileLocals.push_back(G);
+        } else if (G->getValueType() == getChannelType()) {
+            CreateRuntimeCall("__pascal_chan_init", llvm::Type::getVoidTy(*TheContext), { G, Builder->getInt64(GlobalChannels[name]) });
+            ChannelLocals.push_back(G);
+        } else {
+            getStringFields(G, G->getValueType(), StringLocals);
+        }
+    }
+
+    for (auto& s : ast.body) {
+        if (!s->accept(*this)) {
+            TheFunction->eraseFromParent();
+            return;
+        }
+    }
+
+    if (Spawned) {
+        CreateRuntimeCall("__pascal_spawn_wait", llvm::Type::getVoidTy(*TheContext), {});
+    }
+    releaseLocals();
+    if (HeapStats) {
+        CreateRuntimeCall("__pascal_heap_stats", llvm::Type::getVoidTy(*TheContext), {});
+    }
+    Builder->CreateRet(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0));
+}
@@ -4,26 +4,54 @@ llvm::Value* CodegenVisitor::visit(NumberExpr& ast) {
     return llvm::ConstantFP::get(*TheContext, llvm::APFloat(ast.value));
 };
 
+// Identical literals share one constant string. Short ones are stored inline and
+// longer ones point at a buffer the runtime never frees, so literals never allocate.
 llvm::Value* CodegenVisitor::visit(StringExpr& ast) {
-    llvm::Constant* str = llvm::ConstantDataArray::getString(*TheContext, ast.value, true);
+    auto it = StringLiterals.find(ast.value);
+    if (it != StringLiterals.end()) {
+        return it->second;
+    }
+
+    llvm::Type* Int8 = llvm::Type::getInt8Ty(*TheContext);
+    llvm::Type* Int32 = llvm::Type::getInt32Ty(*TheContext);
+    uint32_t len = ast.value.size();
+
+    llvm::Constant* str;
+    if (len <= 15) {
+        std::string chars = ast.value;
+        chars.resize(15, '\0');
+        str = llvm::ConstantStruct::getAnon({
+            llvm::ConstantDataArray::getString(*TheContext, chars, false),
+            llvm::ConstantInt::get(Int8, len)
+        }, true);
+    } else {
+        llvm::Constant* buf = llvm::ConstantStruct::getAnon({
+            llvm::ConstantInt::get(llvm::Type::getInt64Ty(*TheContext), -1),
+            llvm::ConstantInt::get(Int32, len),
+            llvm::ConstantDataArray::getString(*TheContext, ast.value, false)
+        });
+        llvm::GlobalVariable* gBuf = new llvm::GlobalVariable(*TheModule, buf->getType(), true, llvm::GlobalValue::PrivateLinkage, buf, ".strbuf");
+        str = llvm::ConstantStruct::getAnon({
+            gBuf,
+            llvm::ConstantInt::get(Int32, len),
+            llvm::ConstantAggregateZero::get(llvm::ArrayType::get(Int8, 3)),
+            llvm::ConstantInt::get(Int8, 0xFF)
+        });
+    }
+
     llvm::GlobalVariable* gStr = new llvm::GlobalVariable(
-        *TheModule, 
+        *TheModule,
         str->getType(),
         true,
         llvm::GlobalValue::PrivateLinkage,
         str,
         ".str"
     );
+    gStr->setAlignment(llvm::Align(8));
+    gStr->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
 
-    llvm::Constant* zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0);
-    std::vector<llvm::Constant*> indices = { zero, zero };
-    llvm::Constant* strPtr = llvm::ConstantExpr::getGetElementPtr(
-        str->getType(),
-        gStr,
-        indices
-    );
-
-    return strPtr;
+    StringLiterals[ast.value] = gStr;
+    return gStr;
 };
 
 llvm::Value* CodegenVisitor::visit(CharExpr& ast) {
@@ -34,14 +62,26 @@ llvm::Value* CodegenVisitor::visit(BoolExpr& ast) {
     return llvm::ConstantInt::get(*TheContext, llvm::APInt(1, ast.value ? 1 : 0));
 };
 
+llvm::Value* CodegenVisitor::visit(NilExpr& ast) {
+    return llvm::ConstantPointerNull::get(llvm::PointerType::get(*TheContext, 0));
+};
+
 llvm::Value* CodegenVisitor::visit(VarExpr& ast) {
-    llvm::AllocaInst* A = NamedValues[ast.name];
+    llvm::Type* T;
+    llvm::Value* A = getVariablePtr(ast.name, T);
     if (!A) {
         std::string msg = "Unknown variable name: " + ast.name;
         return LogErrorV(msg.c_str());
     }
 
-    return Builder->CreateLoad(A->getAllocatedType(), A, ast.name.c_str());
+    if (T == getStringType()) {
+        return A;
+    }
+    llvm::GlobalVariable* G = getConstantGlobal(ast.name);
+    if (G && !T->isAggregateType()) {
+        return G->getInitializer();
+    }
+    return Builder->CreateLoad(T, A, ast.name.c_str());
 };
 
 llvm::Value* CodegenVisitor::visit(UnaryExpr& ast) {
@@ -51,12 +91,11 @@ llvm::Value* CodegenVisitor::visit(UnaryExpr& ast) {
     }
 
     if (ast.op == "not") {
-        OpV = Builder->CreateFCmpONE(OpV, llvm::ConstantFP::get(*TheContext, llvm::APFloat(0.0)), "cond");
+        OpV = Builder->CreateFCmpONE(OpV, llvm::ConstantFP::get(OpV->getType(), 0.0), "cond");
         OpV = Builder->CreateNot(OpV, "nottmp");
         return Builder->CreateUIToFP(OpV, llvm::Type::getDoubleTy(*TheContext), "booltmp");
     } else if (ast.op == "-") {
-        llvm::Value *Zero = llvm::ConstantFP::get(*TheContext, llvm::APFloat(0.0));
-        return Builder->CreateFSub(Zero, OpV, "negtmp");
+        return Builder->CreateFNeg(OpV, "negtmp");
     }
 
     llvm::Function* f = getFunction(std::string("unary") + ast.op);
@@ -68,9 +107,59 @@ llvm::Value* CodegenVisitor::visit(UnaryExpr& ast) {
 }
 
 llvm::Value* CodegenVisitor::visit(BinaryExpr& ast) {
+    if (ShortCircuit && (ast.op == "and" || ast.op == "or")) {
+        llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+        llvm::BasicBlock* TrueBB = llvm::BasicBlock::Create(*TheContext, "sctrue", TheFunction);
+        llvm::BasicBlock* FalseBB = llvm::BasicBlock::Create(*TheContext, "scfalse", TheFunction);
+        llvm::BasicBlock* MergeBB = llvm::BasicBlock::Create(*TheContext, "scmerge", TheFunction);
+        if (!CreateCondBranch(ast, TrueBB, FalseBB)) {
+            return nullptr;
+        }
+
+        Builder->SetInsertPoint(TrueBB);
+        Builder->CreateBr(MergeBB);
+        Builder->SetInsertPoint(FalseBB);
+        Builder->CreateBr(MergeBB);
+
+        Builder->SetInsertPoint(MergeBB);
+        llvm::PHINode* PN = Builder->CreatePHI(llvm::Type::getDoubleTy(*TheContext), 2, "sctmp");
+        PN->addIncoming(llvm::ConstantFP::get(*TheContext, llvm::APFloat(1.0)), TrueBB);
+        PN->addIncoming(llvm::ConstantFP::get(*TheContext, llvm::APFloat(0.0)), FalseBB);
+        return PN;
+    }
+
+    llvm::Type* AggregateT;
+    if (getAggregatePtr(*ast.lhs, AggregateT)) {
+        return CreateAggregateCompare(ast.op, *ast.lhs, *ast.rhs);
+    }
+
     llvm::Value* L = ast.lhs->accept(*this);
     llvm::Value* R = ast.rhs->accept(*this);
+    if (!L || !R) {
+        return nullptr;
+    }
+
+    if (ast.op == "in") {
+        if (!isSetExpr(*ast.rhs) || isSetExpr(*ast.lhs)) {
+            return LogErrorV("Right Operand of in Must be a Set");
+        }
+        return Builder->CreateUIToFP(CreateSetMember(L, R), llvm::Type::getDoubleTy(*TheContext), "booltmp");
+    } else if (isSetExpr(*ast.lhs) || isSetExpr(*ast.rhs)) {
+        if (!isSetExpr(*ast.lhs) || !isSetExpr(*ast.rhs)) {
+            return LogErrorV("Both Operands Must be Sets");
+        }
+        return CreateSetOp(ast.op, L, R);
+    } else if (isStringExpr(*ast.lhs) || isStringExpr(*ast.rhs)) {
+        return CreateStringOp(ast.op, L, R);
+    } else if (L->getType()->isPointerTy() && R->getType()->isPointerTy()) {
+        if (ast.op != "==" && ast.op != "<>") {
+            return LogErrorV("Pointers Can Only be Compared for Equality");
+        }
+        L = ast.op == "==" ? Builder->CreateICmpEQ(L, R, "cmptmp") : Builder->CreateICmpNE(L, R, "cmptmp");
+        return Builder->CreateUIToFP(L, llvm::Type::getDoubleTy(*TheContext), "booltmp");
+    }
 
+    unifyFloats(L, R);
     if (ast.op == "+") {
         return Builder->CreateFAdd(L, R, "addtmp");
     } else if (ast.op == "-") {
@@ -98,13 +187,13 @@ llvm::Value* CodegenVisitor::visit(BinaryExpr& ast) {
         L = Builder->CreateFCmpUEQ(L, R, "cmptmp");
         return Builder->CreateUIToFP(L, llvm::Type::getDoubleTy(*TheContext), "booltmp");
     } else if (ast.op == "and") {
-        L = Builder->CreateFCmpONE(L, llvm::ConstantFP::get(*TheContext, llvm::APFloat(0.0)), "lcond");
-        R = Builder->CreateFCmpONE(R, llvm::ConstantFP::get(*TheContext, llvm::APFloat(0.0)), "rcond");
+        L = Builder->CreateFCmpONE(L, llvm::ConstantFP::get(L->getType(), 0.0), "lcond");
+        R = Builder->CreateFCmpONE(R, llvm::ConstantFP::get(R->getType(), 0.0), "rcond");
         L = Builder->CreateAnd(L, R, "andtmp");
         return Builder->CreateUIToFP(L, llvm::Type::getDoubleTy(*TheContext), "booltmp");
     } else if (ast.op == "or") {
-        L = Builder->CreateFCmpONE(L, llvm::ConstantFP::get(*TheContext, llvm::APFloat(0.0)), "lcond");
-        R = Builder->CreateFCmpONE(R, llvm::ConstantFP::get(*TheContext, llvm::APFloat(0.0)), "rcond");
+        L = Builder->CreateFCmpONE(L, llvm::ConstantFP::get(L->getType(), 0.0), "lcond");
+        R = Builder->CreateFCmpONE(R, llvm::ConstantFP::get(R->getType(), 0.0), "rcond");
         L = Builder->CreateOr(L, R, "ortmp");
         return Builder->CreateUIToFP(L, llvm::Type::getDoubleTy(*TheContext), "booltmp");
     } else if (ast.op == "mod") {
@@ -121,72 +210,206 @@ llvm::Value* CodegenVisitor::visit(BinaryExpr& ast) {
 }
 
 llvm::Value* CodegenVisitor::visit(CallExpr& ast) {
-    llvm::Function* Callee = TheModule->getFunction(ast.callee);
-    if (!Callee) {
-        return LogErrorV("Unknown Function Referenced");
+    if (isArrayBuiltin(ast.callee, ast.args)) {
+        return CreateArrayBuiltin(ast.callee, ast.args);
     }
 
-    if (Callee->arg_size()!= ast.args.size()) {
-        return LogErrorV("Incorrect Number of Arguments");
+    if (isFileBuiltin(ast.callee, ast.args)) {
+        return CreateFileBuiltin(ast.callee, ast.args);
     }
 
-    std::vector<llvm::Value*> Args;
+    if (isChannelBuiltin(ast.callee, ast.args)) {
+        return CreateChannelBuiltin(ast.callee, ast.args);
+    }
+
+    if (isMathBuiltin(ast.callee, ast.args)) {
+        return CreateMathBuiltin(ast.callee, ast.args);
+    }
 
-    for (unsigned i = 0; i != ast.args.size(); i++) {
-        Args.push_back(ast.args[i]->accept(*this));
-        if (!Args.back()) {
+    if (ast.callee == "card" && ast.args.size() == 1) {
+        auto* V = dynamic_cast<VarExpr*>(ast.args[0].get());
+        if (V && ArrayVars.count(V->name) && ArrayVars[V->name].bits) {
+            return CreateBitsBuiltin(ast.callee, ast.args);
+        }
+        if (!isSetExpr(*ast.args[0])) {
+            return LogErrorV("card Expects a Set");
+        }
+        llvm::Value* S = ast.args[0]->accept(*this);
+        if (!S) {
             return nullptr;
         }
+        llvm::Value* Count = Builder->CreateUnaryIntrinsic(llvm::Intrinsic::ctpop, S);
+        if (Count->getType()->isVectorTy()) {
+            Count = Builder->CreateAddReduce(Count);
+        }
+        return Builder->CreateUIToFP(Count, llvm::Type::getDoubleTy(*TheContext), "card");
+    }
+
+    if ((ast.callee == "contains" || ast.callee == "length") && !ast.args.empty()) {
+        auto* V = dynamic_cast<VarExpr*>(ast.args[0].get());
+        if (V && MapVars.count(V->name)) {
+            return CreateMapBuiltin(ast.callee, ast.args);
+        }
     }
 
-    return Builder->CreateCall(Callee, Args, "calltmp");
+    if ((ast.callee == "low" || ast.callee == "high" || ast.callee == "length") && ast.args.size() == 1) {
+        auto* V = dynamic_cast<VarExpr*>(ast.args[0].get());
+        if (V && !isStringTarget(*V) && ArrayVars.count(V->name)) {
+            return CreateArrayBound(ast.callee, V->name);
+        }
+    }
+
+    if (ast.callee == "length" && ast.args.size() == 1) {
+        llvm::Value* S = ast.args[0]->accept(*this);
+        if (!S) {
+            return nullptr;
+        }
+        S = toStringValue(S);
+        llvm::Value* N = CreateStringCall("length", llvm::Type::getInt64Ty(*TheContext), { S });
+        releaseStringTemp(S);
+        return Builder->CreateSIToFP(N, llvm::Type::getDoubleTy(*TheContext), "length");
+    }
+
+    if (ast.callee == "pos" && ast.args.size() == 2) {
+        llvm::Value* Sub = ast.args[0]->accept(*this);
+        llvm::Value* S = ast.args[1]->accept(*this);
+        if (!Sub || !S) {
+            return nullptr;
+        }
+        Sub = toStringValue(Sub);
+        S = toStringValue(S);
+        llvm::Value* N = CreateStringCall("pos", llvm::Type::getInt64Ty(*TheContext), { Sub, S });
+        releaseStringTemp(Sub);
+        releaseStringTemp(S);
+        return Builder->CreateSIToFP(N, llvm::Type::getDoubleTy(*TheContext), "pos");
+    }
+
+    if (Iterators.count(ast.callee)) {
+        return LogErrorV("Iterator Functions Can Only be Called in For-In Loops");
+    }
+
+    return CreatePascalCall(ast.callee, ast.args);
 }
 
 llvm::Value* CodegenVisitor::visit(ArrayExpr& ast) {
-    llvm::AllocaInst* A = NamedValues[ast.arr->name];
-    if (!A) {
-        std::string m = "Uknown Array Name" + ast.arr->name;
-        return LogErrorV(m.c_str());
+    // A missing key reads as zero.
+    if (MapVars.count(ast.arr->name) && ast.subscripts.empty()) {
+        return CreateMapCall("get", ast.arr->name, *ast.index, llvm::Type::getDoubleTy(*TheContext));
+    }
+    auto infoIt = ArrayVars.find(ast.arr->name);
+    if (infoIt != ArrayVars.end() && infoIt->second.bits) {
+        return CreateBitLoad(ast);
+    }
+    if (llvm::Constant* C = foldConstantElement(ast)) {
+        return C;
     }
 
-    llvm::Value* I = ast.index->accept(*this);
-    if (!I) {
+    llvm::Value* P = getArrayElementPtr(ast);
+    if (!P) {
         return nullptr;
     }
 
-    I = Builder->CreateFPToSI(I, llvm::Type::getInt32Ty(*TheContext), "idx");
-
-    llvm::Value* P = Builder->CreateGEP(
-        A->getAllocatedType(),
-        A, 
-        { llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0), I },
-        "arrayelement"
-    );
-
-    return Builder->CreateLoad(llvm::Type::getDoubleTy(*TheContext), P, "arrayload");
+    llvm::LoadInst* L = Builder->CreateLoad(getElementType(ArrayVars[ast.arr->name].elementType), P, "arrayload");
+    L->setMetadata(llvm::LLVMContext::MD_tbaa, getArrayTBAA(ArrayVars[ast.arr->name]));
+    return L;
 }
     
 llvm::Value* CodegenVisitor::visit(RecordExpr& ast) {
-    llvm::AllocaInst* A = NamedValues[ast.record->name];
-    if (!A) {
-        std::string m = "Uknown Record Name" + ast.record->name;
-        return LogErrorV(m.c_str());
+    if (const BitField* B = getBitField(ast)) {
+        return CreateBitFieldLoad(ast, *B);
+    }
+    if (llvm::Constant* C = foldConstantField(ast)) {
+        return C;
     }
 
-    int fieldIndex = getFieldIndex(ast.record->name, ast.field);
-    if (fieldIndex == -1) {
-        return LogErrorV("Unknown Record Field");
+    llvm::Value* P = getRecordFieldPtr(ast);
+    if (!P) {
+        return nullptr;
     }
 
-    llvm::Value* P = Builder->CreateGEP(
-        A->getAllocatedType(),
-        A, 
-        {
-            llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0),
-            llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), fieldIndex)
-        },
-        "recordfield"
-    );
+    if (getRecordFieldType(ast) == getStringType()) {
+        return P;
+    }
+    llvm::LoadInst* L = Builder->CreateLoad(getRecordFieldType(ast), P, "recordload");
+    L->setMetadata(llvm::LLVMContext::MD_tbaa, getRecordFieldTBAA(ast));
+    // Boolean and char fields are stored narrow but used as reals, like variables.
+    if (L->getType()->isIntegerTy(1) || L->getType()->isIntegerTy(8)) {
+        return convertValue(L, llvm::Type::getDoubleTy(*TheContext));
+    }
+    return L;
+}
+
+llvm::Value* CodegenVisitor::visit(SetExpr& ast) {
+    int max = -1;
+    bool constant = true;
+    std::vector<std::pair<int, int>> ranges;
+    for (auto& e : ast.elements) {
+        int lo, hi;
+        if (!getOrdinalConstant(*e.first, lo) || (e.second && !getOrdinalConstant(*e.second, hi))) {
+            constant = false;
+            break;
+        }
+        if (!e.second) {
+            hi = lo;
+        }
+        if (lo < 0 || hi > 255) {
+            return LogErrorV("Set Element Out of Range");
+        }
+        ranges.push_back(std::make_pair(lo, hi));
+        max = std::max(max, hi);
+    }
+
+    llvm::Type* T = getSetType(constant ? max : 255);
+    unsigned bits = getSetBits(T);
+    llvm::IntegerType* Bits = llvm::Type::getIntNTy(*TheContext, bits);
+
+    if (constant) {
+        llvm::APInt value(bits, 0);
+        for (auto& r : ranges) {
+            for (int v = r.first; v <= r.second; v++) {
+                value.setBit(v);
+            }
+        }
+        llvm::Constant* C = llvm::ConstantInt::get(*TheContext, value);
+        return T->isVectorTy() ? llvm::ConstantExpr::getBitCast(C, T) : C;
+    }
+
+    // Elements outside 0..255 are left out; a shift by that much would be poison.
+    llvm::Type* Int32 = llvm::Type::getInt32Ty(*TheContext);
+    llvm::Value* Zero = llvm::ConstantInt::get(Int32, 0);
+    llvm::Value* Last = llvm::ConstantInt::get(Int32, bits - 1);
+    llvm::Value* Empty = llvm::ConstantInt::get(Bits, 0);
+    llvm::Value* Acc = Empty;
+    for (auto& e : ast.elements) {
+        llvm::Value* Lo = e.first->accept(*this);
+        if (!Lo) {
+            return nullptr;
+        }
+        Lo = toOrdinal(Lo);
+
+        if (!e.second) {
+            llvm::Value* Bit = Builder->CreateShl(llvm::ConstantInt::get(Bits, 1), Builder->CreateZExt(Lo, Bits));
+            Bit = Builder->CreateSelect(Builder->CreateICmpULE(Lo, Last), Bit, Empty);
+            Acc = Builder->CreateOr(Acc, Bit, "setelem");
+            continue;
+        }
+
+        llvm::Value* Hi = e.second->accept(*this);
+        if (!Hi) {
+            return nullptr;
+        }
+        Hi = toOrdinal(Hi);
+        Lo = Builder->CreateSelect(Builder->CreateICmpSLT(Lo, Zero), Zero, Lo, "setlo");
+        Hi = Builder->CreateSelect(Builder->CreateICmpSGT(Hi, Last), Last, Hi, "sethi");
+        llvm::Value* Ones = llvm::ConstantInt::getAllOnesValue(Bits);
+        llvm::Value* Mask = Builder->CreateAnd(
+            Builder->CreateLShr(Ones, Builder->CreateZExt(Builder->CreateSub(Last, Hi), Bits)),
+            Builder->CreateShl(Ones, Builder->CreateZExt(Lo, Bits)),
+            "setrange"
+        );
+        Mask = Builder->CreateSelect(Builder->CreateICmpSLE(Lo, Hi), Mask, Empty);
+        Acc = Builder->CreateOr(Acc, Mask, "setelem");
+    }
 
-    return Builder->CreateLoad(llvm::Type::getDoubleTy(*TheContext), P, "recordload");
+    return T->isVectorTy() ? Builder->CreateBitCast(Acc, T, "setwords") : Acc;
 }
@@ -1,7 +1,11 @@
 #include "codegenVisitor.hpp"
+#include "callGraphVisitor.hpp"
+
+#include <climits>
 
 llvm::Value* CodegenVisitor::LogErrorV(const char *str) {
     fprintf(stderr, "Error: %s\n", str);
+    Errors++;
     return nullptr;
 };
 
@@ -18,11 +22,333 @@ llvm::Function* CodegenVisitor::getFunction(std::string name) {
     return nullptr;
 };
 
-llvm::AllocaInst* CodegenVisitor::CreateEntryBlockAlloca(llvm::Function* TheFunction, llvm::StringRef name) {
+llvm::AllocaInst* CodegenVisitor::CreateEntryBlockAlloca(llvm::Function* TheFunction, llvm::StringRef name, llvm::Type* type) {
+    if (!type) {
+        type = llvm::Type::getDoubleTy(*TheContext);
+    }
     llvm::IRBuilder<> TmpB(&TheFunction->getEntryBlock(), TheFunction->getEntryBlock().begin());
-    return TmpB.CreateAlloca(llvm::Type::getDoubleTy(*TheContext), nullptr, name);
+    return TmpB.CreateAlloca(type, nullptr, name);
 };
 
+// array[a..b, c..d] of real is [b-a+1 x [d-c+1 x double]]: one contiguous row-major block.
+llvm::Type* CodegenVisitor::getArrayType(llvm::Type* element, int min, int max, const std::vector<std::pair<int, int>>& dims) {
+    llvm::Type* T = element;
+    for (auto it = dims.rbegin(); it != dims.rend(); ++it) {
+        T = llvm::ArrayType::get(T, it->second - it->first + 1);
+    }
+    return llvm::ArrayType::get(T, max - min + 1);
+}
+
+// Arrays hold doubles unless declared of single.
+llvm::Type* CodegenVisitor::getElementType(const std::string& elementType) {
+    if (elementType == "single") {
+        return llvm::Type::getFloatTy(*TheContext);
+    }
+    return llvm::Type::getDoubleTy(*TheContext);
+}
+
+// Record fields left out of a constant are zero.
+llvm::Constant* CodegenVisitor::getConstInit(ConstInit& init, llvm::Type* T) {
+    if (auto* A = llvm::dyn_cast<llvm::ArrayType>(T)) {
+        if (init.value || init.items.size() != A->getNumElements()) {
+            return static_cast<llvm::Constant*>(LogErrorV("Wrong Number of Elements in Constant Array"));
+        }
+        std::vector<llvm::Constant*> elements;
+        for (auto& item : init.items) {
+            elements.push_back(getConstInit(*item, A->getElementType()));
+            if (!elements.back()) {
+                return nullptr;
+            }
+        }
+        return llvm::ConstantArray::get(A, elements);
+    }
+
+    if (auto* S = llvm::dyn_cast<llvm::StructType>(T)) {
+        const RecordInfo* info = nullptr;
+        for (auto& r : RecordTypes) {
+            if (r.second.llvmType == S) {
+                info = &r.second;
+            }
+        }
+        if (!info || init.value || !info->bitFields.empty()) {
+            return static_cast<llvm::Constant*>(LogErrorV("Unsupported Type for Typed Constant"));
+        }
+        std::vector<llvm::Constant*> fields;
+        for (llvm::Type* F : S->elements()) {
+            fields.push_back(llvm::Constant::getNullValue(F));
+        }
+        for (auto& item : init.items) {
+            auto it = info->fieldIndices.find(item->field);
+            if (it == info->fieldIndices.end()) {
+                std::string m = "Unknown Record Field " + item->field;
+                return static_cast<llvm::Constant*>(LogErrorV(m.c_str()));
+            }
+            fields[it->second] = getConstInit(*item, S->getElementType(it->second));
+            if (!fields[it->second]) {
+                return nullptr;
+            }
+        }
+        return llvm::ConstantStruct::get(S, fields);
+    }
+
+    if (!init.value) {
+        return static_cast<llvm::Constant*>(LogErrorV("Constant Value Expected"));
+    }
+    auto* N = dynamic_cast<NumberExpr*>(init.value.get());
+    int ordinal;
+    if (T->isFloatingPointTy() && N) {
+        return llvm::ConstantFP::get(T, N->value);
+    }
+    if ((T->isIntegerTy(8) || T->isIntegerTy(1)) && getOrdinalConstant(*init.value, ordinal)) {
+        return llvm::ConstantInt::get(T, T->isIntegerTy(1) ? ordinal != 0 : ordinal);
+    }
+    return static_cast<llvm::Constant*>(LogErrorV("Unsupported Type for Typed Constant"));
+}
+
+// A typed constant not hidden by a local or parameter of the same name.
+llvm::GlobalVariable* CodegenVisitor::getConstantGlobal(const std::string& name) {
+    auto localIt = NamedValues.find(name);
+    if (localIt != NamedValues.end() && localIt->second) {
+        return nullptr;
+    }
+    auto it = GlobalValues.find(name);
+    return it != GlobalValues.end() && it->second->isConstant() ? it->second : nullptr;
+}
+
+// Elements of typed constants read at constant indices fold to their value.
+llvm::Constant* CodegenVisitor::foldConstantElement(ArrayExpr& ast) {
+    llvm::GlobalVariable* G = getConstantGlobal(ast.arr->name);
+    if (!G || ast.subscripts.size() != ArrayVars[ast.arr->name].dims.size()) {
+        return nullptr;
+    }
+    const ArrayInfo& info = ArrayVars[ast.arr->name];
+    std::vector<std::pair<Expr*, std::pair<int, int>>> indices = { std::make_pair(ast.index.get(), std::make_pair(info.min, info.max)) };
+    for (size_t d = 0; d < ast.subscripts.size(); d++) {
+        indices.push_back(std::make_pair(ast.subscripts[d].get(), info.dims[d]));
+    }
+
+    llvm::Constant* C = G->getInitializer();
+    for (auto& index : indices) {
+        int i;
+        if (!C || !getOrdinalConstant(*index.first, i) || i < index.second.first || i > index.second.second) {
+            return nullptr;
+        }
+        C = C->getAggregateElement(i - index.second.first);
+    }
+    return C;
+}
+
+llvm::Constant* CodegenVisitor::foldConstantField(RecordExpr& ast) {
+    llvm::GlobalVariable* G = ast.deref ? nullptr : getConstantGlobal(ast.record->name);
+    int fieldIndex = getFieldIndex(ast.record->name, ast.field);
+    if (!G || fieldIndex == -1) {
+        return nullptr;
+    }
+
+    llvm::Constant* C = G->getInitializer();
+    if (ast.index) {
+        const ArrayInfo& info = ArrayVars[ast.record->name];
+        int i;
+        if (info.soa || !getOrdinalConstant(*ast.index, i) || i < info.min || i > info.max) {
+            return nullptr;
+        }
+        C = C->getAggregateElement(i - info.min);
+    }
+    return C ? C->getAggregateElement(fieldIndex) : nullptr;
+}
+
+// packed array of boolean keeps one bit per element in 64-bit words.
+llvm::Type* CodegenVisitor::getBitArrayType(int min, int max) {
+    return llvm::ArrayType::get(llvm::Type::getInt64Ty(*TheContext), (max - min + 64) / 64);
+}
+
+llvm::Value* CodegenVisitor::getBitWordPtr(ArrayExpr& ast, llvm::Value*& mask) {
+    const ArrayInfo& info = ArrayVars[ast.arr->name];
+    llvm::Type* T;
+    llvm::Value* A = getVariablePtr(ast.arr->name, T);
+    if (!A) {
+        return nullptr;
+    }
+    if (!ast.subscripts.empty()) {
+        return LogErrorV("Packed Boolean Arrays Have One Dimension");
+    }
+    llvm::Value* I = getArrayIndex(*ast.index, info);
+    if (!I) {
+        return nullptr;
+    }
+
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    llvm::Value* Bit = Builder->CreateZExt(Builder->CreateAnd(I, 63), Int64, "bit");
+    mask = Builder->CreateShl(llvm::ConstantInt::get(Int64, 1), Bit, "mask");
+    llvm::Value* Word = Builder->CreateLShr(I, 6, "word");
+    return Builder->CreateGEP(T, A, { llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0), Word }, "bitword");
+}
+
+llvm::Value* CodegenVisitor::CreateBitLoad(ArrayExpr& ast) {
+    llvm::Value* Mask;
+    llvm::Value* P = getBitWordPtr(ast, Mask);
+    if (!P) {
+        return nullptr;
+    }
+    llvm::LoadInst* W = Builder->CreateLoad(Mask->getType(), P, "bits");
+    W->setMetadata(llvm::LLVMContext::MD_tbaa, getArrayTBAA(ArrayVars[ast.arr->name]));
+    llvm::Value* Set = Builder->CreateICmpNE(Builder->CreateAnd(W, Mask), llvm::ConstantInt::get(Mask->getType(), 0), "bittest");
+    return Builder->CreateUIToFP(Set, llvm::Type::getDoubleTy(*TheContext), "booltmp");
+}
+
+llvm::Value* CodegenVisitor::CreateBitStore(ArrayExpr& ast, llvm::Value* V) {
+    llvm::Value* Mask;
+    llvm::Value* P = getBitWordPtr(ast, Mask);
+    if (!P) {
+        return nullptr;
+    }
+    llvm::MDNode* TBAA = getArrayTBAA(ArrayVars[ast.arr->name]);
+    llvm::LoadInst* W = Builder->CreateLoad(Mask->getType(), P, "bits");
+    W->setMetadata(llvm::LLVMContext::MD_tbaa, TBAA);
+    llvm::Value* Set = Builder->CreateOr(W, Mask, "bitset");
+    llvm::Value* Clear = Builder->CreateAnd(W, Builder->CreateNot(Mask), "bitclear");
+    llvm::StoreInst* S = Builder->CreateStore(Builder->CreateSelect(toCondition(V), Set, Clear), P);
+    S->setMetadata(llvm::LLVMContext::MD_tbaa, TBAA);
+    return V;
+}
+
+const BitField* CodegenVisitor::getBitField(RecordExpr& ast) {
+    auto typeIt = VariableTypeMap.find(ast.record->name);
+    if (typeIt == VariableTypeMap.end() || !RecordTypes.count(typeIt->second)) {
+        return nullptr;
+    }
+    const RecordInfo& info = RecordTypes[typeIt->second];
+    auto it = info.bitFields.find(ast.field);
+    return it == info.bitFields.end() ? nullptr : &it->second;
+}
+
+llvm::Value* CodegenVisitor::CreateBitFieldLoad(RecordExpr& ast, const BitField& field) {
+    llvm::Value* P = getRecordFieldPtr(ast);
+    if (!P) {
+        return nullptr;
+    }
+    llvm::LoadInst* W = Builder->CreateLoad(getRecordFieldType(ast), P, "bits");
+    W->setMetadata(llvm::LLVMContext::MD_tbaa, getRecordFieldTBAA(ast));
+    llvm::Value* V = Builder->CreateLShr(W, field.offset);
+    V = Builder->CreateAnd(V, llvm::APInt::getLowBitsSet(W->getType()->getIntegerBitWidth(), field.width));
+    V = Builder->CreateZExtOrTrunc(V, llvm::Type::getInt64Ty(*TheContext));
+    V = Builder->CreateAdd(V, llvm::ConstantInt::get(V->getType(), field.min, true), "bitfield");
+    return Builder->CreateSIToFP(V, llvm::Type::getDoubleTy(*TheContext), "inttmp");
+}
+
+llvm::Value* CodegenVisitor::CreateBitFieldStore(RecordExpr& ast, const BitField& field, llvm::Value* V) {
+    llvm::Value* P = getRecordFieldPtr(ast);
+    if (!P) {
+        return nullptr;
+    }
+    llvm::Type* T = getRecordFieldType(ast);
+    unsigned width = T->getIntegerBitWidth();
+    llvm::APInt Mask = llvm::APInt::getBitsSet(width, field.offset, field.offset + field.width);
+
+    llvm::Value* Bits = Builder->CreateFPToSI(V, llvm::Type::getInt64Ty(*TheContext), "toint");
+    Bits = Builder->CreateSub(Bits, llvm::ConstantInt::get(Bits->getType(), field.min, true));
+    Bits = Builder->CreateShl(Builder->CreateZExtOrTrunc(Bits, T), field.offset);
+    Bits = Builder->CreateAnd(Bits, Mask);
+
+    llvm::MDNode* TBAA = getRecordFieldTBAA(ast);
+    llvm::LoadInst* W = Builder->CreateLoad(T, P, "bits");
+    W->setMetadata(llvm::LLVMContext::MD_tbaa, TBAA);
+    llvm::Value* Kept = Builder->CreateAnd(W, ~Mask);
+    llvm::StoreInst* S = Builder->CreateStore(Builder->CreateOr(Kept, Bits, "bitfield"), P);
+    S->setMetadata(llvm::LLVMContext::MD_tbaa, TBAA);
+    return V;
+}
+
+// card(a) and fill(a, lo, hi, value) on packed boolean arrays work a word at a
+// time in runtimeBits.cpp; fill clamps the range to the array bounds.
+llvm::Value* CodegenVisitor::CreateBitsBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    auto* V = args.empty() ? nullptr : dynamic_cast<VarExpr*>(args[0].get());
+    auto infoIt = V ? ArrayVars.find(V->name) : ArrayVars.end();
+    if (infoIt == ArrayVars.end() || !infoIt->second.bits) {
+        return LogErrorV("Packed Boolean Array Expected");
+    }
+    const ArrayInfo& info = infoIt->second;
+    llvm::Type* T;
+    llvm::Value* A = getVariablePtr(V->name, T);
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    llvm::Value* N = llvm::ConstantInt::get(Int64, info.max - info.min + 1);
+
+    if (callee == "card") {
+        llvm::Value* Count = CreateRuntimeCall("__pascal_bits_count", Int64, { A, N });
+        return Builder->CreateSIToFP(Count, llvm::Type::getDoubleTy(*TheContext), "card");
+    }
+
+    if (args.size() != 4) {
+        return LogErrorV("fill Expects an Array, a Range and a Value");
+    }
+    llvm::Value* Lo = args[1]->accept(*this);
+    llvm::Value* Hi = args[2]->accept(*this);
+    llvm::Value* Value = args[3]->accept(*this);
+    if (!Lo || !Hi || !Value) {
+        return nullptr;
+    }
+    llvm::Value* Min = llvm::ConstantInt::get(Int64, info.min);
+    Lo = Builder->CreateSub(Builder->CreateFPToSI(Lo, Int64), Min, "from");
+    Hi = Builder->CreateSub(Builder->CreateFPToSI(Hi, Int64), Min, "to");
+    Value = Builder->CreateZExt(toCondition(Value), llvm::Type::getInt8Ty(*TheContext));
+    return CreateRuntimeCall("__pascal_bits_fill", llvm::Type::getVoidTy(*TheContext), { A, N, Lo, Hi, Value });
+}
+
+// Pascal widens single to real when the operand types differ. A literal that is
+// exact as a single narrows instead, so single-only expressions stay in float.
+void CodegenVisitor::unifyFloats(llvm::Value*& L, llvm::Value*& R) {
+    llvm::Type* Float = llvm::Type::getFloatTy(*TheContext);
+    llvm::Type* Double = llvm::Type::getDoubleTy(*TheContext);
+    if (L->getType() == R->getType() || !L->getType()->isFloatingPointTy() || !R->getType()->isFloatingPointTy()) {
+        return;
+    }
+
+    llvm::Value*& Narrow = L->getType() == Float ? R : L;
+    if (auto* C = llvm::dyn_cast<llvm::ConstantFP>(Narrow)) {
+        llvm::APFloat V = C->getValueAPF();
+        bool lost = false;
+        V.convert(llvm::APFloat::IEEEsingle(), llvm::APFloat::rmNearestTiesToEven, &lost);
+        if (!lost) {
+            Narrow = llvm::ConstantFP::get(*TheContext, V);
+            return;
+        }
+    }
+    L = Builder->CreateFPExt(L, Double, "widen");
+    R = Builder->CreateFPExt(R, Double, "widen");
+}
+
+// Program variables become zero-initialized internal globals, which land in .bss;
+// anything declared inside a routine is an entry block alloca. Typed constants
+// are constant globals in .rodata.
+llvm::Value* CodegenVisitor::CreateVariable(const std::string& name, llvm::Type* type, ConstInit* init) {
+    if (!type) {
+        type = llvm::Type::getDoubleTy(*TheContext);
+    }
+    if (init) {
+        llvm::Constant* C = getConstInit(*init, type);
+        if (!C) {
+            return nullptr;
+        }
+        llvm::GlobalVariable* G = new llvm::GlobalVariable(*TheModule, type, true, llvm::GlobalValue::InternalLinkage, C, name);
+        G->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        GlobalValues[name] = G;
+        return G;
+    }
+    if (GlobalScope) {
+        llvm::GlobalVariable* G = new llvm::GlobalVariable(*TheModule, type, false, llvm::GlobalValue::InternalLinkage, llvm::Constant::getNullValue(type), name);
+        GlobalValues[name] = G;
+        return G;
+    }
+    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+    NamedValues[name] = CreateEntryBlockAlloca(TheFunction, name, type);
+    // Zeroed padding lets whole records compare bytewise.
+    if (hasPadding(type)) {
+        const llvm::DataLayout& DL = TheModule->getDataLayout();
+        Builder->CreateMemSet(NamedValues[name], Builder->getInt8(0), DL.getTypeAllocSize(type).getFixedValue(), DL.getABITypeAlign(type));
+    }
+    return NamedValues[name];
+}
+
 int CodegenVisitor::getFieldIndex(const std::string& recordName, const std::string& fieldName) {
     auto varTypeIt = VariableTypeMap.find(recordName);
     if (varTypeIt == VariableTypeMap.end()) {
@@ -41,4 +367,2111 @@ int CodegenVisitor::getFieldIndex(const std::string& recordName, const std::stri
     }
 
     return fieldIt->second;
-}
\ No newline at end of file
+}
+
+// Conservative interval of an index expression; only constants, active for loop
+// variables and +/- of those are understood.
+bool CodegenVisitor::getIndexRange(Expr& ast, int& lo, int& hi) {
+    if (auto* N = dynamic_cast<NumberExpr*>(&ast)) {
+        if (!getIntConstant(N->value, lo)) {
+            return false;
+        }
+        hi = lo;
+        return true;
+    }
+
+    if (auto* V = dynamic_cast<VarExpr*>(&ast)) {
+        auto it = InductionRanges.find(V->name);
+        if (it == InductionRanges.end()) {
+            return false;
+        }
+        lo = it->second.first;
+        hi = it->second.second;
+        return true;
+    }
+
+    if (auto* B = dynamic_cast<BinaryExpr*>(&ast)) {
+        int llo, lhi, rlo, rhi;
+        if (!getIndexRange(*B->lhs, llo, lhi) || !getIndexRange(*B->rhs, rlo, rhi)) {
+            return false;
+        }
+        // Bounds that overflow an int are left to the runtime check.
+        if (B->op == "+") {
+            return !__builtin_add_overflow(llo, rlo, &lo) && !__builtin_add_overflow(lhi, rhi, &hi);
+        } else if (B->op == "-") {
+            return !__builtin_sub_overflow(llo, rhi, &lo) && !__builtin_sub_overflow(lhi, rlo, &hi);
+        }
+    }
+
+    return false;
+}
+
+// Returns the index rebased on min, bounds checked unless the range analysis proves it in range.
+// Open and dynamic arrays start at 0 and are checked against their runtime length.
+llvm::Value* CodegenVisitor::getArrayIndex(Expr& index, const ArrayInfo& info, llvm::Value* length) {
+    llvm::Value* I = index.accept(*this);
+    if (!I) {
+        return nullptr;
+    }
+
+    I = Builder->CreateFPToSI(I, llvm::Type::getInt32Ty(*TheContext), "idx");
+    if (info.min != 0) {
+        I = Builder->CreateSub(I, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), info.min), "normidx");
+    }
+
+    int lo, hi;
+    if (RangeChecks && (info.dynamic || !(getIndexRange(index, lo, hi) && lo >= info.min && hi <= info.max))) {
+        CreateBoundsCheck(I, info, length);
+    }
+    return I;
+}
+
+llvm::Value* CodegenVisitor::getArrayElementPtr(ArrayExpr& ast) {
+    llvm::Type* T;
+    llvm::Value* A = getVariablePtr(ast.arr->name, T);
+    auto infoIt = ArrayVars.find(ast.arr->name);
+    if (!A || infoIt == ArrayVars.end()) {
+        std::string m = "Uknown Array Name" + ast.arr->name;
+        return LogErrorV(m.c_str());
+    }
+    const ArrayInfo& info = infoIt->second;
+    if (info.soa) {
+        return LogErrorV("Structure of arrays elements can only be accessed by field");
+    }
+    if (info.bits) {
+        return LogErrorV("Elements of Packed Boolean Arrays Have No Address");
+    }
+    if (ast.subscripts.size() != info.dims.size()) {
+        std::string m = "Expected " + std::to_string(info.dims.size() + 1) + " Indices for Array " + ast.arr->name;
+        return LogErrorV(m.c_str());
+    }
+
+    if (info.dynamic) {
+        llvm::Value* Data = Builder->CreateLoad(llvm::PointerType::get(*TheContext, 0), Builder->CreateStructGEP(T, A, 0), ast.arr->name + ".data");
+        llvm::Value* Length = Builder->CreateLoad(llvm::Type::getInt64Ty(*TheContext), Builder->CreateStructGEP(T, A, 1), ast.arr->name + ".len");
+        llvm::Value* I = getArrayIndex(*ast.index, info, Length);
+        if (!I) {
+            return nullptr;
+        }
+        return Builder->CreateGEP(getElementType(info.elementType), Data, I, "arrayelement");
+    }
+
+    // Multidimensional arrays are nested array types, so the row-major strides
+    // are constants of the GEP and every subscript is rebased and checked alone.
+    std::vector<llvm::Value*> Indices = { llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0) };
+    Indices.push_back(getArrayIndex(*ast.index, info));
+    for (size_t d = 0; d < info.dims.size() && Indices.back(); d++) {
+        ArrayInfo dim{ nullptr, info.dims[d].first, info.dims[d].second, info.elementType };
+        Indices.push_back(getArrayIndex(*ast.subscripts[d], dim));
+    }
+    if (!Indices.back()) {
+        return nullptr;
+    }
+
+    return Builder->CreateGEP(T, A, Indices, "arrayelement");
+}
+
+// A single unsigned compare covers both bounds since the index is already rebased on min.
+void CodegenVisitor::CreateBoundsCheck(llvm::Value* index, const ArrayInfo& info, llvm::Value* length) {
+    llvm::Type* Int32 = llvm::Type::getInt32Ty(*TheContext);
+    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+
+    llvm::FunctionCallee RangeError = TheModule->getOrInsertFunction(
+        "__pascal_range_error",
+        llvm::FunctionType::get(llvm::Type::getVoidTy(*TheContext), { Int32, Int32, Int32 }, false)
+    );
+    if (auto* F = llvm::dyn_cast<llvm::Function>(RangeError.getCallee())) {
+        F->setDoesNotReturn();
+        F->addFnAttr(llvm::Attribute::Cold);
+    }
+
+    llvm::BasicBlock* FailBB = llvm::BasicBlock::Create(*TheContext, "rangefail", TheFunction);
+    llvm::BasicBlock* OkBB = llvm::BasicBlock::Create(*TheContext, "rangeok", TheFunction);
+
+    llvm::Value* Limit = length ? Builder->CreateTrunc(length, Int32, "limit") : llvm::ConstantInt::get(Int32, info.max - info.min + 1);
+    llvm::Value* InRange = Builder->CreateICmpULT(index, Limit, "inrange");
+    llvm::MDBuilder MDB(*TheContext);
+    Builder->CreateCondBr(InRange, OkBB, FailBB, MDB.createBranchWeights(1 << 20, 1));
+
+    Builder->SetInsertPoint(FailBB);
+    llvm::Value* Original = Builder->CreateAdd(index, llvm::ConstantInt::get(Int32, info.min), "origidx");
+    llvm::Value* Max = length ? Builder->CreateSub(Limit, llvm::ConstantInt::get(Int32, 1), "high") : llvm::ConstantInt::get(Int32, info.max);
+    Builder->CreateCall(RangeError, { Original, llvm::ConstantInt::get(Int32, info.min), Max });
+    Builder->CreateUnreachable();
+
+    Builder->SetInsertPoint(OkBB);
+}
+
+// Pascal has no exceptions, so every routine is nounwind; the rest comes from CallGraphVisitor::inferEffects.
+std::string CodegenVisitor::addInferredAttributes(llvm::Function* F, const RoutineEffects& effects) {
+    std::string attrs;
+
+    if (effects.memory == mem_none) {
+        F->setDoesNotAccessMemory();
+        attrs += " memory(none)";
+    } else if (effects.memory == mem_read) {
+        F->setOnlyReadsMemory();
+        attrs += " memory(read)";
+    }
+
+    F->setDoesNotThrow();
+    attrs += " nounwind";
+
+    if (!effects.mayNotReturn) {
+        F->addFnAttr(llvm::Attribute::WillReturn);
+        attrs += " willreturn";
+    }
+
+    if (!effects.recursive) {
+        F->setDoesNotRecurse();
+        attrs += " norecurse";
+    }
+
+    return attrs;
+}
+
+// a[i].f indexes the array first for an array of records, and the field
+// first when the array is laid out as one array per field.
+llvm::Value* CodegenVisitor::getRecordFieldPtr(RecordExpr& ast) {
+    llvm::Type* T;
+    llvm::Value* A = getVariablePtr(ast.record->name, T);
+    if (!A) {
+        std::string m = "Uknown Record Name" + ast.record->name;
+        return LogErrorV(m.c_str());
+    }
+
+    int fieldIndex = getFieldIndex(ast.record->name, ast.field);
+    if (fieldIndex == -1) {
+        return LogErrorV("Unknown Record Field");
+    }
+
+    llvm::Value* Zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), 0);
+    llvm::Value* Field = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), fieldIndex);
+
+    if (ast.deref) {
+        llvm::Value* Target = Builder->CreateLoad(llvm::PointerType::get(*TheContext, 0), A, ast.record->name + ".ptr");
+        return Builder->CreateGEP(RecordTypes[VariableTypeMap[ast.record->name]].llvmType, Target, { Zero, Field }, "recordfield");
+    }
+
+    if (!ast.index) {
+        return Builder->CreateGEP(T, A, { Zero, Field }, "recordfield");
+    }
+
+    auto infoIt = ArrayVars.find(ast.record->name);
+    if (infoIt == ArrayVars.end()) {
+        std::string m = "Uknown Array Name" + ast.record->name;
+        return LogErrorV(m.c_str());
+    }
+    llvm::Value* I = getArrayIndex(*ast.index, infoIt->second);
+    if (!I) {
+        return nullptr;
+    }
+
+    if (infoIt->second.soa) {
+        return Builder->CreateGEP(T, A, { Zero, Field, I }, "soafield");
+    }
+    return Builder->CreateGEP(T, A, { Zero, I, Field }, "recordfield");
+}
+
+llvm::Type* CodegenVisitor::getRecordFieldType(RecordExpr& ast) {
+    const RecordInfo& info = RecordTypes[VariableTypeMap[ast.record->name]];
+    return info.llvmType->getElementType(getFieldIndex(ast.record->name, ast.field));
+}
+
+// A field column of a structure of arrays is a plain array, so it gets a scalar tag.
+llvm::MDNode* CodegenVisitor::getRecordFieldTBAA(RecordExpr& ast) {
+    const std::string& recordType = VariableTypeMap[ast.record->name];
+    int fieldIndex = getFieldIndex(ast.record->name, ast.field);
+    if (ast.index && ArrayVars[ast.record->name].soa) {
+        llvm::MDNode* field = getTBAAType(RecordTypes[recordType].fieldTypes[fieldIndex]);
+        return llvm::MDBuilder(*TheContext).createTBAAStructTagNode(field, field, 0);
+    }
+    return getRecordTBAA(recordType, fieldIndex);
+}
+
+// Record fields keep their natural width so the layout pass has something to pack.
+llvm::Type* CodegenVisitor::getFieldType(TokenType type, const std::string& identifier) {
+    if (PointerTypes.count(identifier)) {
+        return llvm::PointerType::get(*TheContext, 0);
+    }
+    // A plain alias such as `TName = string` stores like the type it names.
+    auto baseIt = BaseTypes.find(identifier);
+    if (baseIt != BaseTypes.end() && !RangeTypes.count(identifier)) {
+        const std::string& base = baseIt->second;
+        type = base == "string" ? TokenType::tok_string : base == "single" ? TokenType::tok_single : base == "char" ? TokenType::tok_char : base == "boolean" ? TokenType::tok_boolean : TokenType::tok_real;
+    }
+    switch (type) {
+        case TokenType::tok_pointer:
+            return llvm::PointerType::get(*TheContext, 0);
+        case TokenType::tok_char:
+            return llvm::Type::getInt8Ty(*TheContext);
+        case TokenType::tok_boolean:
+            return llvm::Type::getInt1Ty(*TheContext);
+        case TokenType::tok_string:
+            return getStringType();
+        case TokenType::tok_single:
+            return llvm::Type::getFloatTy(*TheContext);
+        default:
+            return llvm::Type::getDoubleTy(*TheContext);
+    }
+}
+
+llvm::Value* CodegenVisitor::convertValue(llvm::Value* V, llvm::Type* T) {
+    llvm::Type* From = V->getType();
+    if (From == T) {
+        return V;
+    }
+    if (From->isFloatingPointTy() && T->isIntegerTy(1)) {
+        return Builder->CreateFCmpONE(V, llvm::ConstantFP::get(From, 0.0), "tobool");
+    }
+    if (From->isFloatingPointTy() && T->isIntegerTy()) {
+        return Builder->CreateFPToSI(V, T, "toint");
+    }
+    // Booleans and chars are unsigned; wider integers are signed.
+    if ((From->isIntegerTy(1) || From->isIntegerTy(8)) && T->isFloatingPointTy()) {
+        return Builder->CreateUIToFP(V, T, "tofp");
+    }
+    if (From->isIntegerTy() && T->isFloatingPointTy()) {
+        return Builder->CreateSIToFP(V, T, "tofp");
+    }
+    if (From->isIntegerTy() && T->isIntegerTy()) {
+        return Builder->CreateZExtOrTrunc(V, T, "toint");
+    }
+    if (From->isFloatingPointTy() && T->isFloatingPointTy()) {
+        return Builder->CreateFPCast(V, T, "tofp");
+    }
+    return V;
+}
+
+std::string CodegenVisitor::getTypeName(TokenType type, const std::string& identifier) {
+    switch (type) {
+        case TokenType::tok_integer:
+            return "integer";
+        case TokenType::tok_real:
+            return "real";
+        case TokenType::tok_single:
+            return "single";
+        case TokenType::tok_char:
+            return "char";
+        case TokenType::tok_boolean:
+            return "boolean";
+        case TokenType::tok_string:
+            return "string";
+        case TokenType::tok_pointer:
+            return "pointer";
+        default:
+            if (PointerTypes.count(identifier)) {
+                return "pointer";
+            }
+            return identifier.empty() ? "any" : identifier;
+    }
+}
+
+// An alias or subrange stands for the type it was declared from.
+std::string CodegenVisitor::getBaseTypeName(const std::string& name) {
+    auto it = BaseTypes.find(name);
+    return it != BaseTypes.end() ? it->second : name;
+}
+
+// Every Pascal type gets its own scalar node under one root, so accesses through
+// differently declared types are known not to alias even though all are doubles in IR.
+// Aliases and subranges share their base type's node: a var parameter of the base
+// type may be handed one of their variables.
+llvm::MDNode* CodegenVisitor::getTBAAType(const std::string& name) {
+    llvm::MDBuilder MDB(*TheContext);
+    if (!TBAARoot) {
+        TBAARoot = MDB.createTBAARoot("Pascal TBAA");
+    }
+
+    std::string typeName = getBaseTypeName(name);
+    auto it = TBAATypes.find(typeName);
+    if (it != TBAATypes.end()) {
+        return it->second;
+    }
+
+    llvm::MDNode* node = MDB.createTBAAScalarTypeNode(typeName, TBAARoot);
+    TBAATypes[typeName] = node;
+    return node;
+}
+
+llvm::MDNode* CodegenVisitor::getArrayTBAA(const ArrayInfo& info) {
+    llvm::MDNode* element = getTBAAType(info.elementType);
+    return llvm::MDBuilder(*TheContext).createTBAAStructTagNode(element, element, 0);
+}
+
+llvm::MDNode* CodegenVisitor::getRecordTBAA(const std::string& recordType, int fieldIndex) {
+    auto recIt = RecordTypes.find(recordType);
+    if (recIt == RecordTypes.end()) {
+        return nullptr;
+    }
+    const RecordInfo& info = recIt->second;
+
+    const llvm::StructLayout* layout = TheModule->getDataLayout().getStructLayout(info.llvmType);
+    std::vector<std::pair<llvm::MDNode*, uint64_t>> fields;
+    for (size_t i = 0; i < info.fieldTypes.size(); i++) {
+        fields.push_back(std::make_pair(getTBAAType(info.fieldTypes[i]), layout->getElementOffset(i)));
+    }
+
+    llvm::MDBuilder MDB(*TheContext);
+    llvm::MDNode* record = MDB.createTBAAStructTypeNode(recordType, fields);
+    return MDB.createTBAAStructTagNode(record, fields[fieldIndex].first, fields[fieldIndex].second);
+}
+
+// Only whole numbers within the int range convert; casting any other double is undefined.
+bool CodegenVisitor::getIntConstant(double value, int& result) {
+    if (!(value >= INT_MIN && value <= INT_MAX)) {
+        return false;
+    }
+    result = static_cast<int>(value);
+    return result == value;
+}
+
+bool CodegenVisitor::getOrdinalConstant(Expr& ast, int& value) {
+    if (auto* N = dynamic_cast<NumberExpr*>(&ast)) {
+        return getIntConstant(N->value, value);
+    }
+    if (auto* C = dynamic_cast<CharExpr*>(&ast)) {
+        value = static_cast<unsigned char>(C->value);
+        return true;
+    }
+    if (auto* B = dynamic_cast<BoolExpr*>(&ast)) {
+        value = B->value ? 1 : 0;
+        return true;
+    }
+    return false;
+}
+
+llvm::Value* CodegenVisitor::toOrdinal(llvm::Value* V) {
+    llvm::Type* Int32 = llvm::Type::getInt32Ty(*TheContext);
+    if (V->getType()->isFloatingPointTy()) {
+        return Builder->CreateFPToSI(V, Int32, "ord");
+    }
+    return Builder->CreateZExtOrTrunc(V, Int32, "ord");
+}
+
+// Sets are bitsets indexed by ordinal value: one or two words are kept as a
+// plain integer, anything up to 256 elements as a vector of four words.
+llvm::Type* CodegenVisitor::getSetType(int max) {
+    if (max < 64) {
+        return llvm::Type::getInt64Ty(*TheContext);
+    } else if (max < 128) {
+        return llvm::Type::getInt128Ty(*TheContext);
+    }
+    return llvm::FixedVectorType::get(llvm::Type::getInt64Ty(*TheContext), 4);
+}
+
+bool CodegenVisitor::isSetType(llvm::Type* T) {
+    return T->isIntegerTy(64) || T->isIntegerTy(128) || T->isVectorTy();
+}
+
+// The largest ordinal a set base holds, or -1 after reporting an error. A named
+// base is a subrange or enumeration, so the set only gets as many bits as it has values.
+int CodegenVisitor::getSetBaseMax(int min, int max, const std::string& identifier) {
+    if (!identifier.empty()) {
+        auto rangeIt = RangeTypes.find(identifier);
+        if (rangeIt == RangeTypes.end()) {
+            std::string m = "Unknown Set Base Type " + identifier;
+            LogErrorV(m.c_str());
+            return -1;
+        }
+        min = rangeIt->second.first;
+        max = rangeIt->second.second;
+    }
+    if (min < 0 || max > 255 || min > max) {
+        LogErrorV("Set Base Must be Within 0..255");
+        return -1;
+    }
+    return max;
+}
+
+// Set-ness comes from declarations, not from the LLVM type: other values can be
+// wide integers too.
+bool CodegenVisitor::isSetExpr(Expr& ast) {
+    if (dynamic_cast<SetExpr*>(&ast)) {
+        return true;
+    }
+    if (auto* B = dynamic_cast<BinaryExpr*>(&ast)) {
+        return (B->op == "+" || B->op == "-" || B->op == "*") && (isSetExpr(*B->lhs) || isSetExpr(*B->rhs));
+    }
+    if (auto* V = dynamic_cast<VarExpr*>(&ast)) {
+        llvm::Type* T = nullptr;
+        return SetVars.count(V->name) && getVariablePtr(V->name, T) && isSetType(T);
+    }
+    return false;
+}
+
+// A set value stored into a variable or parameter of type T. Constant sets with
+// elements past the declared base are an error rather than silently cut off.
+llvm::Value* CodegenVisitor::CreateSetValue(Expr& value, llvm::Type* T, int max) {
+    if (!isSetExpr(value)) {
+        return LogErrorV("Set Expected");
+    }
+    llvm::Value* V = value.accept(*this);
+    if (!V) {
+        return nullptr;
+    }
+    if (auto* C = llvm::dyn_cast<llvm::Constant>(V)) {
+        llvm::Type* Bits = llvm::Type::getIntNTy(*TheContext, getSetBits(V->getType()));
+        auto* I = llvm::dyn_cast<llvm::ConstantInt>(llvm::ConstantExpr::getBitCast(C, Bits));
+        if (I && I->getValue().getActiveBits() > static_cast<unsigned>(max + 1)) {
+            return LogErrorV("Set Element Out of Range");
+        }
+    }
+    return convertSet(V, T);
+}
+
+unsigned CodegenVisitor::getSetBits(llvm::Type* T) {
+    return T->isVectorTy() ? 256 : T->getIntegerBitWidth();
+}
+
+llvm::Value* CodegenVisitor::convertSet(llvm::Value* V, llvm::Type* T) {
+    if (V->getType() == T) {
+        return V;
+    }
+
+    llvm::Value* I = V;
+    if (V->getType()->isVectorTy()) {
+        I = Builder->CreateBitCast(V, llvm::Type::getIntNTy(*TheContext, 256), "setbits");
+    }
+    I = Builder->CreateZExtOrTrunc(I, llvm::Type::getIntNTy(*TheContext, getSetBits(T)), "setresize");
+    if (T->isVectorTy()) {
+        I = Builder->CreateBitCast(I, T, "setwords");
+    }
+    return I;
+}
+
+llvm::Value* CodegenVisitor::CreateSetMember(llvm::Value* element, llvm::Value* set) {
+    llvm::Value* X = toOrdinal(element);
+    unsigned bits = getSetBits(set->getType());
+    llvm::Value* InRange = Builder->CreateICmpULT(X, llvm::ConstantInt::get(X->getType(), bits), "inbase");
+
+    llvm::Value* Bit;
+    if (set->getType()->isVectorTy()) {
+        llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+        llvm::Value* Word = Builder->CreateExtractElement(set, Builder->CreateLShr(X, 6), "setword");
+        llvm::Value* Shift = Builder->CreateZExt(Builder->CreateAnd(X, 63), Int64);
+        Bit = Builder->CreateTrunc(Builder->CreateLShr(Word, Shift), llvm::Type::getInt1Ty(*TheContext), "setbit");
+    } else {
+        llvm::Value* Shift = Builder->CreateZExt(X, set->getType());
+        Bit = Builder->CreateTrunc(Builder->CreateLShr(set, Shift), llvm::Type::getInt1Ty(*TheContext), "setbit");
+    }
+
+    return Builder->CreateSelect(InRange, Bit, Builder->getFalse(), "intmp");
+}
+
+llvm::Value* CodegenVisitor::CreateSetOp(const std::string& op, llvm::Value* L, llvm::Value* R) {
+    llvm::Type* T = getSetBits(L->getType()) >= getSetBits(R->getType()) ? L->getType() : R->getType();
+    L = convertSet(L, T);
+    R = convertSet(R, T);
+
+    if (op == "+") {
+        return Builder->CreateOr(L, R, "setunion");
+    } else if (op == "*") {
+        return Builder->CreateAnd(L, R, "setintersect");
+    } else if (op == "-") {
+        return Builder->CreateAnd(L, Builder->CreateNot(R), "setdiff");
+    }
+
+    llvm::Type* Bits = llvm::Type::getIntNTy(*TheContext, getSetBits(T));
+    llvm::Value* Cmp;
+    if (op == "=" || op == "==") {
+        Cmp = Builder->CreateICmpEQ(Builder->CreateBitCast(L, Bits), Builder->CreateBitCast(R, Bits), "seteq");
+    } else if (op == "<>") {
+        Cmp = Builder->CreateICmpNE(Builder->CreateBitCast(L, Bits), Builder->CreateBitCast(R, Bits), "setne");
+    } else if (op == "<=") {
+        Cmp = Builder->CreateIsNull(Builder->CreateBitCast(Builder->CreateAnd(L, Builder->CreateNot(R)), Bits), "subset");
+    } else if (op == ">=") {
+        Cmp = Builder->CreateIsNull(Builder->CreateBitCast(Builder->CreateAnd(R, Builder->CreateNot(L)), Bits), "superset");
+    } else {
+        return LogErrorV("Invalid Set Operator");
+    }
+
+    return Builder->CreateUIToFP(Cmp, llvm::Type::getDoubleTy(*TheContext), "booltmp");
+}
+
+llvm::Value* CodegenVisitor::toCondition(llvm::Value* V) {
+    if (V->getType()->isFloatingPointTy()) {
+        return Builder->CreateFCmpONE(V, llvm::ConstantFP::get(V->getType(), 0.0), "cond");
+    }
+    if (V->getType()->isIntegerTy(1)) {
+        return V;
+    }
+    return Builder->CreateICmpNE(V, llvm::Constant::getNullValue(V->getType()), "cond");
+}
+
+// With --short-circuit, and/or/not in a condition branch straight to the
+// target blocks instead of materializing a boolean.
+llvm::Value* CodegenVisitor::CreateCondBranch(Expr& cond, llvm::BasicBlock* TrueBB, llvm::BasicBlock* FalseBB) {
+    if (ShortCircuit) {
+        if (auto* B = dynamic_cast<BinaryExpr*>(&cond)) {
+            if (B->op == "and" || B->op == "or") {
+                llvm::BasicBlock* RhsBB = llvm::BasicBlock::Create(*TheContext, B->op == "and" ? "andrhs" : "orrhs", Builder->GetInsertBlock()->getParent());
+                llvm::Value* L = B->op == "and" ? CreateCondBranch(*B->lhs, RhsBB, FalseBB) : CreateCondBranch(*B->lhs, TrueBB, RhsBB);
+                if (!L) {
+                    return nullptr;
+                }
+                Builder->SetInsertPoint(RhsBB);
+                return CreateCondBranch(*B->rhs, TrueBB, FalseBB);
+            }
+        } else if (auto* U = dynamic_cast<UnaryExpr*>(&cond)) {
+            if (U->op == "not") {
+                return CreateCondBranch(*U->rhs, FalseBB, TrueBB);
+            }
+        }
+    }
+
+    llvm::Value* V = cond.accept(*this);
+    if (!V) {
+        return nullptr;
+    }
+    return Builder->CreateCondBr(toCondition(V), TrueBB, FalseBB);
+}
+
+// By-reference parameters live in an alloca holding their address; ReferenceTypes
+// records what they point to so callers get the variable's own address back.
+llvm::Value* CodegenVisitor::getVariablePtr(const std::string& name, llvm::Type*& type) {
+    llvm::AllocaInst* A = NamedValues[name];
+    if (!A) {
+        auto globalIt = GlobalValues.find(name);
+        if (globalIt == GlobalValues.end()) {
+            return nullptr;
+        }
+        type = globalIt->second->getValueType();
+        return globalIt->second;
+    }
+
+    auto refIt = ReferenceTypes.find(name);
+    if (refIt == ReferenceTypes.end()) {
+        type = A->getAllocatedType();
+        return A;
+    }
+
+    type = refIt->second;
+    return Builder->CreateLoad(A->getAllocatedType(), A, name + ".ref");
+}
+
+// The variable an lvalue writes into; empty when it writes through a pointer.
+std::string CodegenVisitor::getTargetName(Expr& ast) {
+    if (auto* V = dynamic_cast<VarExpr*>(&ast)) {
+        return V->name;
+    } else if (auto* A = dynamic_cast<ArrayExpr*>(&ast)) {
+        return A->arr->name;
+    } else if (auto* R = dynamic_cast<RecordExpr*>(&ast); R && !R->deref) {
+        return R->record->name;
+    }
+    return "";
+}
+
+// Typed constants live in read-only globals, so every write through an lvalue
+// checks that it does not name one.
+bool CodegenVisitor::isConstantTarget(Expr& ast) {
+    std::string target = getTargetName(ast);
+    if (getConstantGlobal(target)) {
+        std::string m = "Cannot Assign to Constant " + target;
+        LogErrorV(m.c_str());
+        return true;
+    }
+    return false;
+}
+
+// Const parameters and by-value aggregates are only read through the pointer.
+llvm::Value* CodegenVisitor::getLValuePtr(Expr& ast, bool write) {
+    if (write && isConstantTarget(ast)) {
+        return nullptr;
+    }
+    if (auto* V = dynamic_cast<VarExpr*>(&ast)) {
+        llvm::Type* T;
+        llvm::Value* P = getVariablePtr(V->name, T);
+        if (!P) {
+            std::string msg = "Unknown variable name: " + V->name;
+            return LogErrorV(msg.c_str());
+        }
+        return P;
+    } else if (auto* A = dynamic_cast<ArrayExpr*>(&ast)) {
+        return getArrayElementPtr(*A);
+    } else if (auto* R = dynamic_cast<RecordExpr*>(&ast)) {
+        if (getBitField(*R)) {
+            return LogErrorV("Packed Record Fields Have No Address");
+        }
+        return getRecordFieldPtr(*R);
+    }
+
+    return LogErrorV("Variable Expected for Reference Parameter");
+}
+
+// A record or fixed array named as a whole; anything else returns nullptr without an error.
+llvm::Value* CodegenVisitor::getAggregatePtr(Expr& ast, llvm::Type*& type) {
+    auto* V = dynamic_cast<VarExpr*>(&ast);
+    if (!V) {
+        return nullptr;
+    }
+
+    llvm::Type* Expected = nullptr;
+    auto typeIt = VariableTypeMap.find(V->name);
+    auto arrIt = ArrayVars.find(V->name);
+    if (typeIt != VariableTypeMap.end() && RecordTypes.count(typeIt->second)) {
+        Expected = RecordTypes[typeIt->second].llvmType;
+    } else if (arrIt != ArrayVars.end() && !arrIt->second.dynamic) {
+        Expected = arrIt->second.llvmType;
+    }
+    if (!Expected) {
+        return nullptr;
+    }
+
+    llvm::Value* P = getVariablePtr(V->name, type);
+    return P && type == Expected ? P : nullptr;
+}
+
+// Packed records have no padding bytes, but the words holding their subrange
+// fields usually have bits no field uses, which count as padding too.
+bool CodegenVisitor::hasPadding(llvm::Type* T) {
+    const llvm::DataLayout& DL = TheModule->getDataLayout();
+    if (auto* A = llvm::dyn_cast<llvm::ArrayType>(T)) {
+        return hasPadding(A->getElementType());
+    }
+    auto* S = llvm::dyn_cast<llvm::StructType>(T);
+    if (!S) {
+        return false;
+    }
+    for (auto& r : RecordTypes) {
+        if (r.second.llvmType == S && !r.second.bitFields.empty()) {
+            return true;
+        }
+    }
+    uint64_t size = 0;
+    for (llvm::Type* E : S->elements()) {
+        if (hasPadding(E)) {
+            return true;
+        }
+        size += DL.getTypeAllocSize(E).getFixedValue();
+    }
+    return size != DL.getTypeAllocSize(S).getFixedValue();
+}
+
+// Whole records and arrays copy with one memcpy of constant size, which LLVM
+// expands inline when small. Strings inside take a reference first, so that
+// a := a does not free what it is about to copy.
+llvm::Value* CodegenVisitor::CreateAggregateAssign(llvm::Value* P, llvm::Type* T, Expr& value) {
+    llvm::Type* ST;
+    llvm::Value* S = getAggregatePtr(value, ST);
+    if (!S || ST != T) {
+        return LogErrorV("Incompatible Types in Assignment");
+    }
+
+    llvm::Type* Void = llvm::Type::getVoidTy(*TheContext);
+    std::vector<llvm::Value*> strings;
+    getStringFields(S, T, strings);
+    for (llvm::Value* F : strings) {
+        CreateStringCall("retain", Void, { F });
+    }
+    strings.clear();
+    getStringFields(P, T, strings);
+    for (llvm::Value* F : strings) {
+        CreateStringCall("release", Void, { F });
+    }
+
+    const llvm::DataLayout& DL = TheModule->getDataLayout();
+    return Builder->CreateMemCpy(P, DL.getABITypeAlign(T), S, DL.getABITypeAlign(T), DL.getTypeAllocSize(T).getFixedValue());
+}
+
+// Padding is always zero (see CreateVariable), so equality is bytewise. Up to
+// 32 bytes both sides load as one wide integer, which the backend compares
+// with vector instructions; larger aggregates call memcmp.
+llvm::Value* CodegenVisitor::CreateAggregateCompare(const std::string& op, Expr& lhs, Expr& rhs) {
+    llvm::Type* LT;
+    llvm::Type* RT;
+    llvm::Value* L = getAggregatePtr(lhs, LT);
+    llvm::Value* R = getAggregatePtr(rhs, RT);
+    if (!L || !R || LT != RT) {
+        return LogErrorV("Incompatible Types in Comparison");
+    }
+    if (op != "==" && op != "<>") {
+        return LogErrorV("Records and Arrays Can Only be Compared for Equality");
+    }
+    std::vector<llvm::Value*> strings;
+    getStringFields(L, LT, strings);
+    if (!strings.empty()) {
+        return LogErrorV("Records with String Fields Cannot be Compared");
+    }
+
+    const llvm::DataLayout& DL = TheModule->getDataLayout();
+    uint64_t size = DL.getTypeAllocSize(LT).getFixedValue();
+    llvm::Align align = DL.getABITypeAlign(LT);
+    llvm::Value* Eq;
+    if (size <= 32 && llvm::isPowerOf2_64(size)) {
+        llvm::Type* Wide = llvm::IntegerType::get(*TheContext, size * 8);
+        llvm::Value* LV = Builder->CreateAlignedLoad(Wide, L, align, "lhsbytes");
+        llvm::Value* RV = Builder->CreateAlignedLoad(Wide, R, align, "rhsbytes");
+        Eq = Builder->CreateICmpEQ(LV, RV, "cmptmp");
+    } else {
+        llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+        llvm::Value* C = CreateRuntimeCall("memcmp", llvm::Type::getInt32Ty(*TheContext), { L, R, llvm::ConstantInt::get(Int64, size) });
+        Eq = Builder->CreateICmpEQ(C, llvm::ConstantInt::get(C->getType(), 0), "cmptmp");
+    }
+    if (op == "<>") {
+        Eq = Builder->CreateNot(Eq, "nottmp");
+    }
+    return Builder->CreateUIToFP(Eq, llvm::Type::getDoubleTy(*TheContext), "booltmp");
+}
+
+llvm::Type* CodegenVisitor::getParamType(ParamDecl& param) {
+    auto recIt = RecordTypes.find(param.identifier);
+    if (recIt != RecordTypes.end()) {
+        return recIt->second.llvmType;
+    }
+
+    auto arrIt = ArrayTypes.find(param.identifier);
+    if (arrIt != ArrayTypes.end()) {
+        return arrIt->second.llvmType;
+    }
+
+    auto setIt = SetTypes.find(param.identifier);
+    if (setIt != SetTypes.end()) {
+        return getSetType(setIt->second);
+    }
+
+    if (param.type == TokenType::tok_string || getBaseTypeName(param.identifier) == "string") {
+        return getStringType();
+    }
+
+    if (param.type == TokenType::tok_text) {
+        return getTextType();
+    }
+
+    if (param.type == TokenType::tok_channel) {
+        return getChannelType();
+    }
+
+    if (PointerTypes.count(param.identifier)) {
+        return llvm::PointerType::get(*TheContext, 0);
+    }
+
+    if (param.type == TokenType::tok_array) {
+        return getOpenArrayType();
+    }
+
+    if (param.type == TokenType::tok_single) {
+        return llvm::Type::getFloatTy(*TheContext);
+    }
+
+    return llvm::Type::getDoubleTy(*TheContext);
+}
+
+bool CodegenVisitor::isWritten(const std::string& routine, const std::string& name) {
+    auto it = RoutineWrites.find(routine);
+    return it == RoutineWrites.end() || it->second.count(name);
+}
+
+// Whether a value of type Inner may be stored inside one of type Outer. Open and
+// dynamic arrays have no fixed length, so arrays match on their elements.
+bool CodegenVisitor::mayContainType(llvm::Type* Outer, llvm::Type* Inner) {
+    llvm::Type* Double = llvm::Type::getDoubleTy(*TheContext);
+    if (Outer == getOpenArrayType() || Outer == getDynArrayType()) {
+        Outer = llvm::ArrayType::get(Double, 0);
+    }
+    if (Inner == getOpenArrayType() || Inner == getDynArrayType()) {
+        Inner = llvm::ArrayType::get(Double, 0);
+    }
+    if (Outer == Inner) {
+        return true;
+    }
+    if (auto* A = llvm::dyn_cast<llvm::ArrayType>(Outer)) {
+        auto* B = llvm::dyn_cast<llvm::ArrayType>(Inner);
+        return (B && A->getElementType() == B->getElementType()) || mayContainType(A->getElementType(), Inner);
+    }
+    if (auto* S = llvm::dyn_cast<llvm::StructType>(Outer)) {
+        for (llvm::Type* E : S->elements()) {
+            if (mayContainType(E, Inner)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// A value parameter passed as a pointer to the caller's storage is copied on entry,
+// before the routine can run any store, unless nothing may change that storage while
+// the routine runs: the routine does not write the parameter, neither it nor its
+// callees write program variables or the heap, and it has no var parameter that may
+// share the storage. Iterators always copy, since they outlive the call.
+bool CodegenVisitor::copiesValueParam(Prototype& proto, size_t index) {
+    ParamDecl& P = *proto.args[index];
+    if (P.mode != ParamMode::param_value) {
+        return false;
+    }
+    auto it = RoutineWritesGlobals.find(proto.name);
+    if (proto.iterator || isWritten(proto.name, P.name) || it == RoutineWritesGlobals.end() || it->second) {
+        return true;
+    }
+    std::vector<llvm::Type*>& types = ParamTypes[proto.name];
+    for (size_t i = 0; i < proto.args.size(); i++) {
+        if (VarParams[proto.name][i] && (mayContainType(types[index], types[i]) || mayContainType(types[i], types[index]))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// var and const parameters, and aggregates passed by value, arrive as pointers;
+// copiesValueParam decides which by-value ones get a private copy.
+void CodegenVisitor::bindArguments(llvm::Function* TheFunction, Prototype& proto) {
+    NamedValues.clear();
+    ReferenceTypes.clear();
+    StringLocals.clear();
+    DynArrayLocals.clear();
+    MapLocals.clear();
+    FileLocals.clear();
+    ChannelLocals.clear();
+
+    unsigned idx = 0;
+    for (auto &A : TheFunction->args()) {
+        ParamDecl& P = *proto.args[idx++];
+        llvm::Type* T = getParamType(P);
+
+        if (RecordTypes.count(P.identifier)) {
+            VariableTypeMap[P.name] = P.identifier;
+        } else if (ArrayTypes.count(P.identifier)) {
+            ArrayVars[P.name] = ArrayTypes[P.identifier];
+        } else if (PointerTypes.count(P.identifier)) {
+            VariableTypeMap[P.name] = PointerTypes[P.identifier];
+        } else if (SetTypes.count(P.identifier)) {
+            SetVars[P.name] = SetTypes[P.identifier];
+        } else if (P.type == TokenType::tok_array) {
+            ArrayVars[P.name] = ArrayInfo{ T, 0, -1, getTypeName(P.type, P.identifier), false, true };
+        }
+
+        if (!ByReference[proto.name][idx - 1]) {
+            llvm::AllocaInst* Alloca = CreateEntryBlockAlloca(TheFunction, P.name, T);
+            Builder->CreateStore(&A, Alloca);
+            NamedValues[P.name] = Alloca;
+            if (T == getOpenArrayType() && copiesValueParam(proto, idx - 1)) {
+                CreateOpenArrayCopy(TheFunction, Alloca);
+            }
+            continue;
+        }
+
+        if (copiesValueParam(proto, idx - 1)) {
+            const llvm::DataLayout& DL = TheModule->getDataLayout();
+            llvm::AllocaInst* Alloca = CreateEntryBlockAlloca(TheFunction, P.name, T);
+            Builder->CreateMemCpy(Alloca, DL.getPrefTypeAlign(T), &A, DL.getPrefTypeAlign(T), DL.getTypeAllocSize(T).getFixedValue());
+            initStrings(Alloca, T, true);
+            NamedValues[P.name] = Alloca;
+            continue;
+        }
+
+        llvm::AllocaInst* Alloca = CreateEntryBlockAlloca(TheFunction, P.name, A.getType());
+        Builder->CreateStore(&A, Alloca);
+        NamedValues[P.name] = Alloca;
+        ReferenceTypes[P.name] = T;
+    }
+}
+
+llvm::Value* CodegenVisitor::CreatePascalCall(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    llvm::Function* Callee = TheModule->getFunction(callee);
+    if (!Callee) {
+        return LogErrorV("Unknown Function Referenced");
+    }
+
+    if (Callee->arg_size() != args.size()) {
+        return LogErrorV("Incorrect Number of Arguments");
+    }
+
+    std::vector<llvm::Value*> Args;
+    for (unsigned i = 0; i != args.size(); i++) {
+        Expr* arg = args[i].get();
+        bool lvalue = dynamic_cast<VarExpr*>(arg) || dynamic_cast<ArrayExpr*>(arg) || dynamic_cast<RecordExpr*>(arg);
+        bool byReference = ByReference[callee][i];
+        if (Callee->getArg(i)->getType() == getOpenArrayType()) {
+            Args.push_back(CreateOpenArray(*arg));
+        } else if (byReference && !lvalue) {
+            if (VarParams[callee][i]) {
+                return LogErrorV("Variable Expected for Reference Parameter");
+            }
+            // String expressions evaluate to a pointer to a literal or temporary;
+            // any other value is passed in a temporary of the parameter's type.
+            llvm::Value* V = arg->accept(*this);
+            if (V) {
+                V = toStringValue(V);
+            }
+            if (V && !V->getType()->isPointerTy()) {
+                llvm::Type* ParamT = ParamTypes[callee][i];
+                if (ParamT->isFloatingPointTy()) {
+                    V = convertValue(V, ParamT);
+                } else if (isSetType(ParamT) && isSetExpr(*arg)) {
+                    V = convertSet(V, ParamT);
+                }
+                if (V->getType() != ParamT) {
+                    return LogErrorV("Incompatible Type for Const Parameter");
+                }
+                llvm::AllocaInst* Temp = CreateEntryBlockAlloca(Builder->GetInsertBlock()->getParent(), "argtmp", ParamT);
+                Builder->CreateStore(V, Temp);
+                V = Temp;
+            }
+            Args.push_back(V);
+        } else if (byReference) {
+            Args.push_back(getLValuePtr(*args[i], VarParams[callee][i]));
+        } else {
+            llvm::Type* ParamT = Callee->getFunctionType()->getParamType(i);
+            if (isSetType(ParamT)) {
+                Args.push_back(CreateSetValue(*args[i], ParamT, getSetBits(ParamT) - 1));
+            } else {
+                llvm::Value* V = args[i]->accept(*this);
+                Args.push_back(V && ParamT->isFloatingPointTy() ? convertValue(V, ParamT) : V);
+            }
+        }
+        if (!Args.back()) {
+            return nullptr;
+        }
+    }
+
+    llvm::Value* Call = Builder->CreateCall(Callee, Args, Callee->getReturnType()->isVoidTy() ? "" : "calltmp");
+    for (llvm::Value* A : Args) {
+        releaseStringTemp(A);
+    }
+    // A returned string is owned by the caller, so it lives on as a temporary.
+    if (Callee->getReturnType() == getStringType()) {
+        llvm::Value* Temp = CreateStringTemp();
+        Builder->CreateStore(Call, Temp);
+        return Temp;
+    }
+    return Call;
+}
+
+llvm::StructType* CodegenVisitor::getStringType() {
+    if (llvm::StructType* T = llvm::StructType::getTypeByName(*TheContext, "string")) {
+        return T;
+    }
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    return llvm::StructType::create(*TheContext, { Int64, Int64 }, "string");
+}
+
+// The literal's 16 bytes as a { i64, i64 } initializer, so a named constant can
+// have the string type. Long literals keep pointing at their immortal buffer.
+llvm::Constant* CodegenVisitor::getStringConstant(StringExpr& ast) {
+    auto* Literal = llvm::cast<llvm::ConstantStruct>(llvm::cast<llvm::GlobalVariable>(visit(ast))->getInitializer());
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    bool little = TheModule->getDataLayout().isLittleEndian();
+    auto pack = [little](const unsigned char* bytes) {
+        uint64_t word = 0;
+        for (int i = 0; i < 8; i++) {
+            word |= static_cast<uint64_t>(bytes[i]) << (little ? 8 * i : 8 * (7 - i));
+        }
+        return word;
+    };
+
+    unsigned char bytes[16] = {};
+    llvm::Constant* Lo;
+    if (ast.value.size() <= 15) {
+        ast.value.copy(reinterpret_cast<char*>(bytes), 15);
+        bytes[15] = ast.value.size();
+        Lo = llvm::ConstantInt::get(Int64, pack(bytes));
+    } else {
+        uint32_t len = ast.value.size();
+        for (int i = 0; i < 4; i++) {
+            bytes[8 + (little ? i : 3 - i)] = len >> (8 * i);
+        }
+        bytes[15] = 0xFF;
+        Lo = llvm::ConstantExpr::getPtrToInt(Literal->getOperand(0), Int64);
+    }
+    return llvm::ConstantStruct::get(getStringType(), { Lo, llvm::ConstantInt::get(Int64, pack(bytes + 8)) });
+}
+
+llvm::Value* CodegenVisitor::CreateRuntimeCall(const std::string& name, llvm::Type* ret, std::vector<llvm::Value*> args) {
+    std::vector<llvm::Type*> params;
+    for (llvm::Value* A : args) {
+        params.push_back(A->getType());
+    }
+    llvm::FunctionCallee Callee = TheModule->getOrInsertFunction(name, llvm::FunctionType::get(ret, params, false));
+    if (auto* F = llvm::dyn_cast<llvm::Function>(Callee.getCallee())) {
+        F->setDoesNotThrow();
+    }
+    return Builder->CreateCall(Callee, args, ret->isVoidTy() ? "" : "rt");
+}
+
+// String operations are calls into runtimeString.cpp, which take every string by pointer.
+llvm::Value* CodegenVisitor::CreateStringCall(const std::string& name, llvm::Type* ret, std::vector<llvm::Value*> args) {
+    static const std::set<std::string> ReadOnly = { "length", "equal", "compare", "pos" };
+
+    llvm::Value* Call = CreateRuntimeCall("__pascal_str_" + name, ret, args);
+    if (ReadOnly.count(name)) {
+        llvm::cast<llvm::CallInst>(Call)->getCalledFunction()->setOnlyReadsMemory();
+    }
+    if (!ret->isVoidTy()) {
+        Call->setName(name);
+    }
+    return Call;
+}
+
+llvm::Value* CodegenVisitor::CreateStringTemp() {
+    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+    llvm::AllocaInst* Temp = CreateEntryBlockAlloca(TheFunction, "strtmp", getStringType());
+    Builder->CreateStore(llvm::Constant::getNullValue(getStringType()), Temp);
+    StringTemps.insert(Temp);
+    return Temp;
+}
+
+// A char used where a string is expected becomes a one character string.
+llvm::Value* CodegenVisitor::toStringValue(llvm::Value* V) {
+    if (!V->getType()->isIntegerTy(8)) {
+        return V;
+    }
+    llvm::Value* Temp = CreateStringTemp();
+    CreateStringCall("from_char", llvm::Type::getVoidTy(*TheContext), { Temp, V });
+    return Temp;
+}
+
+void CodegenVisitor::releaseStringTemp(llvm::Value* V) {
+    if (StringTemps.erase(V)) {
+        CreateStringCall("release", llvm::Type::getVoidTy(*TheContext), { V });
+    }
+}
+
+llvm::Value* CodegenVisitor::CreateStringOp(const std::string& op, llvm::Value* L, llvm::Value* R) {
+    L = toStringValue(L);
+    R = toStringValue(R);
+    llvm::Type* Int32 = llvm::Type::getInt32Ty(*TheContext);
+    llvm::Value* Zero = llvm::ConstantInt::get(Int32, 0);
+
+    llvm::Value* Result;
+    if (op == "+") {
+        Result = CreateStringTemp();
+        CreateStringCall("concat", llvm::Type::getVoidTy(*TheContext), { Result, L, R });
+    } else if (op == "==" || op == "<>") {
+        Result = CreateStringCall("equal", llvm::Type::getInt1Ty(*TheContext), { L, R });
+        if (op == "<>") {
+            Result = Builder->CreateNot(Result, "netmp");
+        }
+    } else if (op == "<") {
+        Result = Builder->CreateICmpSLT(CreateStringCall("compare", Int32, { L, R }), Zero, "cmptmp");
+    } else if (op == "<=") {
+        Result = Builder->CreateICmpSLE(CreateStringCall("compare", Int32, { L, R }), Zero, "cmptmp");
+    } else if (op == ">") {
+        Result = Builder->CreateICmpSGT(CreateStringCall("compare", Int32, { L, R }), Zero, "cmptmp");
+    } else if (op == ">=") {
+        Result = Builder->CreateICmpSGE(CreateStringCall("compare", Int32, { L, R }), Zero, "cmptmp");
+    } else {
+        return LogErrorV("Invalid String Operator");
+    }
+
+    releaseStringTemp(L);
+    releaseStringTemp(R);
+    if (op == "+") {
+        return Result;
+    }
+    return Builder->CreateUIToFP(Result, llvm::Type::getDoubleTy(*TheContext), "booltmp");
+}
+
+bool CodegenVisitor::isStringExpr(Expr& ast) {
+    if (dynamic_cast<StringExpr*>(&ast)) {
+        return true;
+    }
+    if (auto* B = dynamic_cast<BinaryExpr*>(&ast)) {
+        return B->op == "+" && (isStringExpr(*B->lhs) || isStringExpr(*B->rhs));
+    }
+    if (auto* C = dynamic_cast<CallExpr*>(&ast)) {
+        llvm::Function* F = TheModule->getFunction(C->callee);
+        return F && F->getReturnType() == getStringType();
+    }
+    return isStringTarget(ast);
+}
+
+bool CodegenVisitor::isStringTarget(Expr& ast) {
+    if (auto* V = dynamic_cast<VarExpr*>(&ast)) {
+        auto refIt = ReferenceTypes.find(V->name);
+        if (refIt != ReferenceTypes.end()) {
+            return refIt->second == getStringType();
+        }
+        llvm::Type* T = nullptr;
+        return getVariablePtr(V->name, T) && T == getStringType();
+    }
+    if (auto* R = dynamic_cast<RecordExpr*>(&ast)) {
+        return getFieldIndex(R->record->name, R->field) != -1 && getRecordFieldType(*R) == getStringType();
+    }
+    return false;
+}
+
+// s := s + t appends in place; a temporary is moved into the target and
+// anything else shares its buffer with it.
+llvm::Value* CodegenVisitor::CreateStringAssign(Expr& target, llvm::Value* P, Expr& value) {
+    llvm::Type* Void = llvm::Type::getVoidTy(*TheContext);
+    auto* B = dynamic_cast<BinaryExpr*>(&value);
+    auto* T = dynamic_cast<VarExpr*>(&target);
+    auto* L = B ? dynamic_cast<VarExpr*>(B->lhs.get()) : nullptr;
+    if (B && B->op == "+" && T && L && T->name == L->name) {
+        llvm::Value* R = B->rhs->accept(*this);
+        if (!R) {
+            return nullptr;
+        }
+        R = toStringValue(R);
+        CreateStringCall("append", Void, { P, R });
+        releaseStringTemp(R);
+        return P;
+    }
+
+    llvm::Value* V = value.accept(*this);
+    if (!V) {
+        return nullptr;
+    }
+    V = toStringValue(V);
+    if (!V->getType()->isPointerTy()) {
+        return LogErrorV("String Expected");
+    }
+    if (StringTemps.erase(V)) {
+        CreateStringCall("move", Void, { P, V });
+    } else {
+        CreateStringCall("assign", Void, { P, V });
+    }
+    return P;
+}
+
+void CodegenVisitor::getStringFields(llvm::Value* P, llvm::Type* T, std::vector<llvm::Value*>& fields) {
+    if (T == getStringType()) {
+        fields.push_back(P);
+        return;
+    }
+
+    auto* S = llvm::dyn_cast<llvm::StructType>(T);
+    if (!S) {
+        return;
+    }
+    for (unsigned i = 0; i < S->getNumElements(); i++) {
+        if (llvm::isa<llvm::StructType>(S->getElementType(i))) {
+            getStringFields(Builder->CreateStructGEP(S, P, i, "strfield"), S->getElementType(i), fields);
+        }
+    }
+}
+
+// Strings in a new variable start empty; ones copied from an argument take a reference.
+// Either way they are released when the routine returns.
+void CodegenVisitor::initStrings(llvm::Value* P, llvm::Type* T, bool retain) {
+    std::vector<llvm::Value*> fields;
+    getStringFields(P, T, fields);
+    for (llvm::Value* F : fields) {
+        if (retain) {
+            CreateStringCall("retain", llvm::Type::getVoidTy(*TheContext), { F });
+        } else {
+            Builder->CreateStore(llvm::Constant::getNullValue(getStringType()), F);
+        }
+        StringLocals.push_back(F);
+    }
+}
+
+void CodegenVisitor::releaseLocals() {
+    for (llvm::Value* P : StringLocals) {
+        CreateStringCall("release", llvm::Type::getVoidTy(*TheContext), { P });
+    }
+    for (llvm::Value* P : DynArrayLocals) {
+        CreateRuntimeCall("__pascal_dynarray_free", llvm::Type::getVoidTy(*TheContext), { P });
+    }
+    for (auto& [P, kind] : MapLocals) {
+        CreateRuntimeCall("__pascal_map_" + kind + "_free", llvm::Type::getVoidTy(*TheContext), { P });
+    }
+    for (llvm::Value* P : FileLocals) {
+        CreateRuntimeCall("__pascal_file_free", llvm::Type::getVoidTy(*TheContext), { P });
+    }
+    for (llvm::Value* P : ChannelLocals) {
+        CreateRuntimeCall("__pascal_chan_free", llvm::Type::getVoidTy(*TheContext), { P });
+    }
+}
+
+// Returns the record type a pointer variable points to, or null if it is not a pointer.
+const std::string* CodegenVisitor::getPointee(const std::string& name) {
+    llvm::Type* T;
+    if (!getVariablePtr(name, T) || !T->isPointerTy()) {
+        return nullptr;
+    }
+    auto it = VariableTypeMap.find(name);
+    if (it == VariableTypeMap.end() || !RecordTypes.count(it->second)) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+// new and dispose pass the pointee size to runtimeHeap.cpp, which keeps a free
+// list per size class; mark and release bracket an arena freed all at once.
+llvm::Value* CodegenVisitor::CreateHeapBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    llvm::Type* Ptr = llvm::PointerType::get(*TheContext, 0);
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    llvm::Type* Void = llvm::Type::getVoidTy(*TheContext);
+
+    auto* V = args.size() == 1 ? dynamic_cast<VarExpr*>(args[0].get()) : nullptr;
+    if (!V) {
+        std::string m = callee + " Expects a Pointer Variable";
+        return LogErrorV(m.c_str());
+    }
+    llvm::Value* P = getLValuePtr(*V);
+    if (!P) {
+        return nullptr;
+    }
+
+    if (callee == "mark") {
+        Builder->CreateStore(CreateRuntimeCall("__pascal_mark", Ptr, {}), P);
+        return P;
+    } else if (callee == "release") {
+        CreateRuntimeCall("__pascal_release", Void, { Builder->CreateLoad(Ptr, P, V->name) });
+        return P;
+    }
+
+    const std::string* pointee = getPointee(V->name);
+    if (!pointee) {
+        std::string m = callee + " Expects a Pointer to a Record";
+        return LogErrorV(m.c_str());
+    }
+    llvm::StructType* T = RecordTypes[*pointee].llvmType;
+    llvm::Value* Size = llvm::ConstantInt::get(Int64, TheModule->getDataLayout().getTypeAllocSize(T).getFixedValue());
+
+    std::vector<llvm::Value*> strings;
+    if (callee == "new") {
+        llvm::Value* Block = CreateRuntimeCall("__pascal_new", Ptr, { Size });
+        llvm::cast<llvm::CallInst>(Block)->getCalledFunction()->addRetAttr(llvm::Attribute::NoAlias);
+        getStringFields(Block, T, strings);
+        for (llvm::Value* S : strings) {
+            Builder->CreateStore(llvm::Constant::getNullValue(getStringType()), S);
+        }
+        Builder->CreateStore(Block, P);
+        return P;
+    }
+
+    llvm::Value* Block = Builder->CreateLoad(Ptr, P, V->name);
+    getStringFields(Block, T, strings);
+    for (llvm::Value* S : strings) {
+        CreateStringCall("release", Void, { S });
+    }
+    CreateRuntimeCall("__pascal_dispose", Void, { Block, Size });
+    return P;
+}
+
+// An open array parameter is a { data, length } pair passed by value.
+llvm::StructType* CodegenVisitor::getOpenArrayType() {
+    if (llvm::StructType* T = llvm::StructType::getTypeByName(*TheContext, "openarray")) {
+        return T;
+    }
+    return llvm::StructType::create(*TheContext, { llvm::PointerType::get(*TheContext, 0), llvm::Type::getInt64Ty(*TheContext) }, "openarray");
+}
+
+// A dynamic array variable is { data, length, capacity }; setlength grows capacity by doubling.
+llvm::StructType* CodegenVisitor::getDynArrayType() {
+    if (llvm::StructType* T = llvm::StructType::getTypeByName(*TheContext, "dynarray")) {
+        return T;
+    }
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    return llvm::StructType::create(*TheContext, { llvm::PointerType::get(*TheContext, 0), Int64, Int64 }, "dynarray");
+}
+
+// Fixed arrays pass their storage and element count; dynamic and open arrays
+// pass their current data pointer and length. The callee copies the elements
+// only when it may write to a value parameter.
+llvm::Value* CodegenVisitor::CreateOpenArray(Expr& arg) {
+    llvm::Value* Data;
+    llvm::Value* Length;
+    const ArrayInfo* info = getArraySpan(arg, Data, Length);
+    if (!info || !info->dims.empty() || getBaseTypeName(info->elementType) != "real") {
+        return LogErrorV("Array of real Expected for Open Array Parameter");
+    }
+
+    llvm::Value* Open = llvm::UndefValue::get(getOpenArrayType());
+    Open = Builder->CreateInsertValue(Open, Data, 0);
+    return Builder->CreateInsertValue(Open, Length, 1, "openarray");
+}
+
+// A value open array the routine may write gets its own copy of the elements,
+// kept in a dynamic array that is freed when the routine returns.
+void CodegenVisitor::CreateOpenArrayCopy(llvm::Function* TheFunction, llvm::AllocaInst* Open) {
+    llvm::Type* Ptr = llvm::PointerType::get(*TheContext, 0);
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    llvm::Type* Elem = llvm::Type::getDoubleTy(*TheContext);
+    const llvm::DataLayout& DL = TheModule->getDataLayout();
+    uint64_t size = DL.getTypeAllocSize(Elem).getFixedValue();
+
+    llvm::Value* Data = Builder->CreateLoad(Ptr, Builder->CreateStructGEP(getOpenArrayType(), Open, 0), "data");
+    llvm::Value* Length = Builder->CreateLoad(Int64, Builder->CreateStructGEP(getOpenArrayType(), Open, 1), "len");
+    llvm::AllocaInst* Copy = CreateEntryBlockAlloca(TheFunction, (Open->getName() + ".copy").str(), getDynArrayType());
+    Builder->CreateStore(llvm::Constant::getNullValue(getDynArrayType()), Copy);
+    CreateRuntimeCall("__pascal_setlength", llvm::Type::getVoidTy(*TheContext), { Copy, Length, llvm::ConstantInt::get(Int64, size) });
+    llvm::Value* CopyData = Builder->CreateLoad(Ptr, Builder->CreateStructGEP(getDynArrayType(), Copy, 0), "copydata");
+    llvm::Align align = DL.getPrefTypeAlign(Elem);
+    Builder->CreateMemCpy(CopyData, align, Data, align, Builder->CreateMul(Length, llvm::ConstantInt::get(Int64, size), "bytes"));
+    Builder->CreateStore(CopyData, Builder->CreateStructGEP(getOpenArrayType(), Open, 0));
+    DynArrayLocals.push_back(Copy);
+}
+
+// The storage and element count of an array variable: fixed arrays count every
+// element of every dimension, dynamic and open arrays load their data and length.
+const ArrayInfo* CodegenVisitor::getArraySpan(Expr& arg, llvm::Value*& data, llvm::Value*& length) {
+    auto* V = dynamic_cast<VarExpr*>(&arg);
+    auto infoIt = V ? ArrayVars.find(V->name) : ArrayVars.end();
+    if (infoIt == ArrayVars.end() || infoIt->second.soa || infoIt->second.bits) {
+        return nullptr;
+    }
+    const ArrayInfo& info = infoIt->second;
+
+    llvm::Type* T;
+    llvm::Value* A = getVariablePtr(V->name, T);
+    if (!A) {
+        return nullptr;
+    }
+    if (info.dynamic) {
+        data = Builder->CreateLoad(llvm::PointerType::get(*TheContext, 0), Builder->CreateStructGEP(T, A, 0), V->name + ".data");
+        length = Builder->CreateLoad(llvm::Type::getInt64Ty(*TheContext), Builder->CreateStructGEP(T, A, 1), V->name + ".len");
+    } else {
+        int64_t count = info.max - info.min + 1;
+        for (auto& d : info.dims) {
+            count *= d.second - d.first + 1;
+        }
+        data = A;
+        length = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*TheContext), count);
+    }
+    return &info;
+}
+
+// Suffix of the runtime kernels for the array's elements, or "" if they are not numbers.
+std::string CodegenVisitor::getArrayKernel(const ArrayInfo& info) {
+    const std::string& e = info.elementType;
+    if (e == "single") {
+        return "f32";
+    }
+    if (e == "real" || e == "integer" || e == "char" || e == "boolean" || RangeTypes.count(e)) {
+        return "f64";
+    }
+    return "";
+}
+
+// A routine the program declares with the same name takes precedence.
+bool CodegenVisitor::isArrayBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    static const std::set<std::string> Names = { "sort", "binarysearch", "fill", "sum", "min", "max", "dot", "copy" };
+    auto* V = args.empty() ? nullptr : dynamic_cast<VarExpr*>(args[0].get());
+    return Names.count(callee) && V && ArrayVars.count(V->name) && !getFunction(callee);
+}
+
+// sort, binarysearch, fill, sum, min, max and dot call the kernels in runtimeArray.cpp;
+// integer arrays sort with a radix sort, real and single arrays with pdqsort.
+// copy(src, dst) moves as many elements as fit with one memmove.
+llvm::Value* CodegenVisitor::CreateArrayBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    const ArrayInfo& info = ArrayVars[static_cast<VarExpr*>(args[0].get())->name];
+    if ((callee == "sort" || callee == "fill") && isConstantTarget(*args[0])) {
+        return nullptr;
+    }
+    if (callee == "copy" && args.size() == 2 && isConstantTarget(*args[1])) {
+        return nullptr;
+    }
+    if (info.bits) {
+        if (callee == "fill") {
+            return CreateBitsBuiltin(callee, args);
+        }
+        std::string m = callee + " is not Supported on Packed Boolean Arrays";
+        return LogErrorV(m.c_str());
+    }
+
+    llvm::Value* Data;
+    llvm::Value* Length;
+    std::string kernel = getArrayKernel(info);
+    if (kernel.empty() || !getArraySpan(*args[0], Data, Length)) {
+        std::string m = callee + " Expects an Array of Numbers";
+        return LogErrorV(m.c_str());
+    }
+    size_t arity = callee == "sort" || callee == "sum" || callee == "min" || callee == "max" ? 1 : 2;
+    if (args.size() != arity && !(callee == "fill" && args.size() == 4)) {
+        std::string m = "Wrong Number of Arguments to " + callee;
+        return LogErrorV(m.c_str());
+    }
+
+    llvm::Type* Elem = getElementType(info.elementType);
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    llvm::Type* Double = llvm::Type::getDoubleTy(*TheContext);
+    llvm::Type* Void = llvm::Type::getVoidTy(*TheContext);
+    llvm::Value* Low = llvm::ConstantInt::get(Int64, info.dynamic ? 0 : info.min);
+
+    if (callee == "sort") {
+        std::string name = kernel == "f64" && info.elementType != "real" ? "__pascal_radixsort_f64" : "__pascal_sort_" + kernel;
+        CreateRuntimeCall(name, Void, { Data, Length });
+        return llvm::Constant::getNullValue(Double);
+    }
+
+    if (callee == "sum" || callee == "min" || callee == "max") {
+        llvm::Value* R = CreateRuntimeCall("__pascal_" + callee + "_" + kernel, Elem, { Data, Length });
+        llvm::cast<llvm::CallInst>(R)->getCalledFunction()->setOnlyReadsMemory();
+        return R;
+    }
+
+    if (callee == "dot" || callee == "copy") {
+        llvm::Value* Data2;
+        llvm::Value* Length2;
+        const ArrayInfo* other = getArraySpan(*args[1], Data2, Length2);
+        if (!other || getArrayKernel(*other) != kernel) {
+            std::string m = callee + " Expects Two Arrays of the Same Element Type";
+            return LogErrorV(m.c_str());
+        }
+        llvm::Value* N = Builder->CreateSelect(Builder->CreateICmpULT(Length, Length2), Length, Length2, "count");
+        if (callee == "dot") {
+            llvm::Value* R = CreateRuntimeCall("__pascal_dot_" + kernel, Elem, { Data, Data2, N });
+            llvm::cast<llvm::CallInst>(R)->getCalledFunction()->setOnlyReadsMemory();
+            return R;
+        }
+        uint64_t size = TheModule->getDataLayout().getTypeAllocSize(Elem).getFixedValue();
+        llvm::Value* Bytes = Builder->CreateMul(N, llvm::ConstantInt::get(Int64, size), "bytes");
+        llvm::Align align = TheModule->getDataLayout().getPrefTypeAlign(Elem);
+        Builder->CreateMemMove(Data2, align, Data, align, Bytes);
+        return llvm::Constant::getNullValue(Double);
+    }
+
+    if (args.size() == 4 || callee == "binarysearch") {
+        if (!info.dims.empty()) {
+            std::string m = callee + " Expects a One-Dimensional Array";
+            return LogErrorV(m.c_str());
+        }
+    }
+
+    if (callee == "binarysearch") {
+        llvm::Value* Key = args[1]->accept(*this);
+        if (!Key) {
+            return nullptr;
+        }
+        llvm::Value* I = CreateRuntimeCall("__pascal_bsearch_" + kernel, Int64, { Data, Length, convertValue(Key, Elem) });
+        llvm::cast<llvm::CallInst>(I)->getCalledFunction()->setOnlyReadsMemory();
+        // Not found is one below the array's low bound.
+        llvm::Value* Missing = Builder->CreateICmpSLT(I, llvm::ConstantInt::get(Int64, 0), "missing");
+        llvm::Value* Index = Builder->CreateSelect(Missing, llvm::ConstantInt::get(Int64, -1), I);
+        return Builder->CreateSIToFP(Builder->CreateAdd(Index, Low), Double, "index");
+    }
+
+    llvm::Value* From = llvm::ConstantInt::get(Int64, 0);
+    llvm::Value* To = Builder->CreateSub(Length, llvm::ConstantInt::get(Int64, 1), "to");
+    if (args.size() == 4) {
+        llvm::Value* Lo = args[1]->accept(*this);
+        llvm::Value* Hi = args[2]->accept(*this);
+        if (!Lo || !Hi) {
+            return nullptr;
+        }
+        From = Builder->CreateSub(convertValue(Lo, Int64), Low, "from");
+        To = Builder->CreateSub(convertValue(Hi, Int64), Low, "to");
+    }
+    llvm::Value* Value = args.back()->accept(*this);
+    if (!Value) {
+        return nullptr;
+    }
+    CreateRuntimeCall("__pascal_fill_" + kernel, Void, { Data, Length, From, To, convertValue(Value, Elem) });
+    return llvm::Constant::getNullValue(Double);
+}
+
+llvm::Value* CodegenVisitor::CreateArrayBound(const std::string& bound, const std::string& name) {
+    const ArrayInfo& info = ArrayVars[name];
+    llvm::Type* Double = llvm::Type::getDoubleTy(*TheContext);
+
+    if (!info.dynamic) {
+        int value = bound == "low" ? info.min : bound == "high" ? info.max : info.max - info.min + 1;
+        return llvm::ConstantFP::get(Double, value);
+    }
+    if (bound == "low") {
+        return llvm::ConstantFP::get(Double, 0.0);
+    }
+
+    llvm::Type* T;
+    llvm::Value* A = getVariablePtr(name, T);
+    llvm::Value* Length = Builder->CreateLoad(llvm::Type::getInt64Ty(*TheContext), Builder->CreateStructGEP(T, A, 1), name + ".len");
+    if (bound == "high") {
+        Length = Builder->CreateSub(Length, llvm::ConstantInt::get(Length->getType(), 1), "high");
+    }
+    return Builder->CreateSIToFP(Length, Double, bound);
+}
+
+llvm::Value* CodegenVisitor::CreateSetLength(std::vector<std::unique_ptr<Expr>>& args) {
+    auto* V = args.size() == 2 ? dynamic_cast<VarExpr*>(args[0].get()) : nullptr;
+    llvm::Type* T;
+    llvm::Value* A = V ? getVariablePtr(V->name, T) : nullptr;
+    if (!A || T != getDynArrayType()) {
+        return LogErrorV("setlength Expects a Dynamic Array");
+    }
+
+    llvm::Value* N = args[1]->accept(*this);
+    if (!N) {
+        return nullptr;
+    }
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    N = Builder->CreateFPToSI(N, Int64, "newlen");
+    uint64_t size = TheModule->getDataLayout().getTypeAllocSize(getElementType(ArrayVars[V->name].elementType)).getFixedValue();
+    return CreateRuntimeCall("__pascal_setlength", llvm::Type::getVoidTy(*TheContext), { A, N, llvm::ConstantInt::get(Int64, size) });
+}
+
+// A map variable is { ctrl, slots, capacity, size, growth left }; see runtimeMap.cpp.
+llvm::StructType* CodegenVisitor::getMapType() {
+    if (llvm::StructType* T = llvm::StructType::getTypeByName(*TheContext, "map")) {
+        return T;
+    }
+    llvm::Type* Ptr = llvm::PointerType::get(*TheContext, 0);
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    return llvm::StructType::create(*TheContext, { Ptr, Ptr, Int64, Int64, Int64 }, "map");
+}
+
+// Ordinal keys share the integer instantiation of the runtime; "" if the key type is unsupported.
+std::string CodegenVisitor::getMapKeyKind(const std::string& keyType) {
+    if (keyType == "integer" || keyType == "char" || keyType == "boolean" || RangeTypes.count(keyType)) {
+        return "int";
+    }
+    if (keyType == "real" || keyType == "single") {
+        return "real";
+    }
+    if (keyType == "string") {
+        return "str";
+    }
+    return "";
+}
+
+// Calls __pascal_map_<kind>_<op> with the map, the key converted for its kind and an optional value.
+llvm::Value* CodegenVisitor::CreateMapCall(const std::string& op, const std::string& name, Expr& key, llvm::Type* ret, llvm::Value* value) {
+    llvm::Type* T;
+    llvm::Value* M = getVariablePtr(name, T);
+    llvm::Value* K = key.accept(*this);
+    if (!M || !K) {
+        return nullptr;
+    }
+
+    const std::string& kind = MapVars[name];
+    if (kind == "str") {
+        if (!K->getType()->isPointerTy() && !K->getType()->isIntegerTy(8)) {
+            return LogErrorV("Map Key Must be a String");
+        }
+        K = toStringValue(K);
+    } else if (K->getType()->isPointerTy()) {
+        return LogErrorV("Map Key Must be a Number");
+    } else if (kind == "int") {
+        K = convertValue(K, llvm::Type::getInt64Ty(*TheContext));
+    } else {
+        K = convertValue(K, llvm::Type::getDoubleTy(*TheContext));
+    }
+
+    std::vector<llvm::Value*> args = { M, K };
+    if (value) {
+        if (value->getType()->isPointerTy()) {
+            return LogErrorV("Map Values Must be Numbers");
+        }
+        args.push_back(convertValue(value, llvm::Type::getDoubleTy(*TheContext)));
+    }
+    llvm::Value* Call = CreateRuntimeCall("__pascal_map_" + kind + "_" + op, ret, args);
+    if (op == "get" || op == "contains") {
+        llvm::cast<llvm::CallInst>(Call)->getCalledFunction()->setOnlyReadsMemory();
+    }
+    if (kind == "str") {
+        releaseStringTemp(K);
+    }
+    return Call;
+}
+
+// contains(m, k), delete(m, k) and length(m); delete returns whether the key was there.
+llvm::Value* CodegenVisitor::CreateMapBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    const std::string& name = static_cast<VarExpr*>(args[0].get())->name;
+    if (callee == "length") {
+        llvm::Type* T;
+        llvm::Value* M = getVariablePtr(name, T);
+        llvm::Value* Size = Builder->CreateLoad(llvm::Type::getInt64Ty(*TheContext), Builder->CreateStructGEP(getMapType(), M, 3), "mapsize");
+        return Builder->CreateSIToFP(Size, llvm::Type::getDoubleTy(*TheContext), "length");
+    }
+
+    if (args.size() != 2) {
+        std::string m = callee + " Takes a Map and a Key";
+        return LogErrorV(m.c_str());
+    }
+    llvm::Value* Found = CreateMapCall(callee, name, *args[1], llvm::Type::getInt1Ty(*TheContext));
+    if (!Found) {
+        return nullptr;
+    }
+    return Builder->CreateUIToFP(Found, llvm::Type::getDoubleTy(*TheContext), callee);
+}
+
+// for k in m asks the runtime for the next occupied slot after a cursor until there is none.
+llvm::Value* CodegenVisitor::CreateForIn(ForStmt& ast) {
+    if (auto* I = dynamic_cast<CallExpr*>(ast.in.get()); I && Iterators.count(I->callee)) {
+        return CreateIteratorLoop(ast, *I);
+    }
+    auto* C = dynamic_cast<VarExpr*>(ast.in.get());
+    if (!C || !MapVars.count(C->name)) {
+        return LogErrorV("For-In Loops Need a Map");
+    }
+    const std::string& kind = MapVars[C->name];
+    llvm::Type* MT;
+    llvm::Value* M = getVariablePtr(C->name, MT);
+    llvm::Type* T;
+    llvm::Value* A = getVariablePtr(ast.name, T);
+    if (!A) {
+        std::string msg = "Unknown variable name: " + ast.name;
+        return LogErrorV(msg.c_str());
+    }
+    bool isString = T == getStringType();
+    if (isString != (kind == "str")) {
+        return LogErrorV("Loop Variable Does Not Match the Map Key Type");
+    }
+
+    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    llvm::Value* Cursor = CreateEntryBlockAlloca(TheFunction, "cursor", Int64);
+    Builder->CreateStore(llvm::ConstantInt::get(Int64, 0), Cursor);
+    llvm::Type* KeyT = kind == "int" ? Int64 : llvm::Type::getDoubleTy(*TheContext);
+    llvm::Value* Key = isString ? A : CreateEntryBlockAlloca(TheFunction, "key", KeyT);
+
+    llvm::BasicBlock* CondBB = llvm::BasicBlock::Create(*TheContext, "forin", TheFunction);
+    llvm::BasicBlock* BodyBB = llvm::BasicBlock::Create(*TheContext, "forinbody", TheFunction);
+    llvm::BasicBlock* AfterBB = llvm::BasicBlock::Create(*TheContext, "afterforin", TheFunction);
+    Builder->CreateBr(CondBB);
+    Builder->SetInsertPoint(CondBB);
+    llvm::Value* Found = CreateRuntimeCall("__pascal_map_" + kind + "_next", llvm::Type::getInt1Ty(*TheContext), { M, Cursor, Key });
+    Builder->CreateCondBr(Found, BodyBB, AfterBB);
+
+    Builder->SetInsertPoint(BodyBB);
+    if (!isString) {
+        llvm::Value* K = Builder->CreateLoad(KeyT, Key, "key");
+        if (kind == "int") {
+            K = T->isIntegerTy() ? Builder->CreateTrunc(K, T, "key") : Builder->CreateSIToFP(K, T, "key");
+        }
+        Builder->CreateStore(convertValue(K, T), A);
+    }
+    if (!ast.body->accept(*this)) {
+        return nullptr;
+    }
+    Builder->CreateBr(CondBB);
+
+    Builder->SetInsertPoint(AfterBB);
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
+
+// An iterator is a switched-resume coroutine whose promise holds the last value
+// yielded. The frame comes from malloc only when coro.alloc says so, which lets
+// CoroElide put it on the caller's stack once the iterator is inlined into a loop.
+llvm::Function* CodegenVisitor::CreateIterator(FuncDecl& ast, llvm::Function* TheFunction) {
+    llvm::Type* Ptr = llvm::PointerType::get(*TheContext, 0);
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    TheFunction->setPresplitCoroutine();
+
+    llvm::BasicBlock* BB = llvm::BasicBlock::Create(*TheContext, "entry", TheFunction);
+    llvm::BasicBlock* AllocBB = llvm::BasicBlock::Create(*TheContext, "coro.alloc", TheFunction);
+    llvm::BasicBlock* BeginBB = llvm::BasicBlock::Create(*TheContext, "coro.begin", TheFunction);
+    Builder->SetInsertPoint(BB);
+    llvm::AllocaInst* Promise = CreateEntryBlockAlloca(TheFunction, "promise");
+    llvm::Value* Null = llvm::ConstantPointerNull::get(llvm::PointerType::get(*TheContext, 0));
+    llvm::Value* Id = Builder->CreateIntrinsic(llvm::Intrinsic::coro_id, {}, { Builder->getInt32(0), Promise, Null, Null }, nullptr, "id");
+    llvm::Value* NeedAlloc = Builder->CreateIntrinsic(llvm::Intrinsic::coro_alloc, {}, { Id }, nullptr, "needalloc");
+    Builder->CreateCondBr(NeedAlloc, AllocBB, BeginBB);
+
+    Builder->SetInsertPoint(AllocBB);
+    llvm::Value* Size = Builder->CreateIntrinsic(llvm::Intrinsic::coro_size, { Int64 }, {}, nullptr, "size");
+    llvm::Value* Alloc = CreateRuntimeCall("malloc", Ptr, { Size });
+    Builder->CreateBr(BeginBB);
+
+    Builder->SetInsertPoint(BeginBB);
+    llvm::PHINode* Mem = Builder->CreatePHI(Ptr, 2, "mem");
+    Mem->addIncoming(Null, BB);
+    Mem->addIncoming(Alloc, AllocBB);
+    llvm::Value* Hdl = Builder->CreateIntrinsic(llvm::Intrinsic::coro_begin, {}, { Id, Mem }, nullptr, "hdl");
+
+    llvm::BasicBlock* CleanupBB = llvm::BasicBlock::Create(*TheContext, "coro.cleanup", TheFunction);
+    llvm::BasicBlock* SuspendBB = llvm::BasicBlock::Create(*TheContext, "coro.suspend", TheFunction);
+    bindArguments(TheFunction, *ast.proto);
+    CoroPromise = Promise;
+    CoroCleanup = CleanupBB;
+    CoroSuspend = SuspendBB;
+    for (auto& d : ast.locals) {
+        d->accept(*this);
+    }
+
+    CreateCoroSuspend(false);
+    llvm::Value* BodyV = this->visit(*ast.body);
+    if (BodyV) {
+        CreateCoroSuspend(true);
+        Builder->CreateUnreachable();
+
+        Builder->SetInsertPoint(CleanupBB);
+        releaseLocals();
+        llvm::Value* Frame = Builder->CreateIntrinsic(llvm::Intrinsic::coro_free, {}, { Id, Hdl }, nullptr, "frame");
+        CreateRuntimeCall("free", llvm::Type::getVoidTy(*TheContext), { Frame });
+        Builder->CreateBr(SuspendBB);
+
+        Builder->SetInsertPoint(SuspendBB);
+        Builder->CreateIntrinsic(llvm::Intrinsic::coro_end, {}, { Hdl, Builder->getFalse(), llvm::ConstantTokenNone::get(*TheContext) });
+        Builder->CreateRet(Hdl);
+    }
+
+    CoroPromise = nullptr;
+    CoroCleanup = nullptr;
+    CoroSuspend = nullptr;
+    if (BodyV) {
+        return TheFunction;
+    }
+    TheFunction->eraseFromParent();
+    return nullptr;
+}
+
+// Suspending returns to whoever resumed the iterator; the switch picks where a
+// later resume (0) or destroy (1) continues. After the final suspend the
+// iterator may only be destroyed.
+void CodegenVisitor::CreateCoroSuspend(bool final) {
+    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+    llvm::Value* State = Builder->CreateIntrinsic(llvm::Intrinsic::coro_suspend, {}, { llvm::ConstantTokenNone::get(*TheContext), Builder->getInt1(final) }, nullptr, "state");
+    llvm::SwitchInst* SI = Builder->CreateSwitch(State, CoroSuspend, 2);
+    SI->addCase(Builder->getInt8(1), CoroCleanup);
+    if (!final) {
+        llvm::BasicBlock* ResumeBB = llvm::BasicBlock::Create(*TheContext, "resume", TheFunction, CoroCleanup);
+        SI->addCase(Builder->getInt8(0), ResumeBB);
+        Builder->SetInsertPoint(ResumeBB);
+    } else {
+        llvm::BasicBlock* DeadBB = llvm::BasicBlock::Create(*TheContext, "final", TheFunction, CoroCleanup);
+        SI->addCase(Builder->getInt8(0), DeadBB);
+        Builder->SetInsertPoint(DeadBB);
+    }
+}
+
+// for x in gen(...) resumes the iterator once per value and reads it from the
+// promise until the body runs off its end.
+llvm::Value* CodegenVisitor::CreateIteratorLoop(ForStmt& ast, CallExpr& call) {
+    llvm::Type* T;
+    llvm::Value* A = getVariablePtr(ast.name, T);
+    if (!A) {
+        std::string msg = "Unknown variable name: " + ast.name;
+        return LogErrorV(msg.c_str());
+    }
+    if (T == getStringType() || T->isAggregateType()) {
+        return LogErrorV("Loop Variable Does Not Match the Iterator Type");
+    }
+    llvm::Value* Hdl = CreatePascalCall(call.callee, call.args);
+    if (!Hdl) {
+        return nullptr;
+    }
+
+    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* CondBB = llvm::BasicBlock::Create(*TheContext, "forin", TheFunction);
+    llvm::BasicBlock* BodyBB = llvm::BasicBlock::Create(*TheContext, "forinbody", TheFunction);
+    llvm::BasicBlock* AfterBB = llvm::BasicBlock::Create(*TheContext, "afterforin", TheFunction);
+    Builder->CreateBr(CondBB);
+    Builder->SetInsertPoint(CondBB);
+    Builder->CreateIntrinsic(llvm::Intrinsic::coro_resume, {}, { Hdl });
+    llvm::Value* Done = Builder->CreateIntrinsic(llvm::Intrinsic::coro_done, {}, { Hdl }, nullptr, "done");
+    Builder->CreateCondBr(Done, AfterBB, BodyBB);
+
+    Builder->SetInsertPoint(BodyBB);
+    llvm::Value* P = Builder->CreateIntrinsic(llvm::Intrinsic::coro_promise, {}, { Hdl, Builder->getInt32(8), Builder->getFalse() }, nullptr, "promise");
+    llvm::Value* V = Builder->CreateLoad(llvm::Type::getDoubleTy(*TheContext), P, "value");
+    Builder->CreateStore(convertValue(V, T), A);
+    if (!ast.body->accept(*this)) {
+        return nullptr;
+    }
+    Builder->CreateBr(CondBB);
+
+    Builder->SetInsertPoint(AfterBB);
+    Builder->CreateIntrinsic(llvm::Intrinsic::coro_destroy, {}, { Hdl });
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
+
+// A text variable holds the runtime's file object, created by assign.
+llvm::StructType* CodegenVisitor::getTextType() {
+    if (llvm::StructType* T = llvm::StructType::getTypeByName(*TheContext, "text")) {
+        return T;
+    }
+    return llvm::StructType::create(*TheContext, { llvm::PointerType::get(*TheContext, 0) }, "text");
+}
+
+// Returns the address of a text variable, or null if the expression is not one.
+llvm::Value* CodegenVisitor::getTextPtr(Expr& ast) {
+    auto* V = dynamic_cast<VarExpr*>(&ast);
+    llvm::Type* T;
+    if (!V) {
+        return nullptr;
+    }
+    llvm::Value* P = getVariablePtr(V->name, T);
+    return P && T == getTextType() ? P : nullptr;
+}
+
+bool CodegenVisitor::isFileBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    static const std::set<std::string> Names = { "assign", "reset", "rewrite", "close", "eof" };
+    if (!Names.count(callee) || getFunction(callee)) {
+        return false;
+    }
+    return (callee == "eof" && args.empty()) || (!args.empty() && getTextPtr(*args[0]));
+}
+
+// assign(f, name), reset(f), rewrite(f), close(f) and eof(f) call runtimeFile.cpp;
+// eof without a file tests the console.
+llvm::Value* CodegenVisitor::CreateFileBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    llvm::Value* F = args.empty() ? llvm::ConstantPointerNull::get(llvm::PointerType::get(*TheContext, 0)) : getTextPtr(*args[0]);
+    if (callee == "eof") {
+        if (args.size() > 1) {
+            return LogErrorV("eof Takes at Most One File");
+        }
+        llvm::Value* Eof = CreateRuntimeCall("__pascal_file_eof", llvm::Type::getInt1Ty(*TheContext), { F });
+        return Builder->CreateUIToFP(Eof, llvm::Type::getDoubleTy(*TheContext), "eof");
+    }
+    if (callee == "assign") {
+        if (args.size() != 2 || !isStringExpr(*args[1])) {
+            return LogErrorV("assign Takes a File and a File Name");
+        }
+        llvm::Value* S = args[1]->accept(*this);
+        if (!S) {
+            return nullptr;
+        }
+        S = toStringValue(S);
+        llvm::Value* Call = CreateRuntimeCall("__pascal_file_assign", llvm::Type::getVoidTy(*TheContext), { F, S });
+        releaseStringTemp(S);
+        return Call;
+    }
+    if (args.size() != 1) {
+        std::string m = callee + " Takes One File";
+        return LogErrorV(m.c_str());
+    }
+    return CreateRuntimeCall("__pascal_file_" + callee, llvm::Type::getVoidTy(*TheContext), { F });
+}
+
+// {$PARALLEL} outlines the loop body into a function over a range of iteration
+// numbers and hands it to __pascal_parallel_for (runtimeParallel.cpp). Variables
+// of the enclosing routine are shared by reference through a context array and
+// the loop variable is private. Each range keeps a private accumulator per
+// reduction and folds it into the shared variable when it is done.
+// Bounds are converted to the loop variable's type. Expressions are rounded to
+// an ordinal first, so the loop always meets its end exactly; ones that fold
+// to constants, such as high(a) on a fixed array, stay constants.
+bool CodegenVisitor::getForBounds(ForStmt& ast, llvm::Type* T, llvm::Value*& Start, llvm::Value*& End) {
+    if (!ast.from) {
+        Start = llvm::ConstantFP::get(T, (double)ast.start);
+        End = llvm::ConstantFP::get(T, (double)ast.end);
+        return true;
+    }
+    Start = ast.from->accept(*this);
+    End = Start ? ast.to->accept(*this) : nullptr;
+    if (!Start || !End) {
+        return false;
+    }
+    auto isOrdinal = [](llvm::Type* V) { return V->isFloatingPointTy() || V->isIntegerTy(1) || V->isIntegerTy(8); };
+    if (!isOrdinal(Start->getType()) || !isOrdinal(End->getType())) {
+        LogErrorV("For Loop Bounds Must be Ordinal");
+        return false;
+    }
+    Start = Builder->CreateSIToFP(toOrdinal(Start), T, "start");
+    End = Builder->CreateSIToFP(toOrdinal(End), T, "end");
+    return true;
+}
+
+llvm::Value* CodegenVisitor::CreateParallelFor(ForStmt& ast) {
+    llvm::Type* Ptr = llvm::PointerType::get(*TheContext, 0);
+    llvm::Type* Int64 = llvm::Type::getInt64Ty(*TheContext);
+    llvm::Function* Parent = Builder->GetInsertBlock()->getParent();
+
+    llvm::Type* T = nullptr;
+    llvm::Value* A = getVariablePtr(ast.name, T);
+    if (!A) {
+        A = CreateEntryBlockAlloca(Parent, ast.name);
+        NamedValues[ast.name] = llvm::cast<llvm::AllocaInst>(A);
+        T = llvm::Type::getDoubleTy(*TheContext);
+    }
+    llvm::Type* Double = llvm::Type::getDoubleTy(*TheContext);
+    llvm::Value* Start;
+    llvm::Value* End;
+    if (!getForBounds(ast, Double, Start, End)) {
+        return nullptr;
+    }
+    int step = ast.isdownto ? -1 : 1;
+    llvm::Value* First = Builder->CreateFPToSI(Start, Int64, "first");
+    llvm::Value* Last = Builder->CreateFPToSI(End, Int64, "last");
+    llvm::Value* N = Builder->CreateAdd(Builder->CreateMul(Builder->CreateSub(Last, First), Builder->getInt64(step)), Builder->getInt64(1), "count");
+    auto* FirstC = llvm::dyn_cast<llvm::ConstantInt>(First);
+    auto* LastC = llvm::dyn_cast<llvm::ConstantInt>(Last);
+    auto* NC = llvm::dyn_cast<llvm::ConstantInt>(N);
+    if (NC && NC->getSExtValue() <= 0) {
+        Builder->CreateStore(convertValue(Start, T), A);
+        return llvm::Constant::getNullValue(Double);
+    }
+
+    std::vector<std::pair<std::string, llvm::Type*>> captured;
+    std::vector<llvm::Value*> addresses;
+    for (auto& [name, alloca] : NamedValues) {
+        llvm::Type* VT;
+        if (alloca && name != ast.name) {
+            addresses.push_back(getVariablePtr(name, VT));
+            captured.push_back(std::make_pair(name, VT));
+        }
+    }
+    // A start only known at run time goes to the body in the last slot.
+    if (!FirstC) {
+        llvm::Value* FirstP = CreateEntryBlockAlloca(Parent, "parallel.first", Int64);
+        Builder->CreateStore(First, FirstP);
+        addresses.push_back(FirstP);
+    }
+    llvm::ArrayType* CtxT = llvm::ArrayType::get(Ptr, std::max<size_t>(addresses.size(), 1));
+    llvm::Value* Ctx = CreateEntryBlockAlloca(Parent, "parallel.ctx", CtxT);
+    for (size_t i = 0; i < addresses.size(); i++) {
+        Builder->CreateStore(addresses[i], Builder->CreateConstGEP2_32(CtxT, Ctx, 0, i));
+    }
+
+    llvm::FunctionType* BodyT = llvm::FunctionType::get(llvm::Type::getVoidTy(*TheContext), { Ptr, Int64, Int64 }, false);
+    llvm::Function* Body = llvm::Function::Create(BodyT, llvm::Function::InternalLinkage, Parent->getName() + ".parallel", TheModule.get());
+    Body->setDoesNotThrow();
+    llvm::IRBuilderBase::InsertPoint SavedIP = Builder->saveIP();
+    std::map<std::string, llvm::AllocaInst*> SavedValues = NamedValues;
+    std::map<std::string, llvm::Type*> SavedReferences = ReferenceTypes;
+    std::map<std::string, std::pair<int, int>> SavedRanges = InductionRanges;
+    llvm::Value* SavedPromise = CoroPromise;
+    auto restore = [&]() {
+        Builder->restoreIP(SavedIP);
+        NamedValues = SavedValues;
+        ReferenceTypes = SavedReferences;
+        InductionRanges = SavedRanges;
+        CoroPromise = SavedPromise;
+    };
+
+    Builder->SetInsertPoint(llvm::BasicBlock::Create(*TheContext, "entry", Body));
+    NamedValues.clear();
+    ReferenceTypes.clear();
+    CoroPromise = nullptr;
+    llvm::Value* CtxArg = Body->getArg(0);
+    llvm::Value* Lo = Body->getArg(1);
+    llvm::Value* Hi = Body->getArg(2);
+    for (size_t i = 0; i < captured.size(); i++) {
+        llvm::Value* P = Builder->CreateLoad(Ptr, Builder->CreateConstGEP2_32(CtxT, CtxArg, 0, i), captured[i].first + ".addr");
+        llvm::AllocaInst* Ref = CreateEntryBlockAlloca(Body, captured[i].first, Ptr);
+        Builder->CreateStore(P, Ref);
+        NamedValues[captured[i].first] = Ref;
+        ReferenceTypes[captured[i].first] = captured[i].second;
+    }
+    llvm::AllocaInst* Var = CreateEntryBlockAlloca(Body, ast.name, T);
+    NamedValues[ast.name] = Var;
+
+    std::vector<std::tuple<llvm::Value*, llvm::AllocaInst*, int>> accumulators;
+    for (auto& [op, name] : ast.reductions) {
+        llvm::Type* RT;
+        llvm::Value* Shared = getVariablePtr(name, RT);
+        if (!Shared || !RT->isFloatingPointTy() || name == ast.name) {
+            Body->eraseFromParent();
+            restore();
+            std::string m = "Reduction Variable Must be a Real: " + name;
+            return LogErrorV(m.c_str());
+        }
+        double identity = op == "+" ? 0.0 : op == "min" ? INFINITY : -INFINITY;
+        llvm::AllocaInst* Acc = CreateEntryBlockAlloca(Body, name, RT);
+        Builder->CreateStore(llvm::ConstantFP::get(RT, identity), Acc);
+        NamedValues[name] = Acc;
+        ReferenceTypes.erase(name);
+        accumulators.push_back(std::make_tuple(Shared, Acc, op == "+" ? 0 : op == "min" ? 1 : 2));
+    }
+
+    llvm::BasicBlock* EntryBB = Builder->GetInsertBlock();
+    llvm::BasicBlock* LoopBB = llvm::BasicBlock::Create(*TheContext, "loop", Body);
+    llvm::BasicBlock* AfterBB = llvm::BasicBlock::Create(*TheContext, "afterloop", Body);
+    Builder->CreateCondBr(Builder->CreateICmpSLT(Lo, Hi), LoopBB, AfterBB);
+    Builder->SetInsertPoint(LoopBB);
+    llvm::PHINode* I = Builder->CreatePHI(Int64, 2, "i");
+    I->addIncoming(Lo, EntryBB);
+    llvm::Value* Base = FirstC;
+    if (!FirstC) {
+        llvm::Value* FirstP = Builder->CreateLoad(Ptr, Builder->CreateConstGEP2_32(CtxT, CtxArg, 0, captured.size()), "first.addr");
+        Base = Builder->CreateLoad(Int64, FirstP, "first");
+    }
+    llvm::Value* Index = Builder->CreateAdd(Base, Builder->CreateMul(I, Builder->getInt64(step)));
+    Builder->CreateStore(convertValue(Builder->CreateSIToFP(Index, Double), T), Var);
+
+    int start, end;
+    if (FirstC && LastC && !WrittenLoops.count(&ast) && getIntConstant(FirstC->getSExtValue(), start) && getIntConstant(LastC->getSExtValue(), end)) {
+        InductionRanges[ast.name] = std::make_pair(std::min(start, end), std::max(start, end));
+    } else {
+        InductionRanges.erase(ast.name);
+    }
+    if (!ast.body->accept(*this)) {
+        Body->eraseFromParent();
+        restore();
+        return nullptr;
+    }
+    llvm::Value* Next = Builder->CreateAdd(I, Builder->getInt64(1), "nexti");
+    I->addIncoming(Next, Builder->GetInsertBlock());
+    Builder->CreateCondBr(Builder->CreateICmpSLT(Next, Hi), LoopBB, AfterBB);
+
+    Builder->SetInsertPoint(AfterBB);
+    for (auto& [Shared, Acc, op] : accumulators) {
+        llvm::Type* RT = Acc->getAllocatedType();
+        std::string kernel = RT->isFloatTy() ? "f32" : "f64";
+        llvm::Value* V = Builder->CreateLoad(RT, Acc);
+        CreateRuntimeCall("__pascal_reduce_" + kernel, llvm::Type::getVoidTy(*TheContext), { Shared, V, Builder->getInt32(op) });
+    }
+    Builder->CreateRetVoid();
+    restore();
+
+    CreateRuntimeCall("__pascal_parallel_for", llvm::Type::getVoidTy(*TheContext), { Body, Ctx, N, Builder->getInt64(ast.chunk), Builder->getInt1(ast.dynamic) });
+    // Leave the loop variable where the sequential loop would.
+    llvm::Value* After = Builder->CreateFAdd(End, llvm::ConstantFP::get(Double, step));
+    if (!NC) {
+        After = Builder->CreateSelect(Builder->CreateICmpSGT(N, Builder->getInt64(0)), After, Start);
+    }
+    Builder->CreateStore(convertValue(After, T), A);
+    return llvm::Constant::getNullValue(Double);
+}
+
+llvm::StructType* CodegenVisitor::getChannelType() {
+    if (llvm::StructType* T = llvm::StructType::getTypeByName(*TheContext, "channel")) {
+        return T;
+    }
+    return llvm::StructType::create(*TheContext, { llvm::PointerType::get(*TheContext, 0) }, "channel");
+}
+
+// Returns the address of a channel variable, or null if the expression is not one.
+llvm::Value* CodegenVisitor::getChannelPtr(Expr& ast) {
+    auto* V = dynamic_cast<VarExpr*>(&ast);
+    llvm::Type* T;
+    if (!V) {
+        return nullptr;
+    }
+    llvm::Value* P = getVariablePtr(V->name, T);
+    return P && T == getChannelType() ? P : nullptr;
+}
+
+bool CodegenVisitor::isChannelBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    if ((callee != "send" && callee != "receive") || getFunction(callee)) {
+        return false;
+    }
+    return !args.empty() && getChannelPtr(*args[0]);
+}
+
+// send(c, v) and receive(c) call runtimeChannel.cpp; both block while the
+// channel is full or empty. Values travel as reals.
+llvm::Value* CodegenVisitor::CreateChannelBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    llvm::Value* C = getChannelPtr(*args[0]);
+    if (callee == "receive") {
+        if (args.size() != 1) {
+            return LogErrorV("receive Takes One Channel");
+        }
+        return CreateRuntimeCall("__pascal_chan_receive", llvm::Type::getDoubleTy(*TheContext), { C });
+    }
+    if (args.size() != 2) {
+        return LogErrorV("send Takes a Channel and a Value");
+    }
+    llvm::Value* V = args[1]->accept(*this);
+    if (!V) {
+        return nullptr;
+    }
+    if (!V->getType()->isFloatingPointTy()) {
+        return LogErrorV("Channels Carry Integer, Real or Boolean Values");
+    }
+    return CreateRuntimeCall("__pascal_chan_send", llvm::Type::getVoidTy(*TheContext), { C, convertValue(V, llvm::Type::getDoubleTy(*TheContext)) });
+}
+
+bool CodegenVisitor::isMathBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    static const std::set<std::string> Names = { "abs", "sqr", "sqrt", "sin", "cos", "exp", "ln", "trunc", "round" };
+    return Names.count(callee) && !getFunction(callee);
+}
+
+// Math builtins are LLVM intrinsics rather than libm calls, so they fold on
+// constants and vectorize; trunc and round return whole reals like div does.
+llvm::Value* CodegenVisitor::CreateMathBuiltin(const std::string& callee, std::vector<std::unique_ptr<Expr>>& args) {
+    static const std::map<std::string, llvm::Intrinsic::ID> Intrinsics = {
+        { "abs", llvm::Intrinsic::fabs }, { "sqrt", llvm::Intrinsic::sqrt }, { "sin", llvm::Intrinsic::sin },
+        { "cos", llvm::Intrinsic::cos }, { "exp", llvm::Intrinsic::exp }, { "ln", llvm::Intrinsic::log },
+        { "trunc", llvm::Intrinsic::trunc }, { "round", llvm::Intrinsic::round },
+    };
+    if (args.size() != 1) {
+        std::string m = callee + " Takes One Number";
+        return LogErrorV(m.c_str());
+    }
+    llvm::Value* V = args[0]->accept(*this);
+    if (!V) {
+        return nullptr;
+    }
+    if (!V->getType()->isFloatingPointTy()) {
+        std::string m = callee + " Takes One Number";
+        return LogErrorV(m.c_str());
+    }
+    if (callee == "sqr") {
+        return Builder->CreateFMul(V, V, "sqr");
+    }
+    return Builder->CreateUnaryIntrinsic(Intrinsics.at(callee), V, nullptr, callee);
+}
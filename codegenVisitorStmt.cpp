@@ -1,15 +1,56 @@
 #include "codegenVisitor.hpp"
 
 llvm::Function* CodegenVisitor::visit(Prototype& ast) {
-    std::vector<llvm::Type*> Doubles(ast.args.size(), llvm::Type::getDoubleTy(*TheContext));
-    
-    llvm::FunctionType* FT = llvm::FunctionType::get(llvm::Type::getDoubleTy(*TheContext), Doubles, false);
+    std::vector<llvm::Type*> Params;
+    std::vector<bool>& byReference = ByReference[ast.name];
+    std::vector<bool>& varParams = VarParams[ast.name];
+    std::vector<llvm::Type*>& paramTypes = ParamTypes[ast.name];
+    byReference.clear();
+    varParams.clear();
+    paramTypes.clear();
+    for (auto& a : ast.args) {
+        varParams.push_back(a->mode == ParamMode::param_var);
+        if (a->type == TokenType::tok_array && a->identifier == "string") {
+            return (llvm::Function*)LogErrorV("Arrays of Strings are not supported");
+        }
+        llvm::Type* T = getParamType(*a);
+        paramTypes.push_back(T);
+        // Open arrays pass their { data, length } pair by value whatever the mode.
+        byReference.push_back(T != getOpenArrayType() && (a->mode != ParamMode::param_value || T->isAggregateType()));
+        if (byReference.back()) {
+            Params.push_back(llvm::PointerType::get(*TheContext, 0));
+        } else {
+            Params.push_back(T);
+        }
+    }
+
+    llvm::Type* Ret = ast.procedure ? llvm::Type::getVoidTy(*TheContext) : llvm::Type::getDoubleTy(*TheContext);
+    if (ast.string) {
+        Ret = getStringType();
+    }
+    if (ast.iterator) {
+        if (ast.string) {
+            return (llvm::Function*)LogErrorV("Iterators Cannot Yield Strings");
+        }
+        // An iterator returns the handle of a coroutine suspended before its body.
+        Ret = llvm::PointerType::get(*TheContext, 0);
+        Iterators.insert(ast.name);
+    }
+    llvm::FunctionType* FT = llvm::FunctionType::get(Ret, Params, false);
 
     llvm::Function* F = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, ast.name, TheModule.get());
     
     unsigned idx = 0;
     for (auto &A : F->args()) {
-        A.setName(ast.args[idx++]->name);
+        ParamDecl& P = *ast.args[idx];
+        A.setName(P.name);
+        if (byReference[idx]) {
+            F->addParamAttr(idx, llvm::Attribute::NoCapture);
+            if (P.mode == ParamMode::param_const || (P.mode == ParamMode::param_value && !copiesValueParam(ast, idx))) {
+                F->addParamAttr(idx, llvm::Attribute::ReadOnly);
+            }
+        }
+        idx++;
     }
     
     return F;
@@ -30,18 +71,28 @@ llvm::Function* CodegenVisitor::visit(FuncDecl& ast) {
         return (llvm::Function*)LogErrorV("Function Cannot be Redefined");
     }
 
+    if (ast.proto->iterator) {
+        return CreateIterator(ast, TheFunction);
+    }
+
     llvm::BasicBlock* BB = llvm::BasicBlock::Create(*TheContext, "entry", TheFunction);
     Builder->SetInsertPoint(BB);
 
-    NamedValues.clear();
-    for (auto &A : TheFunction->args()) {
-        llvm::AllocaInst* Alloca = CreateEntryBlockAlloca(TheFunction, A.getName());
-        Builder->CreateStore(&A, Alloca);
-        NamedValues[std::string(A.getName())] = Alloca;
+    bindArguments(TheFunction, *ast.proto);
+    // A string result starts empty and is not released here: the caller takes it over.
+    llvm::AllocaInst* Result = CreateEntryBlockAlloca(TheFunction, ast.name, TheFunction->getReturnType());
+    if (ast.proto->string) {
+        Builder->CreateStore(llvm::Constant::getNullValue(getStringType()), Result);
+    }
+    NamedValues[ast.name] = Result;
+    for (auto& d : ast.locals) {
+        d->accept(*this);
     }
 
-    if (llvm::Value* RetVal = this->visit(*ast.body)) {
-        Builder->CreateRet(RetVal);
+    if (this->visit(*ast.body)) {
+        llvm::Value* R = Builder->CreateLoad(Result->getAllocatedType(), Result, "result");
+        releaseLocals();
+        Builder->CreateRet(R);
         return TheFunction;
     }
 
@@ -67,18 +118,581 @@ llvm::Function* CodegenVisitor::visit(ProcDecl& ast) {
     llvm::BasicBlock* BB = llvm::BasicBlock::Create(*TheContext, "entry", TheFunction);
     Builder->SetInsertPoint(BB);
 
-    NamedValues.clear();
-    for (auto &A : TheFunction->args()) {
-        llvm::AllocaInst* Alloca = CreateEntryBlockAlloca(TheFunction, A.getName());
-        Builder->CreateStore(&A, Alloca);
-        NamedValues[std::string(A.getName())] = Alloca;
+    bindArguments(TheFunction, *ast.proto);
+    for (auto& d : ast.locals) {
+        d->accept(*this);
     }
 
     if (this->visit(*ast.body)) {
-        Builder->CreateRetVoid(); 
+        releaseLocals();
+        Builder->CreateRetVoid();
         return TheFunction;
     }
 
     TheFunction->eraseFromParent();
     return nullptr;
-}
\ No newline at end of file
+}
+
+llvm::Value* CodegenVisitor::visit(ExprStmt& ast) {
+    return ast.expr->accept(*this);
+}
+
+llvm::Value* CodegenVisitor::visit(CallStmt& ast) {
+    if (ast.callee == "new" || ast.callee == "dispose" || ast.callee == "mark" || ast.callee == "release") {
+        if (!CreateHeapBuiltin(ast.callee, ast.args)) {
+            return nullptr;
+        }
+        return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+    }
+
+    if (isArrayBuiltin(ast.callee, ast.args)) {
+        if (!CreateArrayBuiltin(ast.callee, ast.args)) {
+            return nullptr;
+        }
+        return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+    }
+
+    if (isFileBuiltin(ast.callee, ast.args)) {
+        if (!CreateFileBuiltin(ast.callee, ast.args)) {
+            return nullptr;
+        }
+        return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+    }
+
+    if (isChannelBuiltin(ast.callee, ast.args)) {
+        if (!CreateChannelBuiltin(ast.callee, ast.args)) {
+            return nullptr;
+        }
+        return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+    }
+
+    if ((ast.callee == "delete" || ast.callee == "contains") && !ast.args.empty()) {
+        auto* V = dynamic_cast<VarExpr*>(ast.args[0].get());
+        if (V && MapVars.count(V->name)) {
+            if (!CreateMapBuiltin(ast.callee, ast.args)) {
+                return nullptr;
+            }
+            return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+        }
+    }
+
+    if (ast.callee == "setlength") {
+        if (!CreateSetLength(ast.args)) {
+            return nullptr;
+        }
+        return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+    }
+
+    if (Iterators.count(ast.callee)) {
+        return LogErrorV("Iterator Functions Can Only be Called in For-In Loops");
+    }
+
+    llvm::Value* Call = CreatePascalCall(ast.callee, ast.args);
+    if (!Call) {
+        return nullptr;
+    }
+    releaseStringTemp(Call);
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
+
+llvm::Value* CodegenVisitor::visit(AssignStmt& ast) {
+    if (isConstantTarget(*ast.name)) {
+        return nullptr;
+    }
+    std::string target = getTargetName(*ast.name);
+    if (getChannelPtr(*ast.name)) {
+        return LogErrorV("Channels Cannot be Assigned");
+    }
+    if (MapVars.count(target)) {
+        auto* A = dynamic_cast<ArrayExpr*>(ast.name.get());
+        if (!A || !A->subscripts.empty()) {
+            return LogErrorV("Maps Can Only be Assigned by Key");
+        }
+        llvm::Value* V = ast.value->accept(*this);
+        if (!V || !CreateMapCall("put", target, *A->index, llvm::Type::getVoidTy(*TheContext), V)) {
+            return nullptr;
+        }
+        return V;
+    }
+
+    if (isStringTarget(*ast.name)) {
+        llvm::Value* P = getLValuePtr(*ast.name);
+        if (!P || !CreateStringAssign(*ast.name, P, *ast.value)) {
+            return nullptr;
+        }
+        return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+    }
+
+    llvm::Type* AggregateT;
+    if (llvm::Value* P = getAggregatePtr(*ast.name, AggregateT)) {
+        if (!CreateAggregateAssign(P, AggregateT, *ast.value)) {
+            return nullptr;
+        }
+        return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+    }
+
+    if (isSetExpr(*ast.name)) {
+        llvm::Type* T;
+        llvm::Value* A = getVariablePtr(target, T);
+        llvm::Value* V = CreateSetValue(*ast.value, T, SetVars[target]);
+        if (!V) {
+            return nullptr;
+        }
+        Builder->CreateStore(V, A);
+        return V;
+    }
+
+    llvm::Value* V = ast.value->accept(*this);
+    if (!V) {
+        return nullptr;
+    }
+
+    if (auto* A = dynamic_cast<ArrayExpr*>(ast.name.get())) {
+        if (ArrayVars.count(A->arr->name) && ArrayVars[A->arr->name].bits) {
+            return CreateBitStore(*A, V);
+        }
+        llvm::Value* P = getArrayElementPtr(*A);
+        if (!P) {
+            return nullptr;
+        }
+        llvm::StoreInst* S = Builder->CreateStore(convertValue(V, getElementType(ArrayVars[A->arr->name].elementType)), P);
+        S->setMetadata(llvm::LLVMContext::MD_tbaa, getArrayTBAA(ArrayVars[A->arr->name]));
+        return V;
+    }
+
+    if (auto* R = dynamic_cast<RecordExpr*>(ast.name.get())) {
+        if (const BitField* B = getBitField(*R)) {
+            return CreateBitFieldStore(*R, *B, V);
+        }
+        llvm::Value* P = getRecordFieldPtr(*R);
+        if (!P) {
+            return nullptr;
+        }
+        llvm::StoreInst* S = Builder->CreateStore(convertValue(V, getRecordFieldType(*R)), P);
+        S->setMetadata(llvm::LLVMContext::MD_tbaa, getRecordFieldTBAA(*R));
+        return V;
+    }
+
+    auto* Var = static_cast<VarExpr*>(ast.name.get());
+    llvm::Type* T;
+    llvm::Value* A = getVariablePtr(Var->name, T);
+    if (!A) {
+        std::string msg = "Unknown variable name: " + Var->name;
+        return LogErrorV(msg.c_str());
+    }
+    if (T->isFloatingPointTy()) {
+        V = convertValue(V, T);
+    }
+    Builder->CreateStore(V, A);
+    return V;
+}
+
+llvm::Value* CodegenVisitor::visit(CompoundStmt& ast) {
+    llvm::Value* last = llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+    for (auto& s : ast.statements) {
+        last = s->accept(*this);
+        if (!last) {
+            return nullptr;
+        }
+    }
+
+    return last;
+}
+
+llvm::Value* CodegenVisitor::visit(IfStmt& ast) {
+    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* ThenBB = llvm::BasicBlock::Create(*TheContext, "then", TheFunction);
+    llvm::BasicBlock* MergeBB = llvm::BasicBlock::Create(*TheContext, "ifcont", TheFunction);
+    llvm::BasicBlock* ElseBB = MergeBB;
+    if (ast.elseBranch) {
+        ElseBB = llvm::BasicBlock::Create(*TheContext, "else", TheFunction, MergeBB);
+    }
+
+    if (!CreateCondBranch(*ast.condition, ThenBB, ElseBB)) {
+        return nullptr;
+    }
+
+    Builder->SetInsertPoint(ThenBB);
+    if (!ast.thenBranch->accept(*this)) {
+        return nullptr;
+    }
+    Builder->CreateBr(MergeBB);
+
+    if (ast.elseBranch) {
+        Builder->SetInsertPoint(ElseBB);
+        if (!ast.elseBranch->accept(*this)) {
+            return nullptr;
+        }
+        Builder->CreateBr(MergeBB);
+    }
+
+    Builder->SetInsertPoint(MergeBB);
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
+
+llvm::Value* CodegenVisitor::visit(WhileStmt& ast) {
+    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* CondBB = llvm::BasicBlock::Create(*TheContext, "whilecond", TheFunction);
+    llvm::BasicBlock* BodyBB = llvm::BasicBlock::Create(*TheContext, "whilebody", TheFunction);
+    llvm::BasicBlock* AfterBB = llvm::BasicBlock::Create(*TheContext, "afterwhile", TheFunction);
+
+    Builder->CreateBr(CondBB);
+    Builder->SetInsertPoint(CondBB);
+    if (!CreateCondBranch(*ast.condition, BodyBB, AfterBB)) {
+        return nullptr;
+    }
+
+    Builder->SetInsertPoint(BodyBB);
+    if (!ast.body->accept(*this)) {
+        return nullptr;
+    }
+    Builder->CreateBr(CondBB);
+
+    Builder->SetInsertPoint(AfterBB);
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
+
+llvm::Value* CodegenVisitor::visit(RepeatStmt& ast) {
+    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* BodyBB = llvm::BasicBlock::Create(*TheContext, "repeat", TheFunction);
+    llvm::BasicBlock* AfterBB = llvm::BasicBlock::Create(*TheContext, "afterrepeat", TheFunction);
+
+    Builder->CreateBr(BodyBB);
+    Builder->SetInsertPoint(BodyBB);
+    for (auto& s : ast.body) {
+        if (!s->accept(*this)) {
+            return nullptr;
+        }
+    }
+    if (!CreateCondBranch(*ast.condition, AfterBB, BodyBB)) {
+        return nullptr;
+    }
+
+    Builder->SetInsertPoint(AfterBB);
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
+
+llvm::Value* CodegenVisitor::visit(ForStmt& ast) {
+    if (ast.in) {
+        return CreateForIn(ast);
+    }
+    if (ast.parallel) {
+        return CreateParallelFor(ast);
+    }
+    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+
+    llvm::Type* T = nullptr;
+    llvm::Value* A = getVariablePtr(ast.name, T);
+    if (!A) {
+        A = CreateEntryBlockAlloca(TheFunction, ast.name);
+        NamedValues[ast.name] = llvm::cast<llvm::AllocaInst>(A);
+        T = llvm::Type::getDoubleTy(*TheContext);
+    }
+    llvm::Value* Start;
+    llvm::Value* End;
+    if (!getForBounds(ast, T, Start, End)) {
+        return nullptr;
+    }
+    Builder->CreateStore(Start, A);
+
+    // Bounds known at compile time skip an empty loop and bound the loop variable,
+    // unless the body may store to it.
+    auto* StartC = llvm::dyn_cast<llvm::ConstantFP>(Start);
+    auto* EndC = llvm::dyn_cast<llvm::ConstantFP>(End);
+    double first = StartC ? StartC->getValueAPF().convertToDouble() : 0;
+    double last = EndC ? EndC->getValueAPF().convertToDouble() : 0;
+    if (StartC && EndC && (ast.isdownto ? first < last : first > last)) {
+        return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+    }
+
+    llvm::BasicBlock* LoopBB = llvm::BasicBlock::Create(*TheContext, "loop", TheFunction);
+    llvm::BasicBlock* AfterBB = llvm::BasicBlock::Create(*TheContext, "afterloop", TheFunction);
+    std::map<std::string, std::pair<int, int>> outerRanges = InductionRanges;
+    if (StartC && EndC) {
+        Builder->CreateBr(LoopBB);
+    } else {
+        llvm::Value* Empty = ast.isdownto ? Builder->CreateFCmpOLT(Start, End, "empty") : Builder->CreateFCmpOGT(Start, End, "empty");
+        Builder->CreateCondBr(Empty, AfterBB, LoopBB);
+    }
+    int start, end;
+    if (StartC && EndC && !WrittenLoops.count(&ast) && getIntConstant(first, start) && getIntConstant(last, end)) {
+        InductionRanges[ast.name] = std::make_pair(std::min(start, end), std::max(start, end));
+    } else {
+        InductionRanges.erase(ast.name);
+    }
+    Builder->SetInsertPoint(LoopBB);
+
+    llvm::Value* BodyV = ast.body->accept(*this);
+
+    InductionRanges = outerRanges;
+    if (!BodyV) {
+        return nullptr;
+    }
+
+    llvm::Value* Cur = Builder->CreateLoad(T, A, ast.name.c_str());
+    llvm::Value* EndCond = Builder->CreateFCmpONE(Cur, End, "loopcond");
+    llvm::Value* Step = llvm::ConstantFP::get(T, ast.isdownto ? -1.0 : 1.0);
+    Builder->CreateStore(Builder->CreateFAdd(Cur, Step, "nextvar"), A);
+    Builder->CreateCondBr(EndCond, LoopBB, AfterBB);
+
+    Builder->SetInsertPoint(AfterBB);
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
+
+// Labels become switch cases so LLVM can pick a jump table, bit test or search
+// tree; ranges are expanded and rely on LLVM clustering consecutive cases.
+llvm::Value* CodegenVisitor::visit(CaseStmt& ast) {
+    llvm::Value* Sel = ast.expr->accept(*this);
+    if (!Sel) {
+        return nullptr;
+    }
+    Sel = toOrdinal(Sel);
+
+    llvm::Function* TheFunction = Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* AfterBB = llvm::BasicBlock::Create(*TheContext, "endcase", TheFunction);
+    llvm::BasicBlock* DefaultBB = AfterBB;
+    if (ast.elseBranch) {
+        DefaultBB = llvm::BasicBlock::Create(*TheContext, "caseelse", TheFunction);
+    }
+
+    llvm::SwitchInst* SI = Builder->CreateSwitch(Sel, DefaultBB, ast.cases.size());
+    std::set<int> seen;
+
+    for (auto& c : ast.cases) {
+        std::vector<std::pair<int, int>> labels;
+        if (auto* S = dynamic_cast<SetExpr*>(c.first.get())) {
+            for (auto& e : S->elements) {
+                int lo, hi;
+                if (!getOrdinalConstant(*e.first, lo) || (e.second && !getOrdinalConstant(*e.second, hi))) {
+                    return LogErrorV("Case Label Must be Constant");
+                }
+                labels.push_back(std::make_pair(lo, e.second ? hi : lo));
+            }
+        } else {
+            int v;
+            if (!getOrdinalConstant(*c.first, v)) {
+                return LogErrorV("Case Label Must be Constant");
+            }
+            labels.push_back(std::make_pair(v, v));
+        }
+
+        llvm::BasicBlock* CaseBB = llvm::BasicBlock::Create(*TheContext, "case", TheFunction, DefaultBB);
+        for (auto& l : labels) {
+            if (l.first > l.second) {
+                std::string m = "Empty Case Label Range " + std::to_string(l.first) + ".." + std::to_string(l.second);
+                return LogErrorV(m.c_str());
+            }
+            if (static_cast<long long>(l.second) - l.first > 65535) {
+                return LogErrorV("Case Label Range Too Large");
+            }
+            for (int v = l.first; v <= l.second; v++) {
+                if (!seen.insert(v).second) {
+                    std::string m = "Duplicate Case Label " + std::to_string(v);
+                    return LogErrorV(m.c_str());
+                }
+                SI->addCase(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*TheContext), v, true), CaseBB);
+            }
+        }
+
+        Builder->SetInsertPoint(CaseBB);
+        if (!c.second->accept(*this)) {
+            return nullptr;
+        }
+        Builder->CreateBr(AfterBB);
+    }
+
+    if (ast.elseBranch) {
+        Builder->SetInsertPoint(DefaultBB);
+        if (!ast.elseBranch->accept(*this)) {
+            return nullptr;
+        }
+        Builder->CreateBr(AfterBB);
+    }
+
+    Builder->SetInsertPoint(AfterBB);
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
+
+// readln and writeln call runtimeFile.cpp. A text variable as the first argument
+// picks the file; otherwise a null text stands for the console.
+llvm::Value* CodegenVisitor::visit(ReadStmt& ast) {
+    llvm::Value* F = llvm::ConstantPointerNull::get(llvm::PointerType::get(*TheContext, 0));
+    size_t first = 0;
+    if (!ast.variables.empty()) {
+        VarExpr File(ast.variables[0], TokenType::tok_identifier);
+        if (llvm::Value* P = getTextPtr(File)) {
+            F = P;
+            first = 1;
+        }
+    }
+
+    std::vector<std::pair<llvm::Value*, llvm::Type*>> targets;
+    for (size_t i = first; i < ast.variables.size(); i++) {
+        llvm::Type* T;
+        llvm::Value* P = getVariablePtr(ast.variables[i], T);
+        if (!P) {
+            std::string m = "Unknown variable name: " + ast.variables[i];
+            return LogErrorV(m.c_str());
+        }
+        if (getConstantGlobal(ast.variables[i])) {
+            std::string m = "Cannot Assign to Constant " + ast.variables[i];
+            return LogErrorV(m.c_str());
+        }
+        if (T != getStringType() && !T->isIntegerTy(8) && !T->isFloatingPointTy()) {
+            std::string m = "Cannot Read Variable " + ast.variables[i];
+            return LogErrorV(m.c_str());
+        }
+        targets.push_back(std::make_pair(P, T));
+    }
+
+    // Only the runtime calls for the line run under the I/O lock.
+    CreateRuntimeCall("__pascal_file_lock", llvm::Type::getVoidTy(*TheContext), {});
+    for (auto& [P, T] : targets) {
+        if (T == getStringType()) {
+            CreateRuntimeCall("__pascal_file_read_str", llvm::Type::getVoidTy(*TheContext), { F, P });
+        } else if (T->isIntegerTy(8)) {
+            Builder->CreateStore(CreateRuntimeCall("__pascal_file_read_char", T, { F }), P);
+        } else {
+            llvm::Value* V = CreateRuntimeCall("__pascal_file_read_real", llvm::Type::getDoubleTy(*TheContext), { F });
+            Builder->CreateStore(convertValue(V, T), P);
+        }
+    }
+    CreateRuntimeCall("__pascal_file_readln", llvm::Type::getVoidTy(*TheContext), { F });
+    CreateRuntimeCall("__pascal_file_unlock", llvm::Type::getVoidTy(*TheContext), {});
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
+
+llvm::Value* CodegenVisitor::visit(WriteStmt& ast) {
+    llvm::Type* Void = llvm::Type::getVoidTy(*TheContext);
+    llvm::Value* F = llvm::ConstantPointerNull::get(llvm::PointerType::get(*TheContext, 0));
+    size_t first = 0;
+    if (!ast.exprs.empty()) {
+        if (llvm::Value* P = getTextPtr(*ast.exprs[0])) {
+            F = P;
+            first = 1;
+        }
+    }
+
+    // Arguments are evaluated first: one may block, e.g. on a channel, and must
+    // not hold the I/O lock while it does.
+    std::vector<std::pair<llvm::Value*, std::string>> values;
+    for (size_t i = first; i < ast.exprs.size(); i++) {
+        Expr& e = *ast.exprs[i];
+        llvm::Value* V = e.accept(*this);
+        if (!V) {
+            return nullptr;
+        }
+        if (isStringExpr(e)) {
+            values.push_back(std::make_pair(toStringValue(V), "str"));
+        } else if (V->getType()->isIntegerTy(8)) {
+            values.push_back(std::make_pair(V, "char"));
+        } else if (V->getType()->isIntegerTy(1)) {
+            values.push_back(std::make_pair(V, "bool"));
+        } else if (V->getType()->isFloatTy()) {
+            values.push_back(std::make_pair(V, "single"));
+        } else if (V->getType()->isDoubleTy()) {
+            values.push_back(std::make_pair(V, "real"));
+        } else {
+            return LogErrorV("Cannot Write Value");
+        }
+    }
+
+    CreateRuntimeCall("__pascal_file_lock", Void, {});
+    for (auto& [V, kind] : values) {
+        CreateRuntimeCall("__pascal_file_write_" + kind, Void, { F, V });
+    }
+    CreateRuntimeCall("__pascal_file_writeln", Void, { F });
+    CreateRuntimeCall("__pascal_file_unlock", Void, {});
+    for (auto& [V, kind] : values) {
+        if (kind == "str") {
+            releaseStringTemp(V);
+        }
+    }
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
+
+llvm::Value* CodegenVisitor::visit(YieldStmt& ast) {
+    if (!CoroPromise) {
+        return LogErrorV("yield Outside an Iterator Function");
+    }
+    llvm::Value* V = ast.value->accept(*this);
+    if (!V) {
+        return nullptr;
+    }
+    Builder->CreateStore(convertValue(V, llvm::Type::getDoubleTy(*TheContext)), CoroPromise);
+    CreateCoroSuspend(false);
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
+
+// spawn p(args) packs the arguments into a block that __pascal_spawn copies and
+// hands to p.spawn on another thread, which unpacks them and makes the call.
+// Only values cross threads: scalars, and channels, whose handle is copied and
+// holds a reference until the call returns.
+llvm::Value* CodegenVisitor::visit(SpawnStmt& ast) {
+    CallStmt& call = *ast.call;
+    llvm::Function* Callee = TheModule->getFunction(call.callee);
+    if (!Callee || !Callee->getReturnType()->isVoidTy()) {
+        return LogErrorV("spawn Needs a Procedure");
+    }
+    if (Callee->arg_size() != call.args.size()) {
+        return LogErrorV("Incorrect Number of Arguments");
+    }
+
+    std::vector<llvm::Type*> Fields;
+    std::vector<bool> channels;
+    for (unsigned i = 0; i != call.args.size(); i++) {
+        llvm::Type* ParamT = Callee->getFunctionType()->getParamType(i);
+        bool channel = getChannelPtr(*call.args[i]) != nullptr;
+        if (channel != ByReference[call.callee][i] || ParamT == getOpenArrayType()) {
+            return LogErrorV("Spawned Procedures Take Only Scalars and Channels");
+        }
+        Fields.push_back(channel ? getChannelType() : ParamT);
+        channels.push_back(channel);
+    }
+    llvm::StructType* ArgsT = llvm::StructType::get(*TheContext, Fields);
+
+    llvm::Function* Thunk = TheModule->getFunction(call.callee + ".spawn");
+    if (!Thunk) {
+        llvm::FunctionType* FT = llvm::FunctionType::get(llvm::Type::getVoidTy(*TheContext), { llvm::PointerType::get(*TheContext, 0) }, false);
+        Thunk = llvm::Function::Create(FT, llvm::Function::InternalLinkage, call.callee + ".spawn", TheModule.get());
+        Thunk->setDoesNotThrow();
+        llvm::IRBuilderBase::InsertPoint SavedIP = Builder->saveIP();
+        Builder->SetInsertPoint(llvm::BasicBlock::Create(*TheContext, "entry", Thunk));
+        std::vector<llvm::Value*> Args;
+        for (unsigned i = 0; i != Fields.size(); i++) {
+            llvm::Value* P = Builder->CreateStructGEP(ArgsT, Thunk->getArg(0), i);
+            Args.push_back(channels[i] ? P : Builder->CreateLoad(Fields[i], P));
+        }
+        Builder->CreateCall(Callee, Args);
+        for (unsigned i = 0; i != Fields.size(); i++) {
+            if (channels[i]) {
+                CreateRuntimeCall("__pascal_chan_free", llvm::Type::getVoidTy(*TheContext), { Args[i] });
+            }
+        }
+        Builder->CreateRetVoid();
+        Builder->restoreIP(SavedIP);
+    }
+
+    llvm::AllocaInst* Block = CreateEntryBlockAlloca(Builder->GetInsertBlock()->getParent(), "spawn.args", ArgsT);
+    for (unsigned i = 0; i != Fields.size(); i++) {
+        llvm::Value* V;
+        if (channels[i]) {
+            llvm::Value* C = getChannelPtr(*call.args[i]);
+            CreateRuntimeCall("__pascal_chan_retain", llvm::Type::getVoidTy(*TheContext), { C });
+            V = Builder->CreateLoad(getChannelType(), C);
+        } else {
+            V = call.args[i]->accept(*this);
+            if (!V) {
+                return nullptr;
+            }
+            if (Fields[i]->isFloatingPointTy()) {
+                V = convertValue(V, Fields[i]);
+            }
+        }
+        Builder->CreateStore(V, Builder->CreateStructGEP(ArgsT, Block, i));
+    }
+    const llvm::DataLayout& DL = TheModule->getDataLayout();
+    CreateRuntimeCall("__pascal_spawn", llvm::Type::getVoidTy(*TheContext), { Thunk, Block, Builder->getInt64(DL.getTypeAllocSize(ArgsT).getFixedValue()) });
+    Spawned = true;
+    return llvm::Constant::getNullValue(llvm::Type::getDoubleTy(*TheContext));
+}
@@ -13,26 +13,48 @@
 struct Decl : public Ast {
     std::string name;
     virtual ~Decl() = default;
+    virtual llvm::Value* accept(AstVisitor& visitor) = 0;
 
     Decl(const std::string &name) : name(name) {};
 };
 
+// Value of a typed constant: a literal, or a parenthesized list of elements
+// or of named record fields.
+struct ConstInit {
+    std::unique_ptr<Expr> value;
+    std::string field;
+    std::vector<std::unique_ptr<ConstInit>> items;
+};
+
 struct ConstDecl : public Decl {
     std::unique_ptr<Expr> value;
 
     ConstDecl(const std::string &name, std::unique_ptr<Expr> value) : Decl(name), value(std::move(value)) {};
     ConstDecl(ConstDecl&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
+    llvm::Value* accept(AstVisitor& visitor) override {
         visitor.visit(*this);
+        return nullptr;
     };
 };
 
 struct TypeDecl : public Decl {
     TokenType type;
+    std::string identifier;
 
-    TypeDecl(const std::string &name, TokenType type) : Decl(name), type(type) {};
-    llvm::Value* accept(AstVisitor& visitor) {
+    TypeDecl(const std::string &name, TokenType type, const std::string &identifier = "") : Decl(name), type(type), identifier(identifier) {};
+    llvm::Value* accept(AstVisitor& visitor) override {
         visitor.visit(*this);
+        return nullptr;
+    };
+};
+
+struct PointerType : public Decl {
+    std::string pointee;
+
+    PointerType(const std::string &name, const std::string &pointee) : Decl(name), pointee(pointee) {};
+    llvm::Value* accept(AstVisitor& visitor) override {
+        visitor.visit(*this);
+        return nullptr;
     };
 };
 
@@ -43,18 +65,21 @@ struct RangeType : public Decl {
 
     RangeType(const std::string &name, TokenType type, std::unique_ptr<Expr> min, std::unique_ptr<Expr> max) : Decl(name), type(type), min(std::move(min)), max(std::move(max)) {};
     RangeType(RangeType&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
+    llvm::Value* accept(AstVisitor& visitor) override {
         visitor.visit(*this);
+        return nullptr;
     };
 };
 
 struct RecordType : public Decl {
     std::vector<std::unique_ptr<TypeDecl>> values;
+    bool packed;
 
-    RecordType(const std::string &name, std::vector<std::unique_ptr<TypeDecl>> values) : Decl(name), values(std::move(values)) {};
+    RecordType(const std::string &name, std::vector<std::unique_ptr<TypeDecl>> values, bool packed = false) : Decl(name), values(std::move(values)), packed(packed) {};
     RecordType(RecordType&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
+    llvm::Value* accept(AstVisitor& visitor) override {
         visitor.visit(*this);
+        return nullptr;
     };
 };
 
@@ -63,11 +88,14 @@ struct ArrayType : public Decl {
     int min;
     int max;
     std::string identifier;
+    std::vector<std::pair<int, int>> dims;
+    bool packed = false;
 
     ArrayType(const std::string &name, TokenType type, int min, int max, const std::string &identifier = "") : Decl(name), type(type), min(min), max(max), identifier(identifier) {};
     ArrayType(ArrayType&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
+    llvm::Value* accept(AstVisitor& visitor) override {
         visitor.visit(*this);
+        return nullptr;
     };
 };
 
@@ -76,19 +104,23 @@ struct EnumType : public Decl {
 
     EnumType(const std::string &name, std::vector<std::pair<std::unique_ptr<Expr>, int>> values) : Decl(name), values(std::move(values)) {};
     EnumType(EnumType&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
+    llvm::Value* accept(AstVisitor& visitor) override {
         visitor.visit(*this);
+        return nullptr;
     };
 };
 
 struct VarDecl : public Decl {
     TokenType type;
     std::string identifier;
+    std::unique_ptr<ConstInit> init;
+    int capacity = 0;
 
     VarDecl(const std::string &name, TokenType type, const std::string &identifier = "") : Decl(name), type(type), identifier(identifier) {};
     VarDecl(VarDecl&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
+    llvm::Value* accept(AstVisitor& visitor) override {
         visitor.visit(*this);
+        return nullptr;
     };
 };
 
@@ -106,8 +138,9 @@ struct RecordVar : public Decl {
         }
     };
     RecordVar(RecordVar&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
+    llvm::Value* accept(AstVisitor& visitor) override {
         visitor.visit(*this);
+        return nullptr;
     };
 };
 
@@ -117,6 +150,10 @@ struct ArrayVar : public Decl {
     int max;
     std::vector<std::unique_ptr<Decl>> values;
     std::string identifier;
+    std::vector<std::pair<int, int>> dims;
+    bool soa = false;
+    bool packed = false;
+    std::unique_ptr<ConstInit> init;
 
     ArrayVar(const std::string &name, TokenType type, int min, int max, const std::string &identifier = "") : Decl(name), type(type), min(min), max(max), identifier(identifier) {
         for (int i = min; i <= max; i++) {
@@ -124,41 +161,94 @@ struct ArrayVar : public Decl {
         }
     };
     ArrayVar(ArrayVar&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
+    llvm::Value* accept(AstVisitor& visitor) override {
+        visitor.visit(*this);
+        return nullptr;
+    };
+};
+
+struct SetType : public Decl {
+    TokenType type;
+    int min;
+    int max;
+    std::string identifier;
+
+    SetType(const std::string &name, TokenType type, int min, int max, const std::string &identifier = "") : Decl(name), type(type), min(min), max(max), identifier(identifier) {};
+    SetType(SetType&&) noexcept = default;
+    llvm::Value* accept(AstVisitor& visitor) override {
         visitor.visit(*this);
+        return nullptr;
+    };
+};
+
+struct SetVar : public Decl {
+    TokenType type;
+    int min;
+    int max;
+    std::string identifier;
+
+    SetVar(const std::string &name, TokenType type, int min, int max, const std::string &identifier = "") : Decl(name), type(type), min(min), max(max), identifier(identifier) {};
+    SetVar(SetVar&&) noexcept = default;
+    llvm::Value* accept(AstVisitor& visitor) override {
+        visitor.visit(*this);
+        return nullptr;
+    };
+};
+
+enum ParamMode {
+    param_value,
+    param_var,
+    param_const,
+};
+
+struct ParamDecl : public Decl {
+    TokenType type;
+    ParamMode mode;
+    std::string identifier;
+
+    ParamDecl(const std::string &name, TokenType type, ParamMode mode, const std::string &identifier = "") : Decl(name), type(type), mode(mode), identifier(identifier) {};
+    ParamDecl(ParamDecl&&) noexcept = default;
+    llvm::Value* accept(AstVisitor& visitor) override {
+        visitor.visit(*this);
+        return nullptr;
     };
 };
 
 struct Prototype : public Ast {
     std::string name;
-    std::vector<std::unique_ptr<Decl>> args;
+    std::vector<std::unique_ptr<ParamDecl>> args;
+    bool procedure;
+    bool iterator = false;
+    bool string = false;
 
-    Prototype(const std::string &name, std::vector<std::unique_ptr<Decl>> args) : name(name), args(std::move(args)) {};
+    Prototype(const std::string &name, std::vector<std::unique_ptr<ParamDecl>> args, bool procedure = false) : name(name), args(std::move(args)), procedure(procedure) {};
     llvm::Function* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+        return visitor.visit(*this);
     };
 };
 
 struct FuncDecl : public Decl {
     std::unique_ptr<Prototype> proto;
     TokenType type;
+    std::vector<std::unique_ptr<Decl>> locals;
     std::unique_ptr<CompoundStmt> body;
 
-    FuncDecl(std::unique_ptr<Prototype> proto, TokenType type, std::vector<std::unique_ptr<Stmt>> body) : Decl(proto->name), proto(std::move(proto)), type(type), body(std::make_unique<CompoundStmt>(std::move(body))) {};
+    FuncDecl(std::unique_ptr<Prototype> proto, TokenType type, std::vector<std::unique_ptr<Decl>> locals, std::vector<std::unique_ptr<Stmt>> body) : Decl(proto->name), proto(std::move(proto)), type(type), locals(std::move(locals)), body(std::make_unique<CompoundStmt>(std::move(body))) {};
     FuncDecl(FuncDecl&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
 struct ProcDecl : public Decl {
     std::unique_ptr<Prototype> proto;
+    std::vector<std::unique_ptr<Decl>> locals;
     std::unique_ptr<CompoundStmt> body;
 
-    ProcDecl(std::unique_ptr<Prototype> proto, std::vector<std::unique_ptr<Stmt>> body) : Decl(proto->name), proto(std::move(proto)), body(std::make_unique<CompoundStmt>(std::move(body))) {};
+    ProcDecl(std::unique_ptr<Prototype> proto, std::vector<std::unique_ptr<Decl>> locals, std::vector<std::unique_ptr<Stmt>> body) : Decl(proto->name), proto(std::move(proto)), locals(std::move(locals)), body(std::make_unique<CompoundStmt>(std::move(body))) {};
     ProcDecl(ProcDecl&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -171,6 +261,7 @@ struct Program : public Ast {
     Program(Program&) noexcept = default;
     llvm::Value* accept(AstVisitor& visitor) {
         visitor.visit(*this);
+        return nullptr;
     };
 };
 
@@ -53,6 +53,12 @@ struct BoolExpr : public Expr {
     };
 };
 
+struct NilExpr : public Expr {
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
+    };
+};
+
 struct VarExpr : public Expr {
     std::string name;
     TokenType t;
@@ -99,8 +105,9 @@ struct CallExpr : public Expr {
 struct ArrayExpr : public Expr {
     std::unique_ptr<VarExpr> arr;
     std::unique_ptr<Expr> index;
+    std::vector<std::unique_ptr<Expr>> subscripts;
 
-    ArrayExpr(std::unique_ptr<VarExpr> arr, std::unique_ptr<Expr> index) : arr(std::move(arr)), index(std::move(index)) {};
+    ArrayExpr(std::unique_ptr<VarExpr> arr, std::unique_ptr<Expr> index, std::vector<std::unique_ptr<Expr>> subscripts = {}) : arr(std::move(arr)), index(std::move(index)), subscripts(std::move(subscripts)) {};
     ArrayExpr(ArrayExpr&&) noexcept = default;
     llvm::Value* accept(AstVisitor& visitor) override {
         return visitor.visit(*this);
@@ -110,12 +117,24 @@ struct ArrayExpr : public Expr {
 struct RecordExpr : public Expr {
     std::unique_ptr<VarExpr> record;
     std::string field;
+    std::unique_ptr<Expr> index;
+    bool deref;
 
-    RecordExpr(std::unique_ptr<VarExpr> record, const std::string &field) : record(std::move(record)), field(field) {};
+    RecordExpr(std::unique_ptr<VarExpr> record, const std::string &field, std::unique_ptr<Expr> index = nullptr, bool deref = false) : record(std::move(record)), field(field), index(std::move(index)), deref(deref) {};
     RecordExpr(RecordExpr&&) noexcept = default;
     llvm::Value* accept(AstVisitor& visitor) override {
         return visitor.visit(*this);
     };
 };
 
+struct SetExpr : public Expr {
+    std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Expr>>> elements;
+
+    SetExpr(std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Expr>>> elements) : elements(std::move(elements)) {};
+    SetExpr(SetExpr&&) noexcept = default;
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
+    };
+};
+
 #endif
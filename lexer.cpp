@@ -18,7 +18,7 @@ void Lexer::skipWhitespace() {
 
 std::unique_ptr<Token> Lexer::number() {
     std::string value;
-    while (isdigit(peek()) || peek() == '.') {
+    while (isdigit(peek()) || (peek() == '.' && position + 1 < input.length() && isdigit(input[position + 1]))) {
         value += next();
     }
     return std::make_unique<Token>(TokenType::tok_number, value);
@@ -56,16 +56,26 @@ std::unique_ptr<Token> Lexer::identifier() {
     if (value == "type") return std::make_unique<Token>(TokenType::tok_type, value);
     if (value == "array") return std::make_unique<Token>(TokenType::tok_array, value);
     if (value == "record") return std::make_unique<Token>(TokenType::tok_record, value);
+    if (value == "nil") return std::make_unique<Token>(TokenType::tok_nil, value);
+    if (value == "packed") return std::make_unique<Token>(TokenType::tok_packed, value);
     if (value == "set") return std::make_unique<Token>(TokenType::tok_set, value);
     if (value == "writeln") return std::make_unique<Token>(TokenType::tok_write, value);
     if (value == "readln") return std::make_unique<Token>(TokenType::tok_read, value);
     if (value == "and") return std::make_unique<Token>(TokenType::tok_and, value);
     if (value == "or") return std::make_unique<Token>(TokenType::tok_or, value);
+    if (value == "in") return std::make_unique<Token>(TokenType::tok_in, value);
     if (value == "not") return std::make_unique<Token>(TokenType::tok_not, value);
     if (value == "mod") return std::make_unique<Token>(TokenType::tok_mod, value);
     if (value == "div") return std::make_unique<Token>(TokenType::tok_div, value);
-    if (value == "integeter") return std::make_unique<Token>(TokenType::tok_integer, value);
+    if (value == "integer") return std::make_unique<Token>(TokenType::tok_integer, value);
     if (value == "real") return std::make_unique<Token>(TokenType::tok_real, value);
+    if (value == "single") return std::make_unique<Token>(TokenType::tok_single, value);
+    if (value == "map") return std::make_unique<Token>(TokenType::tok_map, value);
+    if (value == "iterator") return std::make_unique<Token>(TokenType::tok_iterator, value);
+    if (value == "yield") return std::make_unique<Token>(TokenType::tok_yield, value);
+    if (value == "text") return std::make_unique<Token>(TokenType::tok_text, value);
+    if (value == "channel") return std::make_unique<Token>(TokenType::tok_channel, value);
+    if (value == "spawn") return std::make_unique<Token>(TokenType::tok_spawn, value);
     if (value == "char") return std::make_unique<Token>(TokenType::tok_char, value);
     if (value == "boolean") return std::make_unique<Token>(TokenType::tok_boolean, value);
     if (value == "string") return std::make_unique<Token>(TokenType::tok_string, value);
@@ -163,6 +173,23 @@ std::unique_ptr<Token> Lexer::special() {
         case '^':
             next();
             return std::make_unique<Token>(TokenType::tok_pointer, "^");
+        case '{':
+            next();
+            if (peek() == '$') {
+                next();
+                std::string value;
+                while (peek() != '}' && peek() != '\0') {
+                    value += tolower(next());
+                }
+                next();
+                return std::make_unique<Token>(TokenType::tok_directive, value);
+            }
+            while (peek() != '}' && peek() != '\0') {
+                next();
+            }
+            next();
+            skipWhitespace();
+            return nextToken();
     }
 
     return std::make_unique<Token>(TokenType::tok_identifier, std::string(1, next()));
@@ -177,6 +204,9 @@ std::unique_ptr<Token> Lexer::stringLiteral() {
 
     if (peek() == '"' || peek() == '\'') {
         next();
+        if (value.length() == 1) {
+            return std::make_unique<Token>(TokenType::tok_char_literal, value);
+        }
         return std::make_unique<Token>(TokenType::tok_string_literal, value);
     }
 
@@ -6,6 +6,7 @@
 #include <vector>
 #include <cctype>
 #include <algorithm>
+#include <memory>
 
 class Lexer {
 private:
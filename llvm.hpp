@@ -4,6 +4,7 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Value.h>
 #include <llvm/Support/raw_ostream.h> 
 #include <map>
@@ -14,10 +15,51 @@ extern std::unique_ptr<llvm::LLVMContext> TheContext;
 extern std::unique_ptr<llvm::IRBuilder<>> Builder;
 extern std::unique_ptr<llvm::Module> TheModule;
 extern std::map<std::string, llvm::AllocaInst *> NamedValues;
+extern std::map<std::string, llvm::GlobalVariable*> GlobalValues;
+extern std::map<std::string, llvm::Type*> ReferenceTypes;
 extern std::map<std::string, std::string> VariableTypeMap;
 extern std::map<std::string, std::unique_ptr<Prototype>> FunctionProtos;
-struct RecordInfo;
+// A subrange field of a packed record: value - min in width bits at offset
+// within the integer field it shares with its neighbours.
+struct BitField {
+    unsigned offset;
+    unsigned width;
+    int min;
+};
+
+struct RecordInfo {
+    llvm::StructType* llvmType;
+    std::map<std::string, int> fieldIndices;
+    std::vector<std::string> fieldTypes;
+    bool packed = false;
+    std::map<std::string, BitField> bitFields;
+};
 extern std::map<std::string, RecordInfo> RecordTypes;
 
+struct ArrayInfo {
+    llvm::Type* llvmType;
+    int min;
+    int max;
+    std::string elementType;
+    bool soa = false;
+    bool dynamic = false;
+    std::vector<std::pair<int, int>> dims;
+    bool bits = false;
+};
+extern std::map<std::string, ArrayInfo> ArrayTypes;
+extern std::map<std::string, ArrayInfo> ArrayVars;
+extern std::map<std::string, int> SetTypes;
+extern std::map<std::string, std::string> PointerTypes;
+extern std::map<std::string, std::pair<int, int>> RangeTypes;
+extern std::map<std::string, std::string> MapVars;
+extern std::map<std::string, int> SetVars;
+extern std::map<std::string, std::string> BaseTypes;
+
+extern bool RangeChecks;
+extern bool ReportStats;
+extern bool ShortCircuit;
+extern bool HeapStats;
+extern int Errors;
+
 
 #endif
\ No newline at end of file
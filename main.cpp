@@ -13,42 +13,177 @@
 #include <memory>
 
 #include "llvm.hpp"
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/TargetParser/Host.h>
 
 std::unique_ptr<llvm::LLVMContext> TheContext = std::make_unique<llvm::LLVMContext>();
 std::unique_ptr<llvm::IRBuilder<>> Builder = std::make_unique<llvm::IRBuilder<>>(*TheContext);
 std::unique_ptr<llvm::Module> TheModule = std::make_unique<llvm::Module>("main", *TheContext);
 std::map<std::string, llvm::AllocaInst*> NamedValues;
+std::map<std::string, llvm::GlobalVariable*> GlobalValues;
+std::map<std::string, llvm::Type*> ReferenceTypes;
 std::map<std::string, std::string> VariableTypeMap;
 std::map<std::string, std::unique_ptr<Prototype>> FunctionProtos;
 
-struct RecordInfo {
-    llvm::StructType* llvmType;
-    std::map<std::string, int> fieldIndices;
-};
-
 std::map<std::string, RecordInfo> RecordTypes;
+std::map<std::string, ArrayInfo> ArrayTypes;
+std::map<std::string, ArrayInfo> ArrayVars;
+std::map<std::string, int> SetTypes;
+std::map<std::string, std::string> PointerTypes;
+std::map<std::string, std::pair<int, int>> RangeTypes;
+std::map<std::string, std::string> MapVars;
+std::map<std::string, int> SetVars;
+std::map<std::string, std::string> BaseTypes;
+
+bool RangeChecks = false;
+bool ReportStats = false;
+bool ShortCircuit = false;
+bool HeapStats = false;
+int Errors = 0;
+
+// The standard pipeline at the given level, tuned for the host.
+static void optimize(llvm::TargetMachine* TM, llvm::OptimizationLevel level) {
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+    llvm::PassBuilder PB(TM);
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+    if (level == llvm::OptimizationLevel::O0) {
+        PB.buildO0DefaultPipeline(level).run(*TheModule, MAM);
+    } else {
+        PB.buildPerModuleDefaultPipeline(level).run(*TheModule, MAM);
+    }
+}
+
+static bool emitObject(llvm::TargetMachine* TM, const std::string& output) {
+    std::error_code EC;
+    llvm::raw_fd_ostream dest(output, EC, llvm::sys::fs::OF_None);
+    if (EC) {
+        std::cerr << "Could not open " << output << ": " << EC.message() << std::endl;
+        return false;
+    }
+    llvm::legacy::PassManager pass;
+    if (TM->addPassesToEmitFile(pass, dest, nullptr, llvm::CodeGenFileType::ObjectFile)) {
+        std::cerr << "Cannot emit an object file for this target" << std::endl;
+        return false;
+    }
+    pass.run(*TheModule);
+    dest.flush();
+    return true;
+}
 
 int main(int argc, char* argv[]) {
-    std::ifstream file(argv[1]);
+    std::string filename;
+    std::string output;
+    bool emitLLVM = false;
+    llvm::OptimizationLevel level = llvm::OptimizationLevel::O2;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--range-checks") {
+            RangeChecks = true;
+        } else if (arg == "--stats") {
+            ReportStats = true;
+        } else if (arg == "--short-circuit") {
+            ShortCircuit = true;
+        } else if (arg == "--heap-stats") {
+            HeapStats = true;
+        } else if (arg == "--fast-math") {
+            // Lets LLVM reassociate and contract real arithmetic and assume no NaN or infinity.
+            llvm::FastMathFlags FMF;
+            FMF.setAllowReassoc();
+            FMF.setAllowContract(true);
+            FMF.setNoNaNs();
+            FMF.setNoInfs();
+            Builder->setFastMathFlags(FMF);
+        } else if (arg == "--emit-llvm") {
+            emitLLVM = true;
+        } else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "-O0") {
+            level = llvm::OptimizationLevel::O0;
+        } else if (arg == "-O1") {
+            level = llvm::OptimizationLevel::O1;
+        } else if (arg == "-O2") {
+            level = llvm::OptimizationLevel::O2;
+        } else if (arg == "-O3") {
+            level = llvm::OptimizationLevel::O3;
+        } else {
+            filename = arg;
+        }
+    }
+    if (output.empty()) {
+        output = filename.substr(0, filename.rfind('.')) + (emitLLVM ? ".ll" : ".o");
+    }
+
+    // Layouts decide record padding and TBAA offsets, so the target comes first.
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    std::string triple = llvm::sys::getDefaultTargetTriple();
+    std::string error;
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (!target) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    llvm::TargetMachine* TM = target->createTargetMachine(triple, llvm::sys::getHostCPUName(), "", llvm::TargetOptions(), llvm::Reloc::PIC_);
+    TheModule->setTargetTriple(triple);
+    TheModule->setDataLayout(TM->createDataLayout());
+
+    std::ifstream file(filename);
     std::stringstream buffer;
     buffer << file.rdbuf();
 
+    if (!file) {
+        std::cerr << "Cannot open " << filename << std::endl;
+        return 1;
+    }
     std::unique_ptr<Lexer> l = std::make_unique<Lexer>(buffer.str());
-    //CodegenVisitor c = CodegenVisitor();
+    CodegenVisitor c = CodegenVisitor();
 
     Parser *p = new Parser(std::move(l));
     try {
         std::unique_ptr<Program> program = p->parse();
-        //program->accept(c);
+        program->accept(c);
     } catch (std::runtime_error* &e) {
         std::cout << e->what() << std::endl;
+        Errors++;
     } catch (std::invalid_argument &e) {
         std::cout << e.what() << std::endl;
+        Errors++;
     }
 
     delete (p);
     file.close();
 
-    return 0;
+    if (Errors) {
+        return 1;
+    }
+    if (llvm::verifyModule(*TheModule, &llvm::errs())) {
+        std::cerr << "Generated code is invalid" << std::endl;
+        return 1;
+    }
+    optimize(TM, level);
+    if (emitLLVM) {
+        std::error_code EC;
+        llvm::raw_fd_ostream dest(output, EC, llvm::sys::fs::OF_None);
+        if (EC) {
+            std::cerr << "Could not open " << output << ": " << EC.message() << std::endl;
+            return 1;
+        }
+        TheModule->print(dest, nullptr);
+        return 0;
+    }
+    return emitObject(TM, output) ? 0 : 1;
 
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+program MapBench;
+
+// Compares the built-in map with a hand-rolled linear-probe table over the same
+// mix of inserts and lookups. Reads 1 for the map or 2 for the table:
+//   echo 1 | time ./mapbench
+//   echo 2 | time ./mapbench
+
+var
+  m: map of integer to real;
+  keys: array[0..65535] of integer;
+  vals: array[0..65535] of real;
+  used: array[0..65535] of boolean;
+  mode, seed, i, k, h: integer;
+  sum: real;
+
+// Linear probing from a multiplicative hash; the table never fills up because
+// keys stay below 40000.
+function slot(key: integer): integer;
+var
+  p: integer;
+begin
+  p := (key * 31) mod 65536;
+  while used[p] and (keys[p] <> key) do
+  begin
+    p := (p + 1) mod 65536;
+  end;
+  slot := p;
+end;
+
+begin
+  readln(mode);
+  seed := 1;
+  sum := 0;
+  for i := 1 to 2000000 do
+  begin
+    seed := ((seed * 75) + 74) mod 65537;
+    k := seed mod 40000;
+    if mode == 1 then
+    begin
+      if (i mod 4) == 0 then
+      begin
+        m[k] := m[k] + i;
+      end
+      else
+      begin
+        sum := sum + m[k];
+      end;
+    end
+    else
+    begin
+      h := slot(k);
+      if (i mod 4) == 0 then
+      begin
+        if used[h] then
+        begin
+          vals[h] := vals[h] + i;
+        end
+        else
+        begin
+          used[h] := true;
+          keys[h] := k;
+          vals[h] := i;
+        end;
+      end
+      else
+      begin
+        if used[h] then
+        begin
+          sum := sum + vals[h];
+        end;
+      end;
+    end;
+  end;
+  writeln(sum);
+end.
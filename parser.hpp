@@ -11,6 +11,7 @@
 #include <vector>
 #include <memory>
 #include <stdexcept>
+#include <sstream>
 
 class Parser {
 private:
@@ -20,14 +21,20 @@ private:
     void next();
     bool match(TokenType t);
     void expect(TokenType t);
+    bool matchBinaryOp();
 public:
     explicit Parser(std::unique_ptr<Lexer> lexer);
     std::unique_ptr<Program> parse();
     std::unique_ptr<Program> parseProgram();
 
     std::vector<std::unique_ptr<Decl>> parseConstDecl();
+    std::unique_ptr<ConstInit> parseConstInit();
     std::vector<std::unique_ptr<Decl>> parseTypeDecl();
     std::vector<std::unique_ptr<Decl>> parseVarDecl();
+    TokenType parseSetBase(int &min, int &max, std::string &identifier);
+    void parseBounds(int &min, int &max, std::vector<std::pair<int, int>> &dims);
+    std::vector<std::unique_ptr<Expr>> parseSubscripts();
+    std::vector<std::unique_ptr<ParamDecl>> parseParams();
     std::unique_ptr<Decl> parseFuncDecl();
     std::unique_ptr<Decl> parseProcDecl();
 
@@ -46,9 +53,13 @@ public:
     std::unique_ptr<Stmt> parseWhileStmt(); 
     std::unique_ptr<Stmt> parseRepeatStmt();
     std::unique_ptr<Stmt> parseForStmt();
+    std::unique_ptr<Stmt> parseParallelFor();
     std::unique_ptr<Stmt> parseCaseStmt();
+    std::unique_ptr<Expr> parseCaseLabel();
     std::unique_ptr<Stmt> parseReadStmt();
     std::unique_ptr<Stmt> parseWriteStmt();
+    std::unique_ptr<Stmt> parseYieldStmt();
+    std::unique_ptr<Stmt> parseSpawnStmt();
 };
 
 #endif
\ No newline at end of file
@@ -17,6 +17,29 @@ void Parser::expect(TokenType t) {
     next();
 }
 
+bool Parser::matchBinaryOp() {
+    switch (curr->type) {
+        case TokenType::tok_plus:
+        case TokenType::tok_minus:
+        case TokenType::tok_multiply:
+        case TokenType::tok_divide:
+        case TokenType::tok_equals:
+        case TokenType::tok_not_equals:
+        case TokenType::tok_less_than:
+        case TokenType::tok_less_equal:
+        case TokenType::tok_greater_than:
+        case TokenType::tok_greater_equal:
+        case TokenType::tok_and:
+        case TokenType::tok_or:
+        case TokenType::tok_mod:
+        case TokenType::tok_div:
+        case TokenType::tok_in:
+            return true;
+        default:
+            return false;
+    }
+}
+
 Parser::Parser(std::unique_ptr<Lexer> lexer) : lexer(std::move(lexer)) {
     next();
 }
@@ -32,7 +55,7 @@ std::unique_ptr<Program> Parser::parseProgram() {
     expect(TokenType::tok_semicolon);
 
     std::vector<std::unique_ptr<Decl>> varDecls;
-    while (match(TokenType::tok_const) || match(TokenType::tok_type) || match(TokenType::tok_var) || match(TokenType::tok_function) || match(TokenType::tok_procedure)) {
+    while (match(TokenType::tok_const) || match(TokenType::tok_type) || match(TokenType::tok_var) || match(TokenType::tok_function) || match(TokenType::tok_procedure) || match(TokenType::tok_iterator)) {
         if (match(TokenType::tok_const)) {
             std::vector<std::unique_ptr<Decl>> consts = parseConstDecl();
             for (auto& ptr : consts) {
@@ -54,6 +77,12 @@ std::unique_ptr<Program> Parser::parseProgram() {
         } else if (match(TokenType::tok_function)) {
             std::unique_ptr<Decl> func = parseFuncDecl();
             varDecls.push_back(std::move(func));
+        } else if (match(TokenType::tok_iterator)) {
+            // iterator function f(...): T; produces its values with yield.
+            next();
+            std::unique_ptr<FuncDecl> func(static_cast<FuncDecl*>(parseFuncDecl().release()));
+            func->proto->iterator = true;
+            varDecls.push_back(std::move(func));
         } else if (match(TokenType::tok_procedure)) {
             std::unique_ptr<Decl> func = parseProcDecl();
             varDecls.push_back(std::move(func));
@@ -72,6 +101,30 @@ std::vector<std::unique_ptr<Decl>> Parser::parseConstDecl() {
     while (match(TokenType::tok_identifier)) {
         std::string n = curr->value;
         next();
+        if (match(TokenType::tok_colon)) {
+            next();
+            if (match(TokenType::tok_array)) {
+                next();
+                int min, max;
+                std::vector<std::pair<int, int>> dims;
+                parseBounds(min, max, dims);
+                expect(TokenType::tok_of);
+                std::unique_ptr<ArrayVar> a = std::make_unique<ArrayVar>(n, curr->type, min, max, curr->value);
+                next();
+                expect(TokenType::tok_assign);
+                a->dims = dims;
+                a->init = parseConstInit();
+                decls.push_back(std::move(a));
+            } else {
+                std::unique_ptr<VarDecl> c = std::make_unique<VarDecl>(n, curr->type, curr->value);
+                next();
+                expect(TokenType::tok_assign);
+                c->init = parseConstInit();
+                decls.push_back(std::move(c));
+            }
+            expect(TokenType::tok_semicolon);
+            continue;
+        }
         expect(TokenType::tok_assign);
         std::unique_ptr<Expr> v;
         if (curr->type == TokenType::tok_number) {
@@ -91,6 +144,46 @@ std::vector<std::unique_ptr<Decl>> Parser::parseConstDecl() {
     return decls;
 }
 
+// (1, 2, 3) for arrays, nested for each dimension; (x: 1; y: 2) for records.
+std::unique_ptr<ConstInit> Parser::parseConstInit() {
+    std::unique_ptr<ConstInit> init = std::make_unique<ConstInit>();
+    if (!match(TokenType::tok_open_paren)) {
+        bool negative = match(TokenType::tok_minus);
+        if (negative) {
+            next();
+        }
+        if (match(TokenType::tok_number)) {
+            double value = std::stod(curr->value);
+            init->value = std::make_unique<NumberExpr>(negative ? -value : value);
+        } else if (match(TokenType::tok_boolean_literal) && !negative) {
+            init->value = std::make_unique<BoolExpr>(curr->value == "true");
+        } else if (match(TokenType::tok_char_literal) && !negative) {
+            init->value = std::make_unique<CharExpr>((curr->value)[0]);
+        } else {
+            throw new std::runtime_error("Invalid constant value: " + curr->value);
+        }
+        next();
+        return init;
+    }
+
+    next();
+    while (!match(TokenType::tok_close_paren)) {
+        std::string field;
+        if (match(TokenType::tok_identifier)) {
+            field = curr->value;
+            next();
+            expect(TokenType::tok_colon);
+        }
+        init->items.push_back(parseConstInit());
+        init->items.back()->field = field;
+        if (match(TokenType::tok_comma) || match(TokenType::tok_semicolon)) {
+            next();
+        }
+    }
+    expect(TokenType::tok_close_paren);
+    return init;
+}
+
 std::vector<std::unique_ptr<Decl>> Parser::parseTypeDecl() {
     expect(TokenType::tok_type);
     std::vector<std::unique_ptr<Decl>> decls;
@@ -101,6 +194,11 @@ std::vector<std::unique_ptr<Decl>> Parser::parseTypeDecl() {
 
         if (match(TokenType::tok_assign)) {
             next();
+            bool packed = false;
+            if (match(TokenType::tok_packed)) {
+                packed = true;
+                next();
+            }
             if (match(TokenType::tok_record)) {
                 next();
                 std::vector<std::unique_ptr<TypeDecl>> v;
@@ -108,29 +206,48 @@ std::vector<std::unique_ptr<Decl>> Parser::parseTypeDecl() {
                     std::string n = curr->value;
                     expect(TokenType::tok_identifier);
                     expect(TokenType::tok_colon);
-                    std::unique_ptr<TypeDecl> t = std::make_unique<TypeDecl>(n, curr->type);
+                    std::unique_ptr<TypeDecl> t;
+                    if (match(TokenType::tok_pointer)) {
+                        next();
+                        t = std::make_unique<TypeDecl>(n, TokenType::tok_pointer, curr->value);
+                    } else if (match(TokenType::tok_identifier)) {
+                        t = std::make_unique<TypeDecl>(n, curr->type, curr->value);
+                    } else {
+                        t = std::make_unique<TypeDecl>(n, curr->type);
+                    }
                     next();
                     expect(TokenType::tok_semicolon);
                     v.push_back(std::move(t));
                 }
                 expect(TokenType::tok_end);
                 expect(TokenType::tok_semicolon);
-                decls.push_back(std::make_unique<RecordType>(n, std::move(v)));
+                decls.push_back(std::make_unique<RecordType>(n, std::move(v), packed));
             } else if (match(TokenType::tok_array)) {
                 next();
-                expect(TokenType::tok_open_bracket);
-                int min = std::stoi(curr->value);
-                next();
-                expect(TokenType::tok_range);
-                int max = std::stoi(curr->value);
-                next();
-                expect(TokenType::tok_close_bracket);
+                int min, max;
+                std::vector<std::pair<int, int>> dims;
+                parseBounds(min, max, dims);
                 expect(TokenType::tok_of);
+                std::unique_ptr<ArrayType> a;
                 if (match(TokenType::tok_identifier)) {
-                    decls.push_back(std::make_unique<ArrayType>(n, curr->type, min, max, curr->value));
+                    a = std::make_unique<ArrayType>(n, curr->type, min, max, curr->value);
                 } else {
-                    decls.push_back(std::make_unique<ArrayType>(n, curr->type, min, max));
+                    a = std::make_unique<ArrayType>(n, curr->type, min, max);
                 }
+                a->dims = dims;
+                a->packed = packed;
+                decls.push_back(std::move(a));
+                next();
+                expect(TokenType::tok_semicolon);
+            } else if (match(TokenType::tok_set)) {
+                int min, max;
+                std::string identifier;
+                TokenType type = parseSetBase(min, max, identifier);
+                expect(TokenType::tok_semicolon);
+                decls.push_back(std::make_unique<SetType>(n, type, min, max, identifier));
+            } else if (match(TokenType::tok_pointer)) {
+                next();
+                decls.push_back(std::make_unique<PointerType>(n, curr->value));
                 next();
                 expect(TokenType::tok_semicolon);
             } else if (match(TokenType::tok_number)) {
@@ -149,7 +266,7 @@ std::vector<std::unique_ptr<Decl>> Parser::parseTypeDecl() {
                 next();
                 expect(TokenType::tok_semicolon);
                 decls.push_back(std::make_unique<RangeType>(n, curr->type, std::move(min), std::move(max)));
-            } else if (match(TokenType::tok_integer) || match(TokenType::tok_real)) {
+            } else if (match(TokenType::tok_integer) || match(TokenType::tok_real) || match(TokenType::tok_single)) {
                 decls.push_back(std::make_unique<TypeDecl>(n, curr->type));
                 next();
                 expect(TokenType::tok_semicolon);
@@ -182,8 +299,15 @@ std::vector<std::unique_ptr<Decl>> Parser::parseTypeDecl() {
 std::vector<std::unique_ptr<Decl>> Parser::parseVarDecl() {
     expect(TokenType::tok_var);
     std::vector<std::unique_ptr<Decl>> decls;
+    bool soa = false;
 
-    while (match(TokenType::tok_identifier)) {
+    while (match(TokenType::tok_identifier) || match(TokenType::tok_directive)) {
+        // {$SOA} lays out the next array of records as one array per field.
+        if (match(TokenType::tok_directive)) {
+            soa = curr->value == "soa";
+            next();
+            continue;
+        }
         std::vector<std::string> n;
         while (match(TokenType::tok_identifier)) {
             n.push_back(curr->value);
@@ -193,25 +317,88 @@ std::vector<std::unique_ptr<Decl>> Parser::parseVarDecl() {
             }
         }
         expect(TokenType::tok_colon);
-        if (match(TokenType::tok_array)) {
+        bool packed = false;
+        if (match(TokenType::tok_packed)) {
+            packed = true;
             next();
-            expect(TokenType::tok_open_bracket);
-            int min = std::stoi(curr->value);
-            next();
-            expect(TokenType::tok_range);
-            int max = std::stoi(curr->value);
+        }
+        if (match(TokenType::tok_array)) {
             next();
-            expect(TokenType::tok_close_bracket);
+            if (match(TokenType::tok_of)) {
+                next();
+                for (std::string &name : n) {
+                    decls.push_back(std::make_unique<VarDecl>(name, TokenType::tok_array, curr->value));
+                }
+                next();
+                expect(TokenType::tok_semicolon);
+                continue;
+            }
+            int min, max;
+            std::vector<std::pair<int, int>> dims;
+            parseBounds(min, max, dims);
             expect(TokenType::tok_of);
             if (match(TokenType::tok_identifier)) {
                 for (std::string &name : n) {
-                    decls.push_back(std::make_unique<ArrayVar>(name, curr->type, min, max, curr->value));
+                    std::unique_ptr<ArrayVar> a = std::make_unique<ArrayVar>(name, curr->type, min, max, curr->value);
+                    a->dims = dims;
+                    a->soa = soa;
+                    a->packed = packed;
+                    decls.push_back(std::move(a));
                 }
             } else {
                 for (std::string &name : n) {
-                    decls.push_back(std::make_unique<ArrayVar>(name, curr->type, min, max, curr->value));
+                    std::unique_ptr<ArrayVar> a = std::make_unique<ArrayVar>(name, curr->type, min, max, curr->value);
+                    a->dims = dims;
+                    a->packed = packed;
+                    decls.push_back(std::move(a));
                 }
             }
+        } else if (match(TokenType::tok_set)) {
+            int min, max;
+            std::string identifier;
+            TokenType type = parseSetBase(min, max, identifier);
+            for (std::string &name : n) {
+                decls.push_back(std::make_unique<SetVar>(name, type, min, max, identifier));
+            }
+            expect(TokenType::tok_semicolon);
+            continue;
+        } else if (match(TokenType::tok_pointer)) {
+            next();
+            for (std::string &id : n) {
+                decls.push_back(std::make_unique<VarDecl>(id, TokenType::tok_pointer, curr->value));
+            }
+        } else if (match(TokenType::tok_map)) {
+            // map of K to V; values are stored as reals, so V must be a scalar.
+            next();
+            expect(TokenType::tok_of);
+            std::string key = curr->value;
+            next();
+            expect(TokenType::tok_to);
+            if (!match(TokenType::tok_integer) && !match(TokenType::tok_real) && !match(TokenType::tok_boolean)) {
+                throw new std::runtime_error("Map values must be integer, real or boolean: " + curr->value);
+            }
+            for (std::string &id : n) {
+                decls.push_back(std::make_unique<VarDecl>(id, TokenType::tok_map, key));
+            }
+        } else if (match(TokenType::tok_channel)) {
+            // channel[capacity] of T; like map values, T must be a scalar.
+            next();
+            int capacity = 0;
+            if (match(TokenType::tok_open_bracket)) {
+                next();
+                capacity = std::stoi(curr->value);
+                expect(TokenType::tok_number);
+                expect(TokenType::tok_close_bracket);
+            }
+            expect(TokenType::tok_of);
+            if (!match(TokenType::tok_integer) && !match(TokenType::tok_real) && !match(TokenType::tok_boolean)) {
+                throw new std::runtime_error("Channel values must be integer, real or boolean: " + curr->value);
+            }
+            for (std::string &id : n) {
+                std::unique_ptr<VarDecl> c = std::make_unique<VarDecl>(id, TokenType::tok_channel, curr->value);
+                c->capacity = capacity;
+                decls.push_back(std::move(c));
+            }
         } else {
             for (std::string &id : n) {
                 if (!match(TokenType::tok_identifier)) {
@@ -224,38 +411,134 @@ std::vector<std::unique_ptr<Decl>> Parser::parseVarDecl() {
         }
         next();
         expect(TokenType::tok_semicolon);
+        soa = false;
     }
     return decls;
 }
 
+// [min..max, ...]; dimensions after the first go in dims, outermost first.
+void Parser::parseBounds(int &min, int &max, std::vector<std::pair<int, int>> &dims) {
+    expect(TokenType::tok_open_bracket);
+    min = std::stoi(curr->value);
+    next();
+    expect(TokenType::tok_range);
+    max = std::stoi(curr->value);
+    next();
+    while (match(TokenType::tok_comma)) {
+        next();
+        int lo = std::stoi(curr->value);
+        next();
+        expect(TokenType::tok_range);
+        int hi = std::stoi(curr->value);
+        next();
+        dims.push_back(std::make_pair(lo, hi));
+    }
+    expect(TokenType::tok_close_bracket);
+}
+
+// Sets are bitsets over ordinal values 0..255, so the base has to fit in that range.
+TokenType Parser::parseSetBase(int &min, int &max, std::string &identifier) {
+    expect(TokenType::tok_set);
+    expect(TokenType::tok_of);
+    TokenType type = curr->type;
+
+    if (match(TokenType::tok_number)) {
+        min = std::stoi(curr->value);
+        next();
+        expect(TokenType::tok_range);
+        max = std::stoi(curr->value);
+        expect(TokenType::tok_number);
+    } else if (match(TokenType::tok_char_literal)) {
+        min = static_cast<unsigned char>((curr->value)[0]);
+        next();
+        expect(TokenType::tok_range);
+        max = static_cast<unsigned char>((curr->value)[0]);
+        expect(TokenType::tok_char_literal);
+    } else if (match(TokenType::tok_char)) {
+        min = 0;
+        max = 255;
+        next();
+    } else if (match(TokenType::tok_boolean)) {
+        min = 0;
+        max = 1;
+        next();
+    } else if (match(TokenType::tok_identifier)) {
+        identifier = curr->value;
+        min = 0;
+        max = 255;
+        next();
+    } else {
+        throw new std::runtime_error("Invalid set base type: " + std::to_string(curr->type));
+    }
+
+    if (min < 0 || max > 255 || min > max) {
+        throw new std::runtime_error("Set base out of range: " + std::to_string(min) + ".." + std::to_string(max));
+    }
+    return type;
+}
+
+std::vector<std::unique_ptr<ParamDecl>> Parser::parseParams() {
+    std::vector<std::unique_ptr<ParamDecl>> params;
+    expect(TokenType::tok_open_paren);
+    while (!match(TokenType::tok_close_paren)) {
+        ParamMode mode = ParamMode::param_value;
+        if (match(TokenType::tok_var)) {
+            mode = ParamMode::param_var;
+            next();
+        } else if (match(TokenType::tok_const)) {
+            mode = ParamMode::param_const;
+            next();
+        }
+        std::vector<std::string> ids;
+        while (!match(TokenType::tok_colon)) {
+            ids.push_back(curr->value);
+            expect(TokenType::tok_identifier);
+            if (match(TokenType::tok_comma)) {
+                next();
+            }
+        }
+        expect(TokenType::tok_colon);
+        bool open = false;
+        bool channel = false;
+        if (match(TokenType::tok_array)) {
+            next();
+            expect(TokenType::tok_of);
+            open = true;
+        } else if (match(TokenType::tok_channel)) {
+            next();
+            expect(TokenType::tok_of);
+            channel = true;
+        }
+        for (std::string &id : ids) {
+            if (open) {
+                params.push_back(std::make_unique<ParamDecl>(id, TokenType::tok_array, mode, curr->value));
+            } else if (channel) {
+                params.push_back(std::make_unique<ParamDecl>(id, TokenType::tok_channel, mode));
+            } else if (match(TokenType::tok_identifier)) {
+                params.push_back(std::make_unique<ParamDecl>(id, curr->type, mode, curr->value));
+            } else {
+                params.push_back(std::make_unique<ParamDecl>(id, curr->type, mode));
+            }
+        }
+        ids.clear();
+        next();
+        if (match(TokenType::tok_semicolon)) {
+            next();
+        }
+    }
+    expect(TokenType::tok_close_paren);
+    return params;
+}
+
 std::unique_ptr<Decl> Parser::parseFuncDecl() {
     expect(TokenType::tok_function);
+    std::vector<std::unique_ptr<ParamDecl>> params;
     std::vector<std::unique_ptr<Decl>> decls;
 
     std::string name = curr->value;
     expect(TokenType::tok_identifier);
     if (match(TokenType::tok_open_paren)) {
-        expect(TokenType::tok_open_paren);
-        while (!match(TokenType::tok_close_paren)) {
-            std::vector<std::string> ids;
-            while (!match(TokenType::tok_colon)) {
-                ids.push_back(curr->value);
-                expect(TokenType::tok_identifier);
-                if (match(TokenType::tok_comma)) {
-                    next();
-                }
-            }
-            expect(TokenType::tok_colon);
-            for (std::string &id : ids) {
-                decls.push_back(std::make_unique<TypeDecl>(id, curr->type));
-            }
-            ids.clear();
-            next();
-            if (match(TokenType::tok_semicolon)) {
-                next();
-            }
-        }
-        expect(TokenType::tok_close_paren);
+        params = parseParams();
     }
     expect(TokenType::tok_colon);
     TokenType t = curr->type;
@@ -277,37 +560,20 @@ std::unique_ptr<Decl> Parser::parseFuncDecl() {
 
     expect(TokenType::tok_end);
     expect(TokenType::tok_semicolon);
-    return (std::make_unique<FuncDecl>(std::make_unique<Prototype>(name, std::move(decls)), t, std::move(stmts)));
+    auto proto = std::make_unique<Prototype>(name, std::move(params));
+    proto->string = t == TokenType::tok_string;
+    return (std::make_unique<FuncDecl>(std::move(proto), t, std::move(decls), std::move(stmts)));
 }
 
 std::unique_ptr<Decl> Parser::parseProcDecl() {
     expect(TokenType::tok_procedure);
+    std::vector<std::unique_ptr<ParamDecl>> params;
     std::vector<std::unique_ptr<Decl>> decls;
 
     std::string name = curr->value;
     expect(TokenType::tok_identifier);
     if(match(TokenType::tok_open_paren)) {
-        expect(TokenType::tok_open_paren);
-        while (!match(TokenType::tok_close_paren)) {
-            std::vector<std::string> ids;
-            while (!match(TokenType::tok_colon)) {
-                ids.push_back(curr->value);
-                expect(TokenType::tok_identifier);
-                if (match(TokenType::tok_comma)) {
-                    next();
-                }
-            }
-            expect(TokenType::tok_colon);
-            for (std::string &id : ids) {
-                decls.push_back(std::make_unique<TypeDecl>(id, curr->type));
-            }
-            ids.clear();
-            next();
-            if (match(TokenType::tok_semicolon)) {
-                next();
-            }
-        }   
-        expect(TokenType::tok_close_paren);
+        params = parseParams();
     }
     expect(TokenType::tok_semicolon);
     if (match(TokenType::tok_var)) {
@@ -326,5 +592,5 @@ std::unique_ptr<Decl> Parser::parseProcDecl() {
 
     expect(TokenType::tok_end);
     expect(TokenType::tok_semicolon);
-    return (std::make_unique<ProcDecl>(std::make_unique<Prototype>(name, std::move(decls)), std::move(stmts)));
+    return (std::make_unique<ProcDecl>(std::make_unique<Prototype>(name, std::move(params), true), std::move(decls), std::move(stmts)));
 }
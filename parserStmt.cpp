@@ -21,9 +21,24 @@ std::unique_ptr<Stmt> Parser::parseExprStmt() {
         if (match(TokenType::tok_open_bracket)) {
             next();
             std::unique_ptr<Expr> i = parseNestedExpr();
+            std::vector<std::unique_ptr<Expr>> subscripts = parseSubscripts();
             expect(TokenType::tok_close_bracket);
-            expect(TokenType::tok_semicolon);
-            return parseAssignStmt(std::make_unique<ArrayExpr>(std::make_unique<VarExpr>(n, t), std::move(i)));
+            if (match(TokenType::tok_dot)) {
+                if (!subscripts.empty()) {
+                    throw new std::runtime_error("Fields of multidimensional arrays are not supported");
+                }
+                next();
+                std::string f = curr->value;
+                expect(TokenType::tok_identifier);
+                return parseAssignStmt(std::make_unique<RecordExpr>(std::make_unique<VarExpr>(n, t), f, std::move(i)));
+            }
+            return parseAssignStmt(std::make_unique<ArrayExpr>(std::make_unique<VarExpr>(n, t), std::move(i), std::move(subscripts)));
+        } else if (match(TokenType::tok_pointer)) {
+            next();
+            expect(TokenType::tok_dot);
+            std::string f = curr->value;
+            expect(TokenType::tok_identifier);
+            return parseAssignStmt(std::make_unique<RecordExpr>(std::make_unique<VarExpr>(n, t), f, nullptr, true));
         } else if (match(TokenType::tok_dot)) {
             next();
             std::string f = curr->value;
@@ -48,6 +63,12 @@ std::unique_ptr<Stmt> Parser::parseExprStmt() {
         return parseReadStmt();
     } else if (match(TokenType::tok_write)) {
         return parseWriteStmt();
+    } else if (match(TokenType::tok_yield)) {
+        return parseYieldStmt();
+    } else if (match(TokenType::tok_spawn)) {
+        return parseSpawnStmt();
+    } else if (match(TokenType::tok_directive)) {
+        return parseParallelFor();
     } else {
         throw new std::runtime_error("Invalid token: " + curr->value);
     }
@@ -55,7 +76,7 @@ std::unique_ptr<Stmt> Parser::parseExprStmt() {
 
 std::unique_ptr<Stmt> Parser::parseAssignStmt(const std::string &name, TokenType t) {
     expect(TokenType::tok_assign);
-    if (!(curr->type >= TokenType::tok_boolean_literal && curr->type <= TokenType::tok_identifier)) {
+    if (match(TokenType::tok_minus) || match(TokenType::tok_not)) {
         std::string unary = curr->value;
         next();
         std::unique_ptr<Expr> v = parseNestedExpr();
@@ -70,7 +91,7 @@ std::unique_ptr<Stmt> Parser::parseAssignStmt(const std::string &name, TokenType
 
 std::unique_ptr<Stmt> Parser::parseAssignStmt(std::unique_ptr<Expr> name) {
     expect(TokenType::tok_assign);
-    if (!(curr->type >= TokenType::tok_boolean_literal && curr->type <= TokenType::tok_identifier)) {
+    if (match(TokenType::tok_minus) || match(TokenType::tok_not)) {
         std::string unary = curr->value;
         next();
         std::unique_ptr<Expr> v = parseNestedExpr();
@@ -83,15 +104,25 @@ std::unique_ptr<Stmt> Parser::parseAssignStmt(std::unique_ptr<Expr> name) {
     }
 }
 
+// The remaining indices of a[i, j, ...], after the first.
+std::vector<std::unique_ptr<Expr>> Parser::parseSubscripts() {
+    std::vector<std::unique_ptr<Expr>> subscripts;
+    while (match(TokenType::tok_comma)) {
+        next();
+        subscripts.push_back(parseNestedExpr());
+    }
+    return subscripts;
+}
+
 std::unique_ptr<Expr> Parser::parseNestedExpr() {
     if (match(TokenType::tok_number)) {
         std::unique_ptr<Expr> LHS = std::make_unique<NumberExpr>(std::stod(curr->value));
         next();
-        if ((curr->type >= TokenType::tok_divide && curr->type <= TokenType::tok_plus) || (curr->type >= TokenType::tok_equals && curr->type <= TokenType::tok_greater_equal) || (curr->type >= TokenType::tok_mod && curr->type <= TokenType::tok_div)) {
+        if (matchBinaryOp()) {
             std::string binary = curr->value;
             next();
             std::unique_ptr<Expr> RHS = parseNestedExpr();
-            return std::make_unique<BinaryExpr>(curr->value, std::move(LHS), std::move(RHS));
+            return std::make_unique<BinaryExpr>(binary, std::move(LHS), std::move(RHS));
         }
         return LHS;
     } else if (match(TokenType::tok_open_paren)) {
@@ -100,25 +131,72 @@ std::unique_ptr<Expr> Parser::parseNestedExpr() {
             next();
             return nullptr;
         }
-        std::unique_ptr<Expr> v = parseNestedExpr();
+        std::unique_ptr<Expr> LHS = parseNestedExpr();
+        expect(TokenType::tok_close_paren);
+        if (matchBinaryOp()) {
+            std::string binary = curr->value;
+            next();
+            std::unique_ptr<Expr> RHS = parseNestedExpr();
+            return std::make_unique<BinaryExpr>(binary, std::move(LHS), std::move(RHS));
+        }
+        return LHS;
+    } else if (match(TokenType::tok_open_bracket)) {
+        next();
+        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Expr>>> elements;
+        while (!match(TokenType::tok_close_bracket)) {
+            std::unique_ptr<Expr> lo = parseNestedExpr();
+            std::unique_ptr<Expr> hi;
+            if (match(TokenType::tok_range)) {
+                next();
+                hi = parseNestedExpr();
+            }
+            elements.push_back(std::make_pair(std::move(lo), std::move(hi)));
+            if (match(TokenType::tok_comma)) {
+                next();
+            }
+        }
         expect(TokenType::tok_close_bracket);
-        return v;
-    } else if (match(TokenType::tok_char_literal)) {
-        std::unique_ptr<CharExpr> c = std::make_unique<CharExpr>((curr->value)[0]);
+        std::unique_ptr<Expr> LHS = std::make_unique<SetExpr>(std::move(elements));
+        if (matchBinaryOp()) {
+            std::string binary = curr->value;
+            next();
+            std::unique_ptr<Expr> RHS = parseNestedExpr();
+            return std::make_unique<BinaryExpr>(binary, std::move(LHS), std::move(RHS));
+        }
+        return LHS;
+    } else if (match(TokenType::tok_char_literal) || match(TokenType::tok_string_literal)) {
+        std::unique_ptr<Expr> LHS;
+        if (match(TokenType::tok_char_literal)) {
+            LHS = std::make_unique<CharExpr>((curr->value)[0]);
+        } else {
+            LHS = std::make_unique<StringExpr>(curr->value);
+        }
         next();
-        return c;
-    } else if (match(TokenType::tok_string_literal)) {
-        std::unique_ptr<StringExpr> s = std::make_unique<StringExpr>(curr->value);
+        if (matchBinaryOp()) {
+            std::string binary = curr->value;
+            next();
+            std::unique_ptr<Expr> RHS = parseNestedExpr();
+            return std::make_unique<BinaryExpr>(binary, std::move(LHS), std::move(RHS));
+        }
+        return LHS;
+    } else if (match(TokenType::tok_nil)) {
+        std::unique_ptr<Expr> LHS = std::make_unique<NilExpr>();
         next();
-        return s;
+        if (matchBinaryOp()) {
+            std::string binary = curr->value;
+            next();
+            std::unique_ptr<Expr> RHS = parseNestedExpr();
+            return std::make_unique<BinaryExpr>(binary, std::move(LHS), std::move(RHS));
+        }
+        return LHS;
     } else if (match(TokenType::tok_boolean_literal)) {
         std::unique_ptr<BoolExpr> LHS = std::make_unique<BoolExpr>(curr->value == "true");
         next();
-        if (curr->type >= TokenType::tok_and && curr->type <= TokenType::tok_or) {
+        if (match(TokenType::tok_and) || match(TokenType::tok_or)) {
             std::string binary = curr->value;
             next();
             std::unique_ptr<Expr> RHS = parseNestedExpr();
-            return std::make_unique<BinaryExpr>(curr->value, std::move(LHS), std::move(RHS));
+            return std::make_unique<BinaryExpr>(binary, std::move(LHS), std::move(RHS));
         }
         return LHS;
     } else if (match(TokenType::tok_identifier)) {
@@ -127,23 +205,48 @@ std::unique_ptr<Expr> Parser::parseNestedExpr() {
         next();
         if (match(TokenType::tok_open_paren)) {
             std::unique_ptr<Expr> LHS = parseCallExpr(name, t);
-            if ((curr->type >= TokenType::tok_divide && curr->type <= TokenType::tok_plus) || (curr->type >= TokenType::tok_equals && curr->type <= TokenType::tok_div)) {
+            if (matchBinaryOp()) {
                 std::string binary = curr->value;
                 next();
                 std::unique_ptr<Expr> RHS = parseNestedExpr();
-                return std::make_unique<BinaryExpr>(curr->value, std::move(LHS), std::move(RHS));
+                return std::make_unique<BinaryExpr>(binary, std::move(LHS), std::move(RHS));
             }
             return LHS;
         } else if (match(TokenType::tok_open_bracket)) {
             next();
             std::unique_ptr<Expr> i = parseNestedExpr();
+            std::vector<std::unique_ptr<Expr>> subscripts = parseSubscripts();
             expect(TokenType::tok_close_bracket);
-            std::unique_ptr<Expr> LHS = std::make_unique<ArrayExpr>(std::make_unique<VarExpr>(name, t), std::move(i));
-            if ((curr->type >= TokenType::tok_divide && curr->type <= TokenType::tok_plus) || (curr->type >= TokenType::tok_equals && curr->type <= TokenType::tok_div)) {
+            std::unique_ptr<Expr> LHS;
+            if (match(TokenType::tok_dot)) {
+                if (!subscripts.empty()) {
+                    throw new std::runtime_error("Fields of multidimensional arrays are not supported");
+                }
+                next();
+                std::string f = curr->value;
+                expect(TokenType::tok_identifier);
+                LHS = std::make_unique<RecordExpr>(std::make_unique<VarExpr>(name, t), f, std::move(i));
+            } else {
+                LHS = std::make_unique<ArrayExpr>(std::make_unique<VarExpr>(name, t), std::move(i), std::move(subscripts));
+            }
+            if (matchBinaryOp()) {
                 std::string binary = curr->value;
                 next();
                 std::unique_ptr<Expr> RHS = parseNestedExpr();
-                return std::make_unique<BinaryExpr>(curr->value, std::move(LHS), std::move(RHS));
+                return std::make_unique<BinaryExpr>(binary, std::move(LHS), std::move(RHS));
+            }
+            return LHS;
+        } else if (match(TokenType::tok_pointer)) {
+            next();
+            expect(TokenType::tok_dot);
+            std::string f = curr->value;
+            expect(TokenType::tok_identifier);
+            std::unique_ptr<Expr> LHS = std::make_unique<RecordExpr>(std::make_unique<VarExpr>(name, t), f, nullptr, true);
+            if (matchBinaryOp()) {
+                std::string binary = curr->value;
+                next();
+                std::unique_ptr<Expr> RHS = parseNestedExpr();
+                return std::make_unique<BinaryExpr>(binary, std::move(LHS), std::move(RHS));
             }
             return LHS;
         } else if (match(TokenType::tok_dot)) {
@@ -151,20 +254,20 @@ std::unique_ptr<Expr> Parser::parseNestedExpr() {
             std::string f = curr->value;
             next();
             std::unique_ptr<Expr> LHS = std::make_unique<RecordExpr>(std::make_unique<VarExpr>(name, t), f);
-            if ((curr->type >= TokenType::tok_divide && curr->type <= TokenType::tok_plus) || (curr->type >= TokenType::tok_equals && curr->type <= TokenType::tok_div)) {
+            if (matchBinaryOp()) {
                 std::string binary = curr->value;
                 next();
                 std::unique_ptr<Expr> RHS = parseNestedExpr();
-                return std::make_unique<BinaryExpr>(curr->value, std::move(LHS), std::move(RHS));
+                return std::make_unique<BinaryExpr>(binary, std::move(LHS), std::move(RHS));
             }
             return LHS;
         } else {
             std::unique_ptr<Expr> LHS = std::make_unique<VarExpr>(name, t);
-            if ((curr->type >= TokenType::tok_divide && curr->type <= TokenType::tok_plus) || (curr->type >= TokenType::tok_equals && curr->type <= TokenType::tok_div)) {
+            if (matchBinaryOp()) {
                 std::string binary = curr->value;
                 next();
                 std::unique_ptr<Expr> RHS = parseNestedExpr();
-                return std::make_unique<BinaryExpr>(curr->value, std::move(LHS), std::move(RHS));
+                return std::make_unique<BinaryExpr>(binary, std::move(LHS), std::move(RHS));
             }
             return LHS;
         }
@@ -269,32 +372,30 @@ std::unique_ptr<Stmt> Parser::parseForStmt() {
     expect(TokenType::tok_for);
     std::string name = curr->value;
     expect(TokenType::tok_identifier);
-    expect(TokenType::tok_assign);
-    bool ischar = false;
-    int start;
-    if (match(TokenType::tok_number)) {
-        start = std::stoi(curr->value);
+    // for k in m do ... visits the keys of a map.
+    if (match(TokenType::tok_in)) {
         next();
-    } else {
-        ischar = true;
-        start = static_cast<int>((curr->value)[0]);
-        expect(TokenType::tok_char_literal);
+        std::unique_ptr<Expr> in = parseNestedExpr();
+        expect(TokenType::tok_do);
+        std::unique_ptr<Stmt> b;
+        if (match(TokenType::tok_begin)) {
+            b = parseCompoundStmt();
+        } else {
+            b = parseExprStmt();
+        }
+        expect(TokenType::tok_semicolon);
+        return std::make_unique<ForStmt>(name, std::move(in), std::move(b));
     }
+    expect(TokenType::tok_assign);
+    std::unique_ptr<Expr> from = parseNestedExpr();
     bool downto = false;
     if (match(TokenType::tok_downto)) {
         downto = true;
+        next();
     } else {
         expect(TokenType::tok_to);
     }
-    int end;
-    if (ischar) {
-        end = static_cast<int>((curr->value)[0]);
-        expect(TokenType::tok_char_literal);
-    } else {
-        end = std::stoi(curr->value);
-        expect(TokenType::tok_number);
-    }
-    expect(TokenType::tok_number);
+    std::unique_ptr<Expr> to = parseNestedExpr();
     expect(TokenType::tok_do);
     std::unique_ptr<Stmt> b;
     if (match(TokenType::tok_begin)) {
@@ -303,7 +404,85 @@ std::unique_ptr<Stmt> Parser::parseForStmt() {
         b = parseExprStmt();
     }
     expect(TokenType::tok_semicolon);
-    return std::make_unique<ForStmt>(name, start, end, ischar, downto, std::move(b));
+
+    // Number and char literal bounds are kept as constants.
+    auto* fromNumber = dynamic_cast<NumberExpr*>(from.get());
+    auto* toNumber = dynamic_cast<NumberExpr*>(to.get());
+    auto* fromChar = dynamic_cast<CharExpr*>(from.get());
+    auto* toChar = dynamic_cast<CharExpr*>(to.get());
+    if (fromNumber && toNumber) {
+        return std::make_unique<ForStmt>(name, static_cast<int>(fromNumber->value), static_cast<int>(toNumber->value), false, downto, std::move(b));
+    }
+    if (fromChar && toChar) {
+        return std::make_unique<ForStmt>(name, static_cast<int>(fromChar->value), static_cast<int>(toChar->value), true, downto, std::move(b));
+    }
+    auto loop = std::make_unique<ForStmt>(name, 0, 0, fromChar || toChar, downto, std::move(b));
+    loop->from = std::move(from);
+    loop->to = std::move(to);
+    return loop;
+}
+
+// {$PARALLEL [STATIC|DYNAMIC] [chunk] [REDUCTION op:var ...]} before a for loop
+// runs its iterations on the runtime thread pool.
+std::unique_ptr<Stmt> Parser::parseParallelFor() {
+    std::istringstream words(curr->value);
+    std::string word;
+    words >> word;
+    if (word != "parallel") {
+        throw new std::runtime_error("Unknown directive: " + curr->value);
+    }
+    next();
+    if (!match(TokenType::tok_for)) {
+        throw new std::runtime_error("{$PARALLEL} must come before a for loop");
+    }
+    std::unique_ptr<Stmt> s = parseForStmt();
+    ForStmt* loop = static_cast<ForStmt*>(s.get());
+    if (loop->in) {
+        throw new std::runtime_error("For-in loops cannot be parallel");
+    }
+    loop->parallel = true;
+
+    bool reduction = false;
+    while (words >> word) {
+        size_t colon = word.find(':');
+        if (word == "static" || word == "dynamic") {
+            loop->dynamic = word == "dynamic";
+        } else if (word == "reduction") {
+            reduction = true;
+        } else if (isdigit(word[0])) {
+            loop->chunk = std::stoi(word);
+        } else if (reduction && colon != std::string::npos) {
+            std::string op = word.substr(0, colon);
+            if (op != "+" && op != "min" && op != "max") {
+                throw new std::runtime_error("Unknown reduction operator: " + op);
+            }
+            loop->reductions.push_back(std::make_pair(op, word.substr(colon + 1)));
+        } else {
+            throw new std::runtime_error("Unknown {$PARALLEL} option: " + word);
+        }
+    }
+    return s;
+}
+
+std::unique_ptr<Expr> Parser::parseCaseLabel() {
+    std::unique_ptr<Expr> p;
+    if (match(TokenType::tok_minus)) {
+        next();
+        p = std::make_unique<NumberExpr>(-std::stod(curr->value));
+        expect(TokenType::tok_number);
+    } else if (match(TokenType::tok_number)) {
+        p = std::make_unique<NumberExpr>(std::stod(curr->value));
+        next();
+    } else if (match(TokenType::tok_char_literal)) {
+        p = std::make_unique<CharExpr>((curr->value)[0]);
+        next();
+    } else if (match(TokenType::tok_boolean_literal)) {
+        p = std::make_unique<BoolExpr>(curr->value == "true");
+        next();
+    } else {
+        throw new std::runtime_error("Invalid type");
+    }
+    return p;
 }
 
 std::unique_ptr<Stmt> Parser::parseCaseStmt() {
@@ -313,24 +492,45 @@ std::unique_ptr<Stmt> Parser::parseCaseStmt() {
     expect(TokenType::tok_of);
     std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> cases;
     while(!match(TokenType::tok_else) && !(match(TokenType::tok_end))) {
+        std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Expr>>> labels;
+        while (!match(TokenType::tok_colon)) {
+            std::unique_ptr<Expr> lo = parseCaseLabel();
+            std::unique_ptr<Expr> hi;
+            if (match(TokenType::tok_range)) {
+                next();
+                hi = parseCaseLabel();
+            }
+            labels.push_back(std::make_pair(std::move(lo), std::move(hi)));
+            if (match(TokenType::tok_comma)) {
+                next();
+            }
+        }
         std::unique_ptr<Expr> p;
-        if (match(TokenType::tok_number)) {
-            p = std::make_unique<NumberExpr>(std::stod(curr->value));
-        } else if (match(TokenType::tok_char_literal)) {
-            p = std::make_unique<CharExpr>((curr->value)[0]);
-        } else if (match(TokenType::tok_boolean_literal)) {
-            p = std::make_unique<BoolExpr>(curr->value == "true");
+        if (labels.size() == 1 && !labels[0].second) {
+            p = std::move(labels[0].first);
         } else {
-            throw new std::runtime_error("Invalid type");
+            p = std::make_unique<SetExpr>(std::move(labels));
         }
         expect(TokenType::tok_colon);
-        std::unique_ptr<Stmt> s = parseExprStmt();
+        std::unique_ptr<Stmt> s;
+        if (match(TokenType::tok_begin)) {
+            s = parseCompoundStmt();
+        } else {
+            s = parseExprStmt();
+        }
         cases.push_back(std::pair(std::move(p), std::move(s)));
         expect(TokenType::tok_semicolon);
     }
     if (match(TokenType::tok_else)) {
         next();
-        std::unique_ptr<Stmt> s = parseExprStmt();
+        std::unique_ptr<Stmt> s;
+        if (match(TokenType::tok_begin)) {
+            s = parseCompoundStmt();
+        } else {
+            s = parseExprStmt();
+        }
+        expect(TokenType::tok_semicolon);
+        expect(TokenType::tok_end);
         expect(TokenType::tok_semicolon);
         return std::make_unique<CaseStmt>(std::move(value), std::move(cases), std::move(s));
     }
@@ -382,3 +582,21 @@ std::unique_ptr<Stmt> Parser::parseWriteStmt() {
     expect(TokenType::tok_semicolon);
     return std::make_unique<WriteStmt>(std::move(exprs));
 }
+
+std::unique_ptr<Stmt> Parser::parseYieldStmt() {
+    expect(TokenType::tok_yield);
+    std::unique_ptr<Expr> value = parseNestedExpr();
+    expect(TokenType::tok_semicolon);
+    return std::make_unique<YieldStmt>(std::move(value));
+}
+
+std::unique_ptr<Stmt> Parser::parseSpawnStmt() {
+    expect(TokenType::tok_spawn);
+    std::unique_ptr<Stmt> s = parseExprStmt();
+    auto* call = dynamic_cast<CallStmt*>(s.get());
+    if (!call) {
+        throw new std::runtime_error("spawn must be followed by a procedure call");
+    }
+    s.release();
+    return std::make_unique<SpawnStmt>(std::unique_ptr<CallStmt>(call));
+}
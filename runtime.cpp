@@ -0,0 +1,7 @@
+#include <cstdio>
+#include <cstdlib>
+
+extern "C" void __pascal_range_error(int index, int min, int max) {
+    fprintf(stderr, "Error: Index %d out of range %d..%d\n", index, min, max);
+    exit(201);
+}
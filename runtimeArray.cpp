@@ -0,0 +1,396 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+// Kernels behind sort, binarysearch, fill, sum, min, max and dot. Arrays arrive
+// as a data pointer and element count; real and integer elements are doubles and
+// single elements are floats, so each kernel has an _f64 and an _f32 version.
+// The loops work on 16-byte vectors (one SSE or NEON register) so they stay
+// vectorized whatever the runtime is compiled with.
+
+template <typename T>
+struct Vec {
+    typedef T Type __attribute__((vector_size(16)));
+    static const int Lanes = 16 / sizeof(T);
+};
+
+template <typename T>
+static typename Vec<T>::Type loadVec(const T* p) {
+    typename Vec<T>::Type v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+template <typename T>
+static T sum(const T* a, int64_t n) {
+    const int L = Vec<T>::Lanes;
+    typename Vec<T>::Type acc0 = {}, acc1 = {};
+    int64_t i = 0;
+    for (; i + 2 * L <= n; i += 2 * L) {
+        acc0 += loadVec(a + i);
+        acc1 += loadVec(a + i + L);
+    }
+    acc0 += acc1;
+    T s = 0;
+    for (int l = 0; l < L; l++) {
+        s += acc0[l];
+    }
+    for (; i < n; i++) {
+        s += a[i];
+    }
+    return s;
+}
+
+template <typename T>
+static T dot(const T* a, const T* b, int64_t n) {
+    const int L = Vec<T>::Lanes;
+    typename Vec<T>::Type acc0 = {}, acc1 = {};
+    int64_t i = 0;
+    for (; i + 2 * L <= n; i += 2 * L) {
+        acc0 += loadVec(a + i) * loadVec(b + i);
+        acc1 += loadVec(a + i + L) * loadVec(b + i + L);
+    }
+    acc0 += acc1;
+    T s = 0;
+    for (int l = 0; l < L; l++) {
+        s += acc0[l];
+    }
+    for (; i < n; i++) {
+        s += a[i] * b[i];
+    }
+    return s;
+}
+
+// Lanes are blended through their bits because the comparison mask is an integer vector.
+template <typename T>
+static T extreme(const T* a, int64_t n, bool wantMax) {
+    if (n == 0) {
+        return 0;
+    }
+    const int L = Vec<T>::Lanes;
+    typedef typename Vec<T>::Type V;
+    typedef decltype(V() < V()) Mask;
+    T best = a[0];
+    int64_t i = 0;
+    if (n >= L) {
+        V acc = loadVec(a);
+        for (i = L; i + L <= n; i += L) {
+            V v = loadVec(a + i);
+            Mask take = wantMax ? v > acc : v < acc;
+            acc = (V)((take & (Mask)v) | (~take & (Mask)acc));
+        }
+        best = acc[0];
+        for (int l = 1; l < L; l++) {
+            best = (wantMax ? acc[l] > best : acc[l] < best) ? acc[l] : best;
+        }
+    }
+    for (; i < n; i++) {
+        best = (wantMax ? a[i] > best : a[i] < best) ? a[i] : best;
+    }
+    return best;
+}
+
+template <typename T>
+static void fill(T* a, int64_t n, int64_t from, int64_t to, T value) {
+    if (from < 0) {
+        from = 0;
+    }
+    if (to > n - 1) {
+        to = n - 1;
+    }
+    if (from > to) {
+        return;
+    }
+    const int L = Vec<T>::Lanes;
+    typename Vec<T>::Type v;
+    for (int l = 0; l < L; l++) {
+        v[l] = value;
+    }
+    int64_t i = from;
+    for (; i + L <= to + 1; i += L) {
+        memcpy(a + i, &v, sizeof(v));
+    }
+    for (; i <= to; i++) {
+        a[i] = value;
+    }
+}
+
+// Orders NaN after every number so sorting always sees a strict weak ordering.
+template <typename T>
+static bool less(T a, T b) {
+    return a < b || (b != b && a == a);
+}
+
+// Branchless lower bound: each step halves the range with a conditional move.
+template <typename T>
+static int64_t search(const T* a, int64_t n, T key) {
+    if (n == 0) {
+        return -1;
+    }
+    const T* base = a;
+    for (int64_t len = n; len > 1;) {
+        int64_t half = len / 2;
+        base = less(base[half - 1], key) ? base + half : base;
+        len -= half;
+    }
+    int64_t i = base - a + less(*base, key);
+    return i < n && a[i] == key ? i : -1;
+}
+
+// Pattern-defeating quicksort: insertion sort for short ranges, a median of
+// three (or ninther) pivot, a check for already partitioned input, and heapsort
+// once too many partitions come out unbalanced.
+static const int64_t InsertionLimit = 24;
+static const int64_t NintherThreshold = 128;
+
+template <typename T>
+static void insertionSort(T* a, int64_t n) {
+    for (int64_t i = 1; i < n; i++) {
+        T x = a[i];
+        int64_t j = i;
+        for (; j > 0 && less(x, a[j - 1]); j--) {
+            a[j] = a[j - 1];
+        }
+        a[j] = x;
+    }
+}
+
+// Gives up after moving a few elements, so it only finishes nearly sorted ranges.
+template <typename T>
+static bool partialInsertionSort(T* a, int64_t n) {
+    int64_t moved = 0;
+    for (int64_t i = 1; i < n; i++) {
+        T x = a[i];
+        int64_t j = i;
+        for (; j > 0 && less(x, a[j - 1]); j--) {
+            a[j] = a[j - 1];
+        }
+        a[j] = x;
+        moved += i - j;
+        if (moved > 8) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+static void siftDown(T* a, int64_t n, int64_t i) {
+    for (int64_t child; (child = 2 * i + 1) < n; i = child) {
+        if (child + 1 < n && less(a[child], a[child + 1])) {
+            child++;
+        }
+        if (!less(a[i], a[child])) {
+            return;
+        }
+        std::swap(a[i], a[child]);
+    }
+}
+
+template <typename T>
+static void heapSort(T* a, int64_t n) {
+    for (int64_t i = n / 2; i-- > 0;) {
+        siftDown(a, n, i);
+    }
+    for (int64_t i = n - 1; i > 0; i--) {
+        std::swap(a[0], a[i]);
+        siftDown(a, i, 0);
+    }
+}
+
+template <typename T>
+static void sort3(T* a, int64_t i, int64_t j, int64_t k) {
+    if (less(a[j], a[i])) std::swap(a[i], a[j]);
+    if (less(a[k], a[j])) std::swap(a[j], a[k]);
+    if (less(a[j], a[i])) std::swap(a[i], a[j]);
+}
+
+// Partitions around a[0]; returns the pivot's final position and whether the
+// range was already partitioned.
+template <typename T>
+static int64_t partition(T* a, int64_t n, bool& alreadyPartitioned) {
+    T pivot = a[0];
+    int64_t first = 0;
+    int64_t last = n;
+    while (less(a[++first], pivot)) {
+    }
+    if (first == 1) {
+        while (first < last && !less(a[--last], pivot)) {
+        }
+    } else {
+        while (!less(a[--last], pivot)) {
+        }
+    }
+    alreadyPartitioned = first >= last;
+    while (first < last) {
+        std::swap(a[first], a[last]);
+        while (less(a[++first], pivot)) {
+        }
+        while (!less(a[--last], pivot)) {
+        }
+    }
+    int64_t p = first - 1;
+    a[0] = a[p];
+    a[p] = pivot;
+    return p;
+}
+
+// Puts elements equal to the pivot on its left. Used when the pivot equals the
+// element before the range, so the whole equal run can be skipped at once.
+template <typename T>
+static int64_t partitionLeft(T* a, int64_t n) {
+    T pivot = a[0];
+    int64_t first = 0;
+    int64_t last = n;
+    while (less(pivot, a[--last])) {
+    }
+    if (last + 1 == n) {
+        while (first < last && !less(pivot, a[++first])) {
+        }
+    } else {
+        while (!less(pivot, a[++first])) {
+        }
+    }
+    while (first < last) {
+        std::swap(a[first], a[last]);
+        while (less(pivot, a[--last])) {
+        }
+        while (!less(pivot, a[++first])) {
+        }
+    }
+    a[0] = a[last];
+    a[last] = pivot;
+    return last;
+}
+
+template <typename T>
+static void pdqsort(T* a, int64_t n, int badAllowed, bool leftmost) {
+    while (n > InsertionLimit) {
+        int64_t half = n / 2;
+        if (n > NintherThreshold) {
+            sort3(a, 0, half, n - 1);
+            sort3(a, 1, half - 1, n - 2);
+            sort3(a, 2, half + 1, n - 3);
+            sort3(a, half - 1, half, half + 1);
+            std::swap(a[0], a[half]);
+        } else {
+            sort3(a, half, 0, n - 1);
+        }
+
+        if (!leftmost && !less(a[-1], a[0])) {
+            int64_t p = partitionLeft(a, n);
+            a += p + 1;
+            n -= p + 1;
+            continue;
+        }
+
+        bool alreadyPartitioned;
+        int64_t p = partition(a, n, alreadyPartitioned);
+        int64_t left = p;
+        int64_t right = n - p - 1;
+
+        if (left < n / 8 || right < n / 8) {
+            if (--badAllowed == 0) {
+                heapSort(a, n);
+                return;
+            }
+            // Swap a few elements around to break up patterns that made the pivot bad.
+            if (left >= InsertionLimit) {
+                std::swap(a[0], a[left / 4]);
+                std::swap(a[p - 1], a[p - left / 4]);
+            }
+            if (right >= InsertionLimit) {
+                std::swap(a[p + 1], a[p + 1 + right / 4]);
+                std::swap(a[n - 1], a[n - right / 4]);
+            }
+        } else if (alreadyPartitioned && partialInsertionSort(a, left) && partialInsertionSort(a + p + 1, right)) {
+            return;
+        }
+
+        // Recurse into the smaller side so the stack stays logarithmic.
+        if (left < right) {
+            pdqsort(a, left, badAllowed, leftmost);
+            a += p + 1;
+            n = right;
+            leftmost = false;
+        } else {
+            pdqsort(a + p + 1, right, badAllowed, false);
+            n = left;
+        }
+    }
+    insertionSort(a, n);
+}
+
+template <typename T>
+static void sort(T* a, int64_t n) {
+    int bad = 1;
+    for (int64_t m = n; m > 1; m >>= 1) {
+        bad++;
+    }
+    pdqsort(a, n, bad, true);
+}
+
+// Integer arrays are stored as doubles; flipping the sign bit of positives and
+// every bit of negatives makes their bit patterns sort as unsigned integers.
+// LSD radix sort then takes one counting pass per byte, skipping bytes that are
+// the same in every key, which for small integers is most of them.
+static uint64_t radixKey(double d) {
+    uint64_t u;
+    memcpy(&u, &d, sizeof(u));
+    return u >> 63 ? ~u : u | (1ull << 63);
+}
+
+static void radixSort(double* a, int64_t n) {
+    if (n < 256) {
+        sort(a, n);
+        return;
+    }
+    uint64_t* keys = static_cast<uint64_t*>(malloc(n * sizeof(uint64_t)));
+    uint64_t* tmp = static_cast<uint64_t*>(malloc(n * sizeof(uint64_t)));
+    static thread_local int64_t counts[8][256];
+    memset(counts, 0, sizeof(counts));
+    for (int64_t i = 0; i < n; i++) {
+        keys[i] = radixKey(a[i]);
+        for (int b = 0; b < 8; b++) {
+            counts[b][(keys[i] >> (8 * b)) & 0xFF]++;
+        }
+    }
+    for (int b = 0; b < 8; b++) {
+        if (counts[b][(keys[0] >> (8 * b)) & 0xFF] == n) {
+            continue;
+        }
+        int64_t offset = 0;
+        for (int d = 0; d < 256; d++) {
+            int64_t c = counts[b][d];
+            counts[b][d] = offset;
+            offset += c;
+        }
+        for (int64_t i = 0; i < n; i++) {
+            tmp[counts[b][(keys[i] >> (8 * b)) & 0xFF]++] = keys[i];
+        }
+        std::swap(keys, tmp);
+    }
+    for (int64_t i = 0; i < n; i++) {
+        uint64_t u = keys[i] >> 63 ? keys[i] & ~(1ull << 63) : ~keys[i];
+        memcpy(&a[i], &u, sizeof(u));
+    }
+    free(keys);
+    free(tmp);
+}
+
+extern "C" void __pascal_sort_f64(double* a, int64_t n) { sort(a, n); }
+extern "C" void __pascal_sort_f32(float* a, int64_t n) { sort(a, n); }
+extern "C" void __pascal_radixsort_f64(double* a, int64_t n) { radixSort(a, n); }
+extern "C" int64_t __pascal_bsearch_f64(const double* a, int64_t n, double key) { return search(a, n, key); }
+extern "C" int64_t __pascal_bsearch_f32(const float* a, int64_t n, float key) { return search(a, n, key); }
+extern "C" void __pascal_fill_f64(double* a, int64_t n, int64_t from, int64_t to, double value) { fill(a, n, from, to, value); }
+extern "C" void __pascal_fill_f32(float* a, int64_t n, int64_t from, int64_t to, float value) { fill(a, n, from, to, value); }
+extern "C" double __pascal_sum_f64(const double* a, int64_t n) { return sum(a, n); }
+extern "C" float __pascal_sum_f32(const float* a, int64_t n) { return sum(a, n); }
+extern "C" double __pascal_min_f64(const double* a, int64_t n) { return extreme(a, n, false); }
+extern "C" float __pascal_min_f32(const float* a, int64_t n) { return extreme(a, n, false); }
+extern "C" double __pascal_max_f64(const double* a, int64_t n) { return extreme(a, n, true); }
+extern "C" float __pascal_max_f32(const float* a, int64_t n) { return extreme(a, n, true); }
+extern "C" double __pascal_dot_f64(const double* a, const double* b, int64_t n) { return dot(a, b, n); }
+extern "C" float __pascal_dot_f32(const float* a, const float* b, int64_t n) { return dot(a, b, n); }
@@ -0,0 +1,41 @@
+#include <cstdint>
+#include <cstring>
+
+// packed array of boolean is a run of 64-bit words, bit i of the array at bit
+// i % 64 of word i / 64. Bits past the last element are always clear.
+
+extern "C" int64_t __pascal_bits_count(const uint64_t* words, int64_t n) {
+    int64_t count = 0;
+    for (int64_t w = 0; w < (n + 63) / 64; w++) {
+        count += __builtin_popcountll(words[w]);
+    }
+    return count;
+}
+
+// Sets or clears elements from..to (0-based, inclusive): partial words at the
+// ends are masked, whole words in between are written with memset.
+extern "C" void __pascal_bits_fill(uint64_t* words, int64_t n, int64_t from, int64_t to, bool value) {
+    if (from < 0) {
+        from = 0;
+    }
+    if (to >= n) {
+        to = n - 1;
+    }
+    if (from > to) {
+        return;
+    }
+
+    int64_t first = from / 64;
+    int64_t last = to / 64;
+    uint64_t head = ~0ull << (from % 64);
+    uint64_t tail = ~0ull >> (63 - to % 64);
+    if (first == last) {
+        head &= tail;
+    }
+    words[first] = value ? words[first] | head : words[first] & ~head;
+    if (first == last) {
+        return;
+    }
+    memset(words + first + 1, value ? 0xFF : 0, (last - first - 1) * sizeof(uint64_t));
+    words[last] = value ? words[last] | tail : words[last] & ~tail;
+}
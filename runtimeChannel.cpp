@@ -0,0 +1,188 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+// A channel is a bounded multi-producer/multi-consumer ring (Vyukov's queue):
+// every cell carries a sequence number that says whose turn it is, so senders
+// and receivers claim cells with one compare-and-swap on their own counter and
+// never take a lock while the ring is neither full nor empty. A thread that
+// finds it full or empty spins, then yields, then parks on a condition variable
+// until the other side wakes it. Channels are reference counted: the declaring
+// routine holds one reference and every spawned call that was passed the
+// channel holds another, so a channel outlives the routine that declared it.
+
+struct Cell {
+    std::atomic<uint64_t> seq;
+    double value;
+};
+
+struct Channel {
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<int> parkedSenders;
+    std::atomic<int> parkedReceivers;
+    std::atomic<int> refs;
+    uint64_t mask;
+    Cell* cells;
+    std::mutex lock;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
+
+struct ChannelVar {
+    Channel* channel;
+};
+
+static const uint64_t DefaultCapacity = 256;
+static const int Spins = 100;
+static const int Yields = 10;
+
+static void relax() {
+#if defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+static Channel* get(ChannelVar* c) {
+    if (!c->channel) {
+        fprintf(stderr, "Error: Channel not created\n");
+        exit(104);
+    }
+    return c->channel;
+}
+
+static bool trySend(Channel* ch, double v) {
+    uint64_t pos = ch->head.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell& cell = ch->cells[pos & ch->mask];
+        int64_t diff = static_cast<int64_t>(cell.seq.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (ch->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.value = v;
+                cell.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = ch->head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static bool tryReceive(Channel* ch, double& v) {
+    uint64_t pos = ch->tail.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell& cell = ch->cells[pos & ch->mask];
+        int64_t diff = static_cast<int64_t>(cell.seq.load(std::memory_order_acquire) - (pos + 1));
+        if (diff == 0) {
+            if (ch->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                v = cell.value;
+                cell.seq.store(pos + ch->mask + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = ch->tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Called after a send or receive succeeds. The fence pairs with the one a thread
+// issues after counting itself parked and before trying once more, so either
+// that last try succeeds or the waker sees it parked.
+static void wake(Channel* ch, std::atomic<int>& parked, std::condition_variable& cv) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> guard(ch->lock);
+        cv.notify_one();
+    }
+}
+
+extern "C" void __pascal_chan_init(ChannelVar* c, int64_t capacity) {
+    uint64_t size = 2;
+    while (size < (capacity > 0 ? static_cast<uint64_t>(capacity) : DefaultCapacity)) {
+        size *= 2;
+    }
+    Channel* ch = new Channel();
+    ch->refs.store(1, std::memory_order_relaxed);
+    ch->mask = size - 1;
+    ch->cells = new Cell[size];
+    for (uint64_t i = 0; i < size; i++) {
+        ch->cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    c->channel = ch;
+}
+
+extern "C" void __pascal_chan_retain(ChannelVar* c) {
+    get(c)->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Drops one reference; the last one frees the ring.
+extern "C" void __pascal_chan_free(ChannelVar* c) {
+    Channel* ch = c->channel;
+    c->channel = nullptr;
+    if (ch && ch->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete[] ch->cells;
+        delete ch;
+    }
+}
+
+extern "C" void __pascal_chan_send(ChannelVar* c, double v) {
+    Channel* ch = get(c);
+    for (int i = 0; i < Spins + Yields; i++) {
+        if (trySend(ch, v)) {
+            wake(ch, ch->parkedReceivers, ch->notEmpty);
+            return;
+        }
+        if (i < Spins) {
+            relax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    {
+        std::unique_lock<std::mutex> guard(ch->lock);
+        ch->parkedSenders.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!trySend(ch, v)) {
+            ch->notFull.wait(guard);
+        }
+        ch->parkedSenders.fetch_sub(1, std::memory_order_relaxed);
+    }
+    wake(ch, ch->parkedReceivers, ch->notEmpty);
+}
+
+extern "C" double __pascal_chan_receive(ChannelVar* c) {
+    Channel* ch = get(c);
+    double v;
+    for (int i = 0; i < Spins + Yields; i++) {
+        if (tryReceive(ch, v)) {
+            wake(ch, ch->parkedSenders, ch->notFull);
+            return v;
+        }
+        if (i < Spins) {
+            relax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    {
+        std::unique_lock<std::mutex> guard(ch->lock);
+        ch->parkedReceivers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!tryReceive(ch, v)) {
+            ch->notEmpty.wait(guard);
+        }
+        ch->parkedReceivers.fetch_sub(1, std::memory_order_relaxed);
+    }
+    wake(ch, ch->parkedSenders, ch->notFull);
+    return v;
+}
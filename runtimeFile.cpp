@@ -0,0 +1,407 @@
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Text files read through a window onto their contents: the whole file when it
+// can be mapped, otherwise a buffer refilled with large reads. Lines are found
+// 16 bytes at a time and numbers are parsed in place with from_chars, so nothing
+// is copied on the way in. Writes collect in a buffer flushed when it fills up.
+// A null text stands for the console, which is read and written the same way.
+// Parallel loop bodies and spawned calls may do I/O, so one recursive lock
+// guards every file; readln and writeln hold it for the whole line.
+
+struct PascalString {
+    uint64_t words[2];
+};
+
+extern "C" void __pascal_str_set(PascalString* dst, const char* p, int64_t len);
+extern "C" const char* __pascal_str_chars(const PascalString* s);
+extern "C" int64_t __pascal_str_length(const PascalString* s);
+
+static const size_t BufferSize = 1 << 20;
+static const size_t PageSize = 4096;
+
+struct File {
+    char* path = nullptr;
+    int fd = -1;
+    bool writing = false;
+    bool exhausted = false;
+    const char* map = nullptr;
+    size_t mapSize = 0;
+    // Unread input is [pos, end); eol caches the end of the current line.
+    const char* pos = nullptr;
+    const char* end = nullptr;
+    const char* eol = nullptr;
+    char* buffer = nullptr;
+    size_t capacity = 0;
+    size_t pending = 0;
+};
+
+struct Text {
+    File* file;
+};
+
+static File Input;
+static File Output;
+static std::recursive_mutex IoLock;
+
+typedef std::lock_guard<std::recursive_mutex> IoGuard;
+
+typedef char Bytes16 __attribute__((vector_size(16)));
+
+static void ioError(const char* what, const char* path, int code) {
+    fprintf(stderr, "Error: %s %s\n", what, path ? path : "");
+    exit(code);
+}
+
+static void writeAll(File* f, const char* p, size_t len) {
+    for (size_t done = 0; done < len;) {
+        ssize_t n = write(f->fd, p + done, len - done);
+        if (n <= 0) {
+            ioError("Cannot write", f->path, 101);
+        }
+        done += n;
+    }
+}
+
+static void flush(File* f) {
+    writeAll(f, f->buffer, f->pending);
+    f->pending = 0;
+}
+
+static void flushOutput() {
+    flush(&Output);
+}
+
+// Regular files are mapped whole; pipes and terminals fall back to reads.
+static void mapInput(File* f) {
+    struct stat st;
+    if (fstat(f->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, f->fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            f->map = static_cast<const char*>(p);
+            f->mapSize = st.st_size;
+            f->pos = f->map;
+            f->end = f->map + st.st_size;
+        }
+    }
+}
+
+static void openConsole(File* f, int fd) {
+    f->fd = fd;
+    f->writing = fd == 1;
+    if (f->writing) {
+        atexit(flushOutput);
+    } else {
+        mapInput(f);
+    }
+}
+
+static File* lookup(Text* t, bool writing) {
+    if (!t) {
+        File* f = writing ? &Output : &Input;
+        if (f->fd < 0) {
+            openConsole(f, writing ? 1 : 0);
+        }
+        return f;
+    }
+    if (!t->file || t->file->fd < 0 || t->file->writing != writing) {
+        ioError(writing ? "File not open for writing" : "File not open for reading", t->file ? t->file->path : nullptr, 103);
+    }
+    return t->file;
+}
+
+static const char* findNewline(const char* p, const char* end) {
+    Bytes16 nl;
+    for (int i = 0; i < 16; i++) {
+        nl[i] = '\n';
+    }
+    for (; p + 16 <= end; p += 16) {
+        Bytes16 v;
+        memcpy(&v, p, sizeof(v));
+        Bytes16 match = (Bytes16)(v == nl);
+        uint64_t words[2];
+        memcpy(words, &match, sizeof(words));
+        if (words[0]) {
+            return p + __builtin_ctzll(words[0]) / 8;
+        }
+        if (words[1]) {
+            return p + 8 + __builtin_ctzll(words[1]) / 8;
+        }
+    }
+    for (; p < end; p++) {
+        if (*p == '\n') {
+            return p;
+        }
+    }
+    return end;
+}
+
+// Moves the unread bytes to the front of the buffer and reads once more after
+// them, growing the buffer when one line fills all of it. Returns false at the
+// end of the input.
+static bool refill(File* f) {
+    if (f->map || f->exhausted) {
+        return false;
+    }
+    if (f == &Input) {
+        flush(&Output);
+    }
+    size_t unread = f->end - f->pos;
+    if (unread == f->capacity) {
+        size_t capacity = f->capacity ? f->capacity * 2 : BufferSize;
+        char* buffer = static_cast<char*>(aligned_alloc(PageSize, capacity));
+        if (unread) {
+            memcpy(buffer, f->pos, unread);
+        }
+        free(f->buffer);
+        f->buffer = buffer;
+        f->capacity = capacity;
+    } else {
+        memmove(f->buffer, f->pos, unread);
+    }
+    f->pos = f->buffer;
+    f->end = f->buffer + unread;
+    f->eol = nullptr;
+
+    ssize_t n = read(f->fd, f->buffer + unread, f->capacity - unread);
+    if (n <= 0) {
+        f->exhausted = true;
+        return false;
+    }
+    f->end += n;
+    return true;
+}
+
+// Returns the newline ending the current line, or the end of the input.
+static const char* lineEnd(File* f) {
+    if (f->eol) {
+        return f->eol;
+    }
+    const char* from = f->pos;
+    for (;;) {
+        const char* nl = findNewline(from, f->end);
+        if (nl != f->end) {
+            return f->eol = nl;
+        }
+        size_t scanned = f->end - f->pos;
+        if (!refill(f)) {
+            return f->eol = f->end;
+        }
+        from = f->pos + scanned;
+    }
+}
+
+static void release(File* f) {
+    if (f->writing) {
+        flush(f);
+    }
+    if (f->map) {
+        munmap(const_cast<char*>(f->map), f->mapSize);
+    }
+    if (f->fd >= 0) {
+        close(f->fd);
+    }
+    free(f->buffer);
+    char* path = f->path;
+    *f = File();
+    f->path = path;
+}
+
+extern "C" void __pascal_file_assign(Text* t, const PascalString* name) {
+    IoGuard guard(IoLock);
+    if (!t->file) {
+        t->file = new File();
+    }
+    release(t->file);
+    int64_t len = __pascal_str_length(name);
+    free(t->file->path);
+    t->file->path = static_cast<char*>(malloc(len + 1));
+    memcpy(t->file->path, __pascal_str_chars(name), len);
+    t->file->path[len] = '\0';
+}
+
+extern "C" void __pascal_file_reset(Text* t) {
+    IoGuard guard(IoLock);
+    if (!t->file) {
+        ioError("File not assigned", nullptr, 102);
+    }
+    File* f = t->file;
+    release(f);
+    f->fd = open(f->path, O_RDONLY);
+    if (f->fd < 0) {
+        ioError("Cannot open", f->path, 2);
+    }
+    mapInput(f);
+}
+
+extern "C" void __pascal_file_rewrite(Text* t) {
+    IoGuard guard(IoLock);
+    if (!t->file) {
+        ioError("File not assigned", nullptr, 102);
+    }
+    File* f = t->file;
+    release(f);
+    f->fd = open(f->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (f->fd < 0) {
+        ioError("Cannot create", f->path, 5);
+    }
+    f->writing = true;
+    f->buffer = static_cast<char*>(aligned_alloc(PageSize, BufferSize));
+    f->capacity = BufferSize;
+}
+
+extern "C" void __pascal_file_close(Text* t) {
+    IoGuard guard(IoLock);
+    if (t->file) {
+        release(t->file);
+    }
+}
+
+// Text variables are freed, and closed if still open, at the end of their routine.
+extern "C" void __pascal_file_free(Text* t) {
+    IoGuard guard(IoLock);
+    if (t->file) {
+        release(t->file);
+        free(t->file->path);
+        delete t->file;
+        t->file = nullptr;
+    }
+}
+
+extern "C" bool __pascal_file_eof(Text* t) {
+    IoGuard guard(IoLock);
+    File* f = lookup(t, false);
+    return f->pos == f->end && !refill(f);
+}
+
+// Numbers may be separated by blanks or commas, but never continue onto the
+// next line; a missing or malformed field reads as 0.
+extern "C" double __pascal_file_read_real(Text* t) {
+    IoGuard guard(IoLock);
+    File* f = lookup(t, false);
+    const char* eol = lineEnd(f);
+    const char* p = f->pos;
+    while (p < eol && (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r')) {
+        p++;
+    }
+    if (p < eol && *p == '+') {
+        p++;
+    }
+    double value = 0.0;
+    std::from_chars_result r = std::from_chars(p, eol, value);
+    if (r.ec != std::errc()) {
+        value = 0.0;
+        while (r.ptr < eol && *r.ptr != ' ' && *r.ptr != '\t' && *r.ptr != ',') {
+            r.ptr++;
+        }
+    }
+    f->pos = r.ptr;
+    return value;
+}
+
+extern "C" char __pascal_file_read_char(Text* t) {
+    IoGuard guard(IoLock);
+    File* f = lookup(t, false);
+    const char* eol = lineEnd(f);
+    return f->pos < eol ? *f->pos++ : ' ';
+}
+
+// A string takes the rest of the line, without a trailing carriage return.
+extern "C" void __pascal_file_read_str(Text* t, PascalString* s) {
+    IoGuard guard(IoLock);
+    File* f = lookup(t, false);
+    const char* eol = lineEnd(f);
+    const char* last = eol;
+    if (last > f->pos && last[-1] == '\r') {
+        last--;
+    }
+    __pascal_str_set(s, f->pos, last - f->pos);
+    f->pos = eol;
+}
+
+extern "C" void __pascal_file_readln(Text* t) {
+    IoGuard guard(IoLock);
+    File* f = lookup(t, false);
+    const char* eol = lineEnd(f);
+    f->pos = eol < f->end ? eol + 1 : eol;
+    f->eol = nullptr;
+}
+
+static char* reserve(File* f, size_t n) {
+    if (f->capacity == 0) {
+        f->buffer = static_cast<char*>(aligned_alloc(PageSize, BufferSize));
+        f->capacity = BufferSize;
+    }
+    if (f->pending + n > f->capacity) {
+        flush(f);
+    }
+    return f->buffer + f->pending;
+}
+
+// Anything larger than the buffer is written straight through.
+static void put(File* f, const char* p, size_t n) {
+    if (n > BufferSize) {
+        flush(f);
+        writeAll(f, p, n);
+        return;
+    }
+    memcpy(reserve(f, n), p, n);
+    f->pending += n;
+}
+
+// Whole numbers are written as integers, other reals in their shortest
+// round-trip form.
+extern "C" void __pascal_file_write_real(Text* t, double v) {
+    IoGuard guard(IoLock);
+    File* f = lookup(t, true);
+    char* p = reserve(f, 32);
+    if (v > -1e15 && v < 1e15 && v == static_cast<double>(static_cast<int64_t>(v))) {
+        f->pending += std::to_chars(p, p + 32, static_cast<int64_t>(v)).ptr - p;
+    } else {
+        f->pending += std::to_chars(p, p + 32, v).ptr - p;
+    }
+}
+
+extern "C" void __pascal_file_write_single(Text* t, float v) {
+    IoGuard guard(IoLock);
+    File* f = lookup(t, true);
+    char* p = reserve(f, 32);
+    f->pending += std::to_chars(p, p + 32, v).ptr - p;
+}
+
+extern "C" void __pascal_file_write_char(Text* t, char c) {
+    IoGuard guard(IoLock);
+    put(lookup(t, true), &c, 1);
+}
+
+extern "C" void __pascal_file_write_bool(Text* t, bool b) {
+    IoGuard guard(IoLock);
+    put(lookup(t, true), b ? "TRUE" : "FALSE", b ? 4 : 5);
+}
+
+extern "C" void __pascal_file_write_str(Text* t, const PascalString* s) {
+    IoGuard guard(IoLock);
+    put(lookup(t, true), __pascal_str_chars(s), __pascal_str_length(s));
+}
+
+extern "C" void __pascal_file_writeln(Text* t) {
+    IoGuard guard(IoLock);
+    put(lookup(t, true), "\n", 1);
+}
+
+extern "C" void __pascal_file_lock() {
+    IoLock.lock();
+}
+
+extern "C" void __pascal_file_unlock() {
+    IoLock.unlock();
+}
@@ -0,0 +1,303 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// new and dispose both pass the size of the pointee type, so blocks need no
+// header: the size picks one of the classes below, each with its own free list.
+// Freed blocks go to a thread-local list first and move to a shared depot in
+// batches. Blocks over the largest class go straight to malloc.
+static const size_t SizeClasses[] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024 };
+static const int ClassCount = sizeof(SizeClasses) / sizeof(SizeClasses[0]);
+static const size_t SlabSize = 64 * 1024;
+static const int CacheLimit = 256;
+static const int BatchSize = 64;
+static const size_t ArenaChunkSize = 1024 * 1024;
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct FreeList {
+    FreeBlock* head = nullptr;
+    int count = 0;
+};
+
+struct HeapStats {
+    uint64_t allocs[ClassCount + 1] = {};
+    uint64_t frees[ClassCount + 1] = {};
+    uint64_t arenaAllocs = 0;
+    uint64_t arenaBytes = 0;
+    uint64_t slabs = 0;
+};
+
+static std::mutex DepotLock;
+static FreeList Depot[ClassCount];
+static HeapStats ExitedThreads;
+static std::vector<HeapStats*> LiveThreads;
+
+// Between mark and release, new bumps through arena chunks and dispose is a no-op;
+// release drops everything allocated since the matching mark at once.
+struct Arena {
+    std::vector<char*> chunks;
+    size_t current = 0;
+    size_t offset = 0;
+    std::vector<char*> marks;
+
+    bool owns(void* p) const {
+        for (char* c : chunks) {
+            if (p >= c && p < c + ArenaChunkSize) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+struct ThreadCache {
+    FreeList lists[ClassCount];
+    HeapStats stats;
+    Arena arena;
+
+    ThreadCache() {
+        std::lock_guard<std::mutex> guard(DepotLock);
+        LiveThreads.push_back(&stats);
+    }
+
+    ~ThreadCache() {
+        std::lock_guard<std::mutex> guard(DepotLock);
+        for (int c = 0; c < ClassCount; c++) {
+            while (FreeBlock* b = lists[c].head) {
+                lists[c].head = b->next;
+                b->next = Depot[c].head;
+                Depot[c].head = b;
+                Depot[c].count++;
+            }
+        }
+        for (int c = 0; c <= ClassCount; c++) {
+            ExitedThreads.allocs[c] += stats.allocs[c];
+            ExitedThreads.frees[c] += stats.frees[c];
+        }
+        ExitedThreads.arenaAllocs += stats.arenaAllocs;
+        ExitedThreads.arenaBytes += stats.arenaBytes;
+        ExitedThreads.slabs += stats.slabs;
+        for (size_t i = 0; i < LiveThreads.size(); i++) {
+            if (LiveThreads[i] == &stats) {
+                LiveThreads.erase(LiveThreads.begin() + i);
+                break;
+            }
+        }
+        for (char* c : arena.chunks) {
+            free(c);
+        }
+    }
+};
+
+static thread_local ThreadCache Cache;
+
+static int sizeClass(size_t size) {
+    for (int c = 0; c < ClassCount; c++) {
+        if (size <= SizeClasses[c]) {
+            return c;
+        }
+    }
+    return ClassCount;
+}
+
+// Refills an empty thread-local list from the depot, or carves a new slab.
+static void refill(int c) {
+    FreeList& list = Cache.lists[c];
+    {
+        std::lock_guard<std::mutex> guard(DepotLock);
+        while (Depot[c].head && list.count < BatchSize) {
+            FreeBlock* b = Depot[c].head;
+            Depot[c].head = b->next;
+            Depot[c].count--;
+            b->next = list.head;
+            list.head = b;
+            list.count++;
+        }
+    }
+    if (list.head) {
+        return;
+    }
+
+    size_t size = SizeClasses[c];
+    char* slab = static_cast<char*>(malloc(SlabSize));
+    Cache.stats.slabs++;
+    for (size_t off = SlabSize / size * size; off >= size; off -= size) {
+        FreeBlock* b = reinterpret_cast<FreeBlock*>(slab + off - size);
+        b->next = list.head;
+        list.head = b;
+        list.count++;
+    }
+}
+
+static void* arenaAlloc(size_t size) {
+    Arena& a = Cache.arena;
+    size = (size + 15) & ~size_t(15);
+    if (size > ArenaChunkSize) {
+        return nullptr;
+    }
+    if (a.chunks.empty() || a.offset + size > ArenaChunkSize) {
+        if (!a.chunks.empty()) {
+            a.current++;
+        }
+        if (a.current == a.chunks.size()) {
+            a.chunks.push_back(static_cast<char*>(malloc(ArenaChunkSize)));
+        }
+        a.offset = 0;
+    }
+    void* p = a.chunks[a.current] + a.offset;
+    a.offset += size;
+    Cache.stats.arenaAllocs++;
+    Cache.stats.arenaBytes += size;
+    return p;
+}
+
+extern "C" void* __pascal_new(int64_t size) {
+    if (!Cache.arena.marks.empty()) {
+        if (void* p = arenaAlloc(size)) {
+            return p;
+        }
+    }
+
+    int c = sizeClass(size);
+    Cache.stats.allocs[c]++;
+    if (c == ClassCount) {
+        return malloc(size);
+    }
+
+    FreeList& list = Cache.lists[c];
+    if (!list.head) {
+        refill(c);
+    }
+    FreeBlock* b = list.head;
+    list.head = b->next;
+    list.count--;
+    return b;
+}
+
+extern "C" void __pascal_dispose(void* p, int64_t size) {
+    if (!p || (!Cache.arena.marks.empty() && Cache.arena.owns(p))) {
+        return;
+    }
+
+    int c = sizeClass(size);
+    Cache.stats.frees[c]++;
+    if (c == ClassCount) {
+        free(p);
+        return;
+    }
+
+    FreeList& list = Cache.lists[c];
+    FreeBlock* b = static_cast<FreeBlock*>(p);
+    b->next = list.head;
+    list.head = b;
+    list.count++;
+
+    if (list.count > CacheLimit) {
+        std::lock_guard<std::mutex> guard(DepotLock);
+        for (int i = 0; i < BatchSize; i++) {
+            FreeBlock* moved = list.head;
+            list.head = moved->next;
+            list.count--;
+            moved->next = Depot[c].head;
+            Depot[c].head = moved;
+            Depot[c].count++;
+        }
+    }
+}
+
+extern "C" void* __pascal_mark() {
+    Arena& a = Cache.arena;
+    char* position = a.chunks.empty() ? nullptr : a.chunks[a.current] + a.offset;
+    a.marks.push_back(position);
+    return position;
+}
+
+extern "C" void __pascal_release(void* mark) {
+    Arena& a = Cache.arena;
+    while (!a.marks.empty()) {
+        char* position = a.marks.back();
+        a.marks.pop_back();
+        if (position == mark) {
+            break;
+        }
+    }
+
+    if (!mark) {
+        a.current = 0;
+        a.offset = 0;
+        return;
+    }
+    for (size_t i = 0; i < a.chunks.size(); i++) {
+        if (mark >= a.chunks[i] && mark <= a.chunks[i] + ArenaChunkSize) {
+            a.current = i;
+            a.offset = static_cast<char*>(mark) - a.chunks[i];
+            return;
+        }
+    }
+}
+
+extern "C" void __pascal_heap_stats() {
+    HeapStats total;
+    {
+        std::lock_guard<std::mutex> guard(DepotLock);
+        total = ExitedThreads;
+        for (HeapStats* s : LiveThreads) {
+            for (int c = 0; c <= ClassCount; c++) {
+                total.allocs[c] += s->allocs[c];
+                total.frees[c] += s->frees[c];
+            }
+            total.arenaAllocs += s->arenaAllocs;
+            total.arenaBytes += s->arenaBytes;
+            total.slabs += s->slabs;
+        }
+    }
+
+    fprintf(stderr, "Heap: %llu slabs of %zu bytes\n", (unsigned long long)total.slabs, SlabSize);
+    for (int c = 0; c <= ClassCount; c++) {
+        if (!total.allocs[c] && !total.frees[c]) {
+            continue;
+        }
+        if (c == ClassCount) {
+            fprintf(stderr, "  >%zu: %llu new, %llu dispose\n", SizeClasses[ClassCount - 1], (unsigned long long)total.allocs[c], (unsigned long long)total.frees[c]);
+        } else {
+            fprintf(stderr, "  %zu: %llu new, %llu dispose\n", SizeClasses[c], (unsigned long long)total.allocs[c], (unsigned long long)total.frees[c]);
+        }
+    }
+    if (total.arenaAllocs) {
+        fprintf(stderr, "  arena: %llu new, %llu bytes\n", (unsigned long long)total.arenaAllocs, (unsigned long long)total.arenaBytes);
+    }
+}
+
+struct DynArray {
+    char* data;
+    int64_t length;
+    int64_t capacity;
+};
+
+// Growing past the capacity at least doubles it, so appending one element at a
+// time is amortized constant. New elements are zeroed; shrinking keeps the storage.
+extern "C" void __pascal_setlength(DynArray* a, int64_t length, int64_t elementSize) {
+    if (length < 0) {
+        length = 0;
+    }
+    if (length > a->capacity) {
+        int64_t capacity = a->capacity * 2 > length ? a->capacity * 2 : length;
+        a->data = static_cast<char*>(realloc(a->data, capacity * elementSize));
+        a->capacity = capacity;
+    }
+    if (length > a->length) {
+        memset(a->data + a->length * elementSize, 0, (length - a->length) * elementSize);
+    }
+    a->length = length;
+}
+
+extern "C" void __pascal_dynarray_free(DynArray* a) {
+    free(a->data);
+    memset(a, 0, sizeof(DynArray));
+}
@@ -0,0 +1,268 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Maps are open-addressing hash tables laid out like SwissTable. Each slot has a
+// control byte that is Empty, Deleted, or the low 7 bits of its key's hash. A
+// probe loads a group of 16 control bytes and compares them all at once against
+// those 7 bits, so keys are only compared on a likely match. Groups are aligned
+// and probed triangularly, which visits every group of a power-of-two table.
+// The key kind picks one of the instantiations at the bottom at compile time.
+
+struct PascalString {
+    uint64_t words[2];
+};
+
+extern "C" uint64_t __pascal_str_hash(const PascalString* s);
+extern "C" bool __pascal_str_equal(const PascalString* a, const PascalString* b);
+extern "C" void __pascal_str_retain(PascalString* s);
+extern "C" void __pascal_str_release(PascalString* s);
+extern "C" void __pascal_str_assign(PascalString* dst, const PascalString* src);
+
+struct Map {
+    int8_t* ctrl;
+    void* slots;
+    int64_t capacity;
+    int64_t size;
+    int64_t growthLeft;
+};
+
+static const int8_t Empty = -128;
+static const int8_t Deleted = -2;
+static const int64_t GroupSize = 16;
+
+typedef int8_t Ctrl16 __attribute__((vector_size(16)));
+
+static Ctrl16 splat(int8_t c) {
+    Ctrl16 v;
+    for (int i = 0; i < 16; i++) {
+        v[i] = c;
+    }
+    return v;
+}
+
+// One bit per lane whose top bit is set, like SSE2 movemask on any target.
+static uint32_t laneMask(Ctrl16 v) {
+    const uint64_t High = 0x8080808080808080ull;
+    const uint64_t Gather = 0x0002040810204081ull;
+    uint64_t words[2];
+    memcpy(words, &v, sizeof(words));
+    return static_cast<uint32_t>(((words[0] & High) * Gather) >> 56) | static_cast<uint32_t>(((words[1] & High) * Gather) >> 56) << 8;
+}
+
+static Ctrl16 loadGroup(const Map* m, int64_t g) {
+    Ctrl16 v;
+    memcpy(&v, m->ctrl + g * GroupSize, sizeof(v));
+    return v;
+}
+
+static uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 33);
+}
+
+struct IntKey {
+    typedef int64_t Type;
+    static uint64_t hash(int64_t k) { return mix(static_cast<uint64_t>(k)); }
+    static bool equal(int64_t a, int64_t b) { return a == b; }
+    static void retain(int64_t&) {}
+    static void release(int64_t&) {}
+};
+
+// -0.0 and 0.0 are equal, so they must hash alike.
+struct RealKey {
+    typedef double Type;
+    static uint64_t hash(double k) {
+        uint64_t bits;
+        k = k == 0.0 ? 0.0 : k;
+        memcpy(&bits, &k, sizeof(bits));
+        return mix(bits);
+    }
+    static bool equal(double a, double b) { return a == b; }
+    static void retain(double&) {}
+    static void release(double&) {}
+};
+
+struct StrKey {
+    typedef PascalString Type;
+    static uint64_t hash(const PascalString& k) { return mix(__pascal_str_hash(&k)); }
+    static bool equal(const PascalString& a, const PascalString& b) { return __pascal_str_equal(&a, &b); }
+    static void retain(PascalString& k) { __pascal_str_retain(&k); }
+    static void release(PascalString& k) { __pascal_str_release(&k); }
+};
+
+template <typename K>
+struct Slot {
+    typename K::Type key;
+    double value;
+};
+
+template <typename K>
+static Slot<K>* slots(const Map* m) {
+    return static_cast<Slot<K>*>(m->slots);
+}
+
+template <typename K>
+static int64_t find(const Map* m, const typename K::Type& key) {
+    if (m->capacity == 0) {
+        return -1;
+    }
+    uint64_t hash = K::hash(key);
+    int64_t mask = m->capacity / GroupSize - 1;
+    int64_t g = (hash >> 7) & mask;
+    Ctrl16 tag = splat(hash & 0x7F);
+    for (int64_t step = 1;; step++) {
+        Ctrl16 ctrl = loadGroup(m, g);
+        for (uint32_t bits = laneMask(ctrl == tag); bits; bits &= bits - 1) {
+            int64_t i = g * GroupSize + __builtin_ctz(bits);
+            if (K::equal(slots<K>(m)[i].key, key)) {
+                return i;
+            }
+        }
+        if (laneMask(ctrl == splat(Empty))) {
+            return -1;
+        }
+        g = (g + step) & mask;
+    }
+}
+
+// Empty and Deleted are the only control bytes with the top bit set.
+static int64_t findFree(const Map* m, uint64_t hash) {
+    int64_t mask = m->capacity / GroupSize - 1;
+    int64_t g = (hash >> 7) & mask;
+    for (int64_t step = 1;; step++) {
+        if (uint32_t bits = laneMask(loadGroup(m, g))) {
+            return g * GroupSize + __builtin_ctz(bits);
+        }
+        g = (g + step) & mask;
+    }
+}
+
+// Keeps at least an eighth of the slots Empty so every probe terminates.
+template <typename K>
+static void rehash(Map* m, int64_t capacity) {
+    Map old = *m;
+    m->ctrl = static_cast<int8_t*>(malloc(capacity));
+    m->slots = malloc(capacity * sizeof(Slot<K>));
+    m->capacity = capacity;
+    m->growthLeft = capacity - capacity / 8 - old.size;
+    memset(m->ctrl, Empty, capacity);
+    for (int64_t i = 0; i < old.capacity; i++) {
+        if (old.ctrl[i] < 0) {
+            continue;
+        }
+        int64_t j = findFree(m, K::hash(slots<K>(&old)[i].key));
+        m->ctrl[j] = old.ctrl[i];
+        memcpy(&slots<K>(m)[j], &slots<K>(&old)[i], sizeof(Slot<K>));
+    }
+    free(old.ctrl);
+    free(old.slots);
+}
+
+template <typename K>
+static Slot<K>* insert(Map* m, const typename K::Type& key) {
+    int64_t i = find<K>(m, key);
+    if (i >= 0) {
+        return &slots<K>(m)[i];
+    }
+    if (m->growthLeft == 0) {
+        // A table that is mostly tombstones is rebuilt at the same size.
+        int64_t capacity = m->capacity == 0 ? GroupSize : m->capacity;
+        rehash<K>(m, m->size >= capacity / 2 ? capacity * 2 : capacity);
+    }
+
+    uint64_t hash = K::hash(key);
+    i = findFree(m, hash);
+    if (m->ctrl[i] == Empty) {
+        m->growthLeft--;
+    }
+    m->ctrl[i] = hash & 0x7F;
+    m->size++;
+    Slot<K>* s = &slots<K>(m)[i];
+    s->key = key;
+    s->value = 0.0;
+    K::retain(s->key);
+    return s;
+}
+
+// A probe only moves past a group with no Empty slot, so if this group still
+// has one, nothing depends on the removed slot and it can become Empty again.
+template <typename K>
+static bool remove(Map* m, const typename K::Type& key) {
+    int64_t i = find<K>(m, key);
+    if (i < 0) {
+        return false;
+    }
+    K::release(slots<K>(m)[i].key);
+    if (laneMask(loadGroup(m, i / GroupSize) == splat(Empty))) {
+        m->ctrl[i] = Empty;
+        m->growthLeft++;
+    } else {
+        m->ctrl[i] = Deleted;
+    }
+    m->size--;
+    return true;
+}
+
+// Returns the next occupied slot at or after the cursor. Adding keys while
+// iterating may rehash the table, which can skip or repeat keys.
+template <typename K>
+static Slot<K>* next(const Map* m, int64_t* cursor) {
+    for (int64_t i = *cursor; i < m->capacity; i++) {
+        if (m->ctrl[i] >= 0) {
+            *cursor = i + 1;
+            return &slots<K>(m)[i];
+        }
+    }
+    *cursor = m->capacity;
+    return nullptr;
+}
+
+template <typename K>
+static void release(Map* m) {
+    for (int64_t i = 0; i < m->capacity; i++) {
+        if (m->ctrl[i] >= 0) {
+            K::release(slots<K>(m)[i].key);
+        }
+    }
+    free(m->ctrl);
+    free(m->slots);
+    memset(m, 0, sizeof(Map));
+}
+
+static void storeKey(int64_t* dst, const int64_t& key) { *dst = key; }
+static void storeKey(double* dst, const double& key) { *dst = key; }
+static void storeKey(PascalString* dst, const PascalString& key) { __pascal_str_assign(dst, &key); }
+
+// Integer and real keys are passed by value, string keys by pointer.
+#define MAP_FUNCTIONS(kind, K, Arg, KEY)                                                   \
+    extern "C" double __pascal_map_##kind##_get(const Map* m, Arg key) {                   \
+        int64_t i = find<K>(m, KEY);                                                      \
+        return i < 0 ? 0.0 : slots<K>(m)[i].value;                                        \
+    }                                                                                     \
+    extern "C" bool __pascal_map_##kind##_contains(const Map* m, Arg key) {                \
+        return find<K>(m, KEY) >= 0;                                                      \
+    }                                                                                     \
+    extern "C" void __pascal_map_##kind##_put(Map* m, Arg key, double value) {             \
+        insert<K>(m, KEY)->value = value;                                                 \
+    }                                                                                     \
+    extern "C" bool __pascal_map_##kind##_delete(Map* m, Arg key) {                        \
+        return remove<K>(m, KEY);                                                         \
+    }                                                                                     \
+    extern "C" bool __pascal_map_##kind##_next(const Map* m, int64_t* cursor, K::Type* key) { \
+        Slot<K>* s = next<K>(m, cursor);                                                  \
+        if (s) {                                                                          \
+            storeKey(key, s->key);                                                        \
+        }                                                                                 \
+        return s != nullptr;                                                              \
+    }                                                                                     \
+    extern "C" void __pascal_map_##kind##_free(Map* m) {                                   \
+        release<K>(m);                                                                    \
+    }
+
+MAP_FUNCTIONS(int, IntKey, int64_t, key)
+MAP_FUNCTIONS(real, RealKey, double, key)
+MAP_FUNCTIONS(str, StrKey, const PascalString*, *key)
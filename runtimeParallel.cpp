@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// {$PARALLEL} loops are outlined into a function that runs iteration numbers
+// [lo, hi). The calling thread and the pool's workers each start on one
+// contiguous block of the iteration space and take chunks from its front; a
+// thread whose block runs out steals the back half of another's. Dynamic loops
+// hand out chunks from one shared counter instead. PASCAL_THREADS sets the number
+// of threads, which defaults to the number of cores.
+
+typedef void (*LoopBody)(void* ctx, int64_t lo, int64_t hi);
+
+struct alignas(64) Block {
+    std::mutex lock;
+    int64_t lo = 0;
+    int64_t hi = 0;
+};
+
+struct Loop {
+    LoopBody body;
+    void* ctx;
+    int64_t n;
+    int64_t chunk;
+    bool dynamic;
+    alignas(64) int64_t next;
+};
+
+// Never destroyed: the workers are still waiting on wake when the program exits.
+struct Pool {
+    std::mutex lock;
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    int running = 0;
+};
+
+static Pool& ThePool = *new Pool();
+static Block* Blocks = nullptr;
+static int Threads = 0;
+static Loop Current;
+
+// Set on pool threads and on the caller while a loop runs, so nested loops run
+// sequentially on the thread that reaches them.
+static thread_local bool InLoop = false;
+
+static bool take(int self, int64_t& lo, int64_t& hi) {
+    Block& b = Blocks[self];
+    std::lock_guard<std::mutex> guard(b.lock);
+    if (b.lo >= b.hi) {
+        return false;
+    }
+    lo = b.lo;
+    hi = std::min(b.lo + Current.chunk, b.hi);
+    b.lo = hi;
+    return true;
+}
+
+// A victim with no more than one chunk left gives it up whole.
+static bool steal(int self, int64_t& lo, int64_t& hi) {
+    for (int i = 1; i < Threads; i++) {
+        Block& victim = Blocks[(self + i) % Threads];
+        int64_t from, to;
+        {
+            std::lock_guard<std::mutex> guard(victim.lock);
+            int64_t left = victim.hi - victim.lo;
+            if (left <= 0) {
+                continue;
+            }
+            from = left > Current.chunk ? victim.lo + left / 2 : victim.lo;
+            to = victim.hi;
+            victim.hi = from;
+        }
+        {
+            std::lock_guard<std::mutex> guard(Blocks[self].lock);
+            Blocks[self].lo = from;
+            Blocks[self].hi = to;
+        }
+        return take(self, lo, hi);
+    }
+    return false;
+}
+
+static void runChunks(int self) {
+    Loop& loop = Current;
+    if (loop.dynamic) {
+        for (;;) {
+            int64_t lo = __atomic_fetch_add(&loop.next, loop.chunk, __ATOMIC_RELAXED);
+            if (lo >= loop.n) {
+                return;
+            }
+            loop.body(loop.ctx, lo, std::min(lo + loop.chunk, loop.n));
+        }
+    }
+    int64_t lo, hi;
+    while (take(self, lo, hi) || steal(self, lo, hi)) {
+        loop.body(loop.ctx, lo, hi);
+    }
+}
+
+static void worker(int self) {
+    InLoop = true;
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(ThePool.wakeLock);
+            ThePool.wake.wait(guard, [&] { return ThePool.generation != seen; });
+            seen = ThePool.generation;
+        }
+        runChunks(self);
+        std::lock_guard<std::mutex> guard(ThePool.wakeLock);
+        if (--ThePool.running == 0) {
+            ThePool.done.notify_one();
+        }
+    }
+}
+
+// Workers are started on the first parallel loop and live until the program exits.
+static void startPool() {
+    if (Threads) {
+        return;
+    }
+    const char* env = getenv("PASCAL_THREADS");
+    Threads = env ? atoi(env) : static_cast<int>(std::thread::hardware_concurrency());
+    Threads = std::max(Threads, 1);
+    Blocks = new Block[Threads];
+    for (int i = 1; i < Threads; i++) {
+        std::thread(worker, i).detach();
+    }
+}
+
+// Without a chunk size, static loops split each block into eight chunks to
+// leave something to steal, and dynamic loops hand out one iteration at a time.
+extern "C" void __pascal_parallel_for(LoopBody body, void* ctx, int64_t n, int64_t chunk, bool dynamic) {
+    if (n <= 0) {
+        return;
+    }
+    if (InLoop) {
+        body(ctx, 0, n);
+        return;
+    }
+    std::unique_lock<std::mutex> pool(ThePool.lock, std::try_to_lock);
+    if (pool.owns_lock()) {
+        startPool();
+    }
+    if (!pool.owns_lock() || Threads == 1) {
+        body(ctx, 0, n);
+        return;
+    }
+
+    Current.body = body;
+    Current.ctx = ctx;
+    Current.n = n;
+    Current.dynamic = dynamic;
+    Current.next = 0;
+    Current.chunk = chunk > 0 ? chunk : dynamic ? 1 : std::max<int64_t>(1, n / (Threads * 8));
+    int64_t start = 0;
+    for (int i = 0; i < Threads; i++) {
+        int64_t size = n / Threads + (i < n % Threads);
+        std::lock_guard<std::mutex> guard(Blocks[i].lock);
+        Blocks[i].lo = start;
+        Blocks[i].hi = start + size;
+        start += size;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(ThePool.wakeLock);
+        ThePool.generation++;
+        ThePool.running = Threads - 1;
+    }
+    ThePool.wake.notify_all();
+    InLoop = true;
+    runChunks(0);
+    InLoop = false;
+    std::unique_lock<std::mutex> guard(ThePool.wakeLock);
+    ThePool.done.wait(guard, [] { return ThePool.running == 0; });
+}
+
+// Each range folds its partial result into the shared variable once it is done.
+template <typename T>
+static void reduce(T* target, T value, int32_t op) {
+    T old, next;
+    __atomic_load(target, &old, __ATOMIC_RELAXED);
+    do {
+        next = op == 0 ? old + value : op == 1 ? std::min(old, value) : std::max(old, value);
+    } while (!__atomic_compare_exchange(target, &old, &next, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+extern "C" void __pascal_reduce_f64(double* target, double value, int32_t op) { reduce(target, value, op); }
+extern "C" void __pascal_reduce_f32(float* target, float value, int32_t op) { reduce(target, value, op); }
+
+// spawn runs a procedure call as a task on a second pool. Tasks may wait on
+// channels for each other, so a task never waits for a thread: an idle thread
+// takes it if there is one, otherwise a new thread is started. Threads stay
+// around for later tasks.
+struct Task {
+    void (*thunk)(void*);
+    void* args;
+};
+
+struct Spawner {
+    std::mutex lock;
+    std::condition_variable work;
+    std::condition_variable finished;
+    std::deque<Task> queue;
+    size_t idle = 0;
+    int64_t pending = 0;
+};
+
+static Spawner& TheSpawner = *new Spawner();
+
+static void taskWorker() {
+    Spawner& s = TheSpawner;
+    std::unique_lock<std::mutex> guard(s.lock);
+    for (;;) {
+        while (s.queue.empty()) {
+            s.idle++;
+            s.work.wait(guard);
+            s.idle--;
+        }
+        Task task = s.queue.front();
+        s.queue.pop_front();
+        guard.unlock();
+        task.thunk(task.args);
+        free(task.args);
+        guard.lock();
+        if (--s.pending == 0) {
+            s.finished.notify_all();
+        }
+    }
+}
+
+// The arguments are copied, so the caller's block may go out of scope.
+extern "C" void __pascal_spawn(void (*thunk)(void*), const void* args, int64_t size) {
+    Spawner& s = TheSpawner;
+    void* copy = malloc(size > 0 ? size : 1);
+    memcpy(copy, args, size);
+    std::lock_guard<std::mutex> guard(s.lock);
+    s.queue.push_back(Task{ thunk, copy });
+    s.pending++;
+    if (s.idle >= s.queue.size()) {
+        s.work.notify_one();
+    } else {
+        std::thread(taskWorker).detach();
+    }
+}
+
+// The program waits for every spawned call before it exits.
+extern "C" void __pascal_spawn_wait() {
+    Spawner& s = TheSpawner;
+    std::unique_lock<std::mutex> guard(s.lock);
+    s.finished.wait(guard, [&] { return s.pending == 0; });
+}
@@ -0,0 +1,246 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Strings are 16 bytes: up to 15 characters inline with the length in the last
+// byte, or a pointer to a reference-counted heap buffer with the tag set to
+// HeapTag. Unused inline bytes are always zero so short strings compare as two words.
+// Buffers with a negative count are literals emitted by the compiler and never freed.
+struct StringBuffer {
+    int64_t refs;
+    uint32_t capacity;
+    char data[];
+};
+
+struct PascalString {
+    union {
+        struct {
+            char chars[15];
+            uint8_t tag;
+        } small;
+        struct {
+            StringBuffer* buf;
+            uint32_t len;
+            char pad[3];
+            uint8_t tag;
+        } heap;
+    };
+};
+
+static_assert(sizeof(PascalString) == 16, "strings are lowered as { i64, i64 }");
+
+static const uint8_t HeapTag = 0xFF;
+static const uint32_t SmallMax = 15;
+
+typedef uint8_t Bytes16 __attribute__((vector_size(16)));
+
+static bool isHeap(const PascalString* s) {
+    return s->small.tag == HeapTag;
+}
+
+static uint32_t length(const PascalString* s) {
+    return isHeap(s) ? s->heap.len : s->small.tag;
+}
+
+static const char* chars(const PascalString* s) {
+    return isHeap(s) ? s->heap.buf->data : s->small.chars;
+}
+
+static StringBuffer* allocate(uint32_t capacity) {
+    StringBuffer* buf = static_cast<StringBuffer*>(malloc(sizeof(StringBuffer) + capacity));
+    buf->refs = 1;
+    buf->capacity = capacity;
+    return buf;
+}
+
+static void release(PascalString* s) {
+    if (isHeap(s) && s->heap.buf->refs > 0 && --s->heap.buf->refs == 0) {
+        free(s->heap.buf);
+    }
+    memset(s, 0, sizeof(PascalString));
+}
+
+// Makes an empty string of len characters and returns its writable storage.
+static char* reserve(PascalString* s, uint32_t len, uint32_t capacity) {
+    memset(s, 0, sizeof(PascalString));
+    if (len <= SmallMax) {
+        s->small.tag = len;
+        return s->small.chars;
+    }
+    s->heap.buf = allocate(capacity);
+    s->heap.len = len;
+    s->heap.tag = HeapTag;
+    return s->heap.buf->data;
+}
+
+extern "C" void __pascal_str_release(PascalString* s) {
+    release(s);
+}
+
+extern "C" void __pascal_str_retain(PascalString* s) {
+    if (isHeap(s) && s->heap.buf->refs > 0) {
+        s->heap.buf->refs++;
+    }
+}
+
+// Assignment shares the buffer; it is only copied when one side appends to it.
+extern "C" void __pascal_str_assign(PascalString* dst, const PascalString* src) {
+    if (dst == src) {
+        return;
+    }
+    PascalString copy = *src;
+    __pascal_str_retain(&copy);
+    release(dst);
+    *dst = copy;
+}
+
+extern "C" void __pascal_str_move(PascalString* dst, PascalString* src) {
+    release(dst);
+    *dst = *src;
+    memset(src, 0, sizeof(PascalString));
+}
+
+extern "C" void __pascal_str_from_char(PascalString* dst, char c) {
+    release(dst);
+    dst->small.chars[0] = c;
+    dst->small.tag = 1;
+}
+
+extern "C" void __pascal_str_concat(PascalString* dst, const PascalString* a, const PascalString* b) {
+    uint32_t la = length(a);
+    uint32_t lb = length(b);
+    PascalString result;
+    char* p = reserve(&result, la + lb, la + lb);
+    memcpy(p, chars(a), la);
+    memcpy(p + la, chars(b), lb);
+    release(dst);
+    *dst = result;
+}
+
+// s := s + t appends in place when s owns its buffer, growing it by doubling.
+extern "C" void __pascal_str_append(PascalString* dst, const PascalString* src) {
+    uint32_t ld = length(dst);
+    uint32_t ls = length(src);
+    uint32_t len = ld + ls;
+
+    if (len <= SmallMax) {
+        memmove(dst->small.chars + ld, chars(src), ls);
+        dst->small.tag = len;
+        return;
+    }
+
+    if (isHeap(dst) && dst->heap.buf->refs == 1 && dst->heap.buf->capacity >= len) {
+        memmove(dst->heap.buf->data + ld, chars(src), ls);
+        dst->heap.len = len;
+        return;
+    }
+
+    uint32_t capacity = ld * 2 > len ? ld * 2 : len;
+    PascalString result;
+    char* p = reserve(&result, len, capacity);
+    memcpy(p, chars(dst), ld);
+    memcpy(p + ld, chars(src), ls);
+    release(dst);
+    *dst = result;
+}
+
+extern "C" int64_t __pascal_str_length(const PascalString* s) {
+    return length(s);
+}
+
+// Used by the file runtime to read into and write from strings.
+extern "C" const char* __pascal_str_chars(const PascalString* s) {
+    return chars(s);
+}
+
+extern "C" void __pascal_str_set(PascalString* dst, const char* p, int64_t len) {
+    PascalString result;
+    memcpy(reserve(&result, len, len), p, len);
+    release(dst);
+    *dst = result;
+}
+
+extern "C" bool __pascal_str_equal(const PascalString* a, const PascalString* b) {
+    if (!isHeap(a) && !isHeap(b)) {
+        Bytes16 va, vb;
+        memcpy(&va, a, sizeof(va));
+        memcpy(&vb, b, sizeof(vb));
+        Bytes16 diff = va ^ vb;
+        uint64_t words[2];
+        memcpy(words, &diff, sizeof(words));
+        return (words[0] | words[1]) == 0;
+    }
+    uint32_t len = length(a);
+    if (len != length(b)) {
+        return false;
+    }
+    return chars(a) == chars(b) || memcmp(chars(a), chars(b), len) == 0;
+}
+
+// FNV-1a over the characters; maps mix the result further before using it.
+extern "C" uint64_t __pascal_str_hash(const PascalString* s) {
+    uint32_t len = length(s);
+    const char* p = chars(s);
+    uint64_t h = 14695981039346656037ull;
+    for (uint32_t i = 0; i < len; i++) {
+        h = (h ^ static_cast<uint8_t>(p[i])) * 1099511628211ull;
+    }
+    return h;
+}
+
+extern "C" int32_t __pascal_str_compare(const PascalString* a, const PascalString* b) {
+    uint32_t la = length(a);
+    uint32_t lb = length(b);
+    int c = memcmp(chars(a), chars(b), la < lb ? la : lb);
+    if (c != 0) {
+        return c < 0 ? -1 : 1;
+    }
+    return (la > lb) - (la < lb);
+}
+
+// Returns the 1-based position of needle in haystack, or 0. Candidates are found
+// 16 at a time by matching the first and last character of the needle.
+extern "C" int64_t __pascal_str_pos(const PascalString* needle, const PascalString* haystack) {
+    uint32_t m = length(needle);
+    uint32_t n = length(haystack);
+    const char* s = chars(haystack);
+    const char* p = chars(needle);
+    if (m == 0) {
+        return 1;
+    }
+    if (m > n) {
+        return 0;
+    }
+
+    Bytes16 first, last;
+    for (int i = 0; i < 16; i++) {
+        first[i] = p[0];
+        last[i] = p[m - 1];
+    }
+
+    uint32_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        Bytes16 a, b;
+        memcpy(&a, s + i, sizeof(a));
+        memcpy(&b, s + i + m - 1, sizeof(b));
+        Bytes16 match = (Bytes16)((a == first) & (b == last));
+        uint64_t words[2];
+        memcpy(words, &match, sizeof(words));
+        for (int w = 0; w < 2; w++) {
+            while (words[w]) {
+                uint32_t lane = w * 8 + __builtin_ctzll(words[w]) / 8;
+                if (memcmp(s + i + lane, p, m) == 0) {
+                    return i + lane + 1;
+                }
+                words[w] &= ~(0xFFull << ((lane - w * 8) * 8));
+            }
+        }
+    }
+
+    for (; i + m <= n; i++) {
+        if (s[i] == p[0] && memcmp(s + i, p, m) == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
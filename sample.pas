@@ -20,6 +20,9 @@ type
 var
   person1: TPerson;
   person2: TPerson;
+  distance: Real;
+  name: TName;
+  location: Integer;
 
 // Function to calculate the distance between two points
 function CalculateDistance(p1, p2: Integer): Real;
@@ -28,20 +31,20 @@ begin
 end;
 
 // Procedure to print details about a person
-procedure PrintPersonDetails(person: TPerson);
+procedure PrintPersonDetails(const person: TPerson);
 begin
   WriteLn('Name: ', person.name);
   WriteLn('Age: ', person.age);
   WriteLn('Location: (', person.locationx, ', ', person.locationy, ')');
 end;
 
-procedure UpdateAge(person: TPerson; newAge: Integer);
+procedure UpdateAge(var person: TPerson; newAge: Integer);
 begin
   person.age := newAge;
 end;
 
 // Procedure to move a person to a new location
-procedure MovePerson(person: TPerson; newX, newY: Integer);
+procedure MovePerson(var person: TPerson; newX, newY: Integer);
 begin
   person.locationx := newX;
   person.locationy := newY;
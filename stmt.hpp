@@ -7,6 +7,7 @@
 
 struct Stmt : public Ast {
     virtual ~Stmt() = default;
+    virtual llvm::Value* accept(AstVisitor& visitor) = 0;
 };
 
 struct ExprStmt : public Stmt {
@@ -14,8 +15,8 @@ struct ExprStmt : public Stmt {
 
     ExprStmt(std::unique_ptr<Expr> expr) : expr(std::move(expr)) {};
     ExprStmt(ExprStmt&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -25,8 +26,8 @@ struct CallStmt : public Stmt {
 
     CallStmt(const std::string &callee, std::vector<std::unique_ptr<Expr>> args) : callee(callee), args(std::move(args)) {};
     CallStmt(CallStmt&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -36,8 +37,8 @@ struct AssignStmt : public Stmt {
 
     AssignStmt(std::unique_ptr<Expr> name, std::unique_ptr<Expr> value) : name(std::move(name)), value(std::move(value)) {};
     AssignStmt(AssignStmt&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -46,8 +47,8 @@ struct CompoundStmt : public Stmt {
 
     CompoundStmt(std::vector<std::unique_ptr<Stmt>> statements) : statements(std::move(statements)) {};
     CompoundStmt(CompoundStmt&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -58,8 +59,8 @@ struct IfStmt : public Stmt {
 
     IfStmt(std::unique_ptr<Expr> condition, std::unique_ptr<Stmt> thenBranch, std::unique_ptr<Stmt> elseBranch=nullptr) : condition(std::move(condition)), thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch)) {};
     IfStmt(IfStmt&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -69,8 +70,8 @@ struct WhileStmt : public Stmt {
 
     WhileStmt(std::unique_ptr<Expr> condition, std::unique_ptr<Stmt> body) : condition(std::move(condition)), body(std::move(body)) {};
     WhileStmt(WhileStmt&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -80,8 +81,8 @@ struct RepeatStmt : public Stmt {
 
     RepeatStmt(std::unique_ptr<Expr> condition, std::vector<std::unique_ptr<Stmt>> body) : condition(std::move(condition)), body(std::move(body)) {};
     RepeatStmt(RepeatStmt&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -92,11 +93,21 @@ struct ForStmt : public Stmt {
     bool ischar;
     bool isdownto;
     std::unique_ptr<Stmt> body;
+    std::unique_ptr<Expr> in;
+    // Bounds other than literals; they are evaluated once, before the first iteration.
+    std::unique_ptr<Expr> from;
+    std::unique_ptr<Expr> to;
+    // Set by {$PARALLEL}: reductions pair an operator (+, min or max) with a variable.
+    bool parallel = false;
+    bool dynamic = false;
+    int chunk = 0;
+    std::vector<std::pair<std::string, std::string>> reductions;
 
     ForStmt(const std::string &name, int start, int end, bool ischar, bool isdownto, std::unique_ptr<Stmt> body) : name(name), start(start), end(end), ischar(ischar), isdownto(isdownto), body(std::move(body)) {};
+    ForStmt(const std::string &name, std::unique_ptr<Expr> in, std::unique_ptr<Stmt> body) : name(name), start(0), end(0), ischar(false), isdownto(false), body(std::move(body)), in(std::move(in)) {};
     ForStmt(ForStmt&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -107,8 +118,8 @@ struct CaseStmt : public Stmt {
 
     CaseStmt(std::unique_ptr<Expr> expr, std::vector<std::pair<std::unique_ptr<Expr>, std::unique_ptr<Stmt>>> cases, std::unique_ptr<Stmt> elseBranch = nullptr) : expr(std::move(expr)), cases(std::move(cases)), elseBranch(std::move(elseBranch)) {};
     CaseStmt(CaseStmt&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -116,8 +127,8 @@ struct ReadStmt : public Stmt {
     std::vector<std::string> variables;
 
     ReadStmt(std::vector<std::string> variables) : variables(std::move(variables)) {};
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -126,8 +137,28 @@ struct WriteStmt : public Stmt {
 
     WriteStmt(std::vector<std::unique_ptr<Expr>> exprs) : exprs(std::move(exprs)) {};
     WriteStmt(WriteStmt&&) noexcept = default;
-    llvm::Value* accept(AstVisitor& visitor) {
-        visitor.visit(*this);
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
+    };
+};
+
+struct YieldStmt : public Stmt {
+    std::unique_ptr<Expr> value;
+
+    YieldStmt(std::unique_ptr<Expr> value) : value(std::move(value)) {};
+    YieldStmt(YieldStmt&&) noexcept = default;
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
+    };
+};
+
+struct SpawnStmt : public Stmt {
+    std::unique_ptr<CallStmt> call;
+
+    SpawnStmt(std::unique_ptr<CallStmt> call) : call(std::move(call)) {};
+    SpawnStmt(SpawnStmt&&) noexcept = default;
+    llvm::Value* accept(AstVisitor& visitor) override {
+        return visitor.visit(*this);
     };
 };
 
@@ -72,6 +72,18 @@ enum TokenType {
     tok_range = -62,
     
     tok_error = -63,
+
+    tok_in = -64,
+    tok_packed = -65,
+    tok_directive = -66,
+    tok_nil = -67,
+    tok_single = -68,
+    tok_map = -69,
+    tok_iterator = -70,
+    tok_yield = -71,
+    tok_text = -72,
+    tok_channel = -73,
+    tok_spawn = -74,
 };
 
 struct Token {